@@ -1673,78 +1673,93 @@ shared_ptr<obj_model> obj_loader::load(const string& file_name, bool& success,
 		obj->index_count = (GLsizei)(obj->indices.size() * 3);
 	}
 	if(create_gpu_buffers) {
-		if(is_opengl) {
-			glGenBuffers(1, &gl_model->vertices_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, gl_model->vertices_vbo);
-			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->vertices.size() * sizeof(float3)), &gl_model->vertices[0], GL_STATIC_DRAW);
-			glGenBuffers(1, &gl_model->tex_coords_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, gl_model->tex_coords_vbo);
-			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->tex_coords.size() * sizeof(float2)), &gl_model->tex_coords[0], GL_STATIC_DRAW);
-			glGenBuffers(1, &gl_model->normals_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, gl_model->normals_vbo);
-			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->normals.size() * sizeof(float3)), &gl_model->normals[0], GL_STATIC_DRAW);
-			glGenBuffers(1, &gl_model->binormals_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, gl_model->binormals_vbo);
-			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->binormals.size() * sizeof(float3)), &gl_model->binormals[0], GL_STATIC_DRAW);
-			glGenBuffers(1, &gl_model->tangents_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, gl_model->tangents_vbo);
-			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->tangents.size() * sizeof(float3)), &gl_model->tangents[0], GL_STATIC_DRAW);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			
-			for(auto& obj : gl_model->objects) {
-				glGenBuffers(1, &obj->indices_gl_vbo);
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->indices_gl_vbo);
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(obj->indices.size() * sizeof(uint3)), &obj->indices[0], GL_STATIC_DRAW);
-			}
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-			
-			glFinish();
-		}
-		else {
-			// set material indices (only needed for floor_obj_model)
-			model->material_indices.clear();
-			model->material_indices.resize(floor_model->vertices.size());
-			for(const auto& obj : floor_model->objects) {
-				for(const auto& index : obj->indices) {
-					floor_model->material_indices[index.x] = obj->mat_idx;
-					floor_model->material_indices[index.y] = obj->mat_idx;
-					floor_model->material_indices[index.z] = obj->mat_idx;
-				}
-			}
-			
-			// create buffers
-			const auto buffer_type = (COMPUTE_MEMORY_FLAG::READ |
-									  COMPUTE_MEMORY_FLAG::HOST_WRITE);
-			floor_model->vertices_buffer = ctx->create_buffer(dev, floor_model->vertices, buffer_type);
-			floor_model->tex_coords_buffer = ctx->create_buffer(dev, floor_model->tex_coords, buffer_type);
-			floor_model->normals_buffer = ctx->create_buffer(dev, floor_model->normals, buffer_type);
-			floor_model->binormals_buffer = ctx->create_buffer(dev, floor_model->binormals, buffer_type);
-			floor_model->tangents_buffer = ctx->create_buffer(dev, floor_model->tangents, buffer_type);
-			floor_model->materials_buffer = ctx->create_buffer(dev, floor_model->material_indices, buffer_type);
-			
-			vector<uint3> all_indices;
-			for(auto& obj : floor_model->objects) {
-				obj->indices_floor_vbo = ctx->create_buffer(dev, obj->indices, buffer_type);
-				all_indices.insert(end(all_indices), begin(obj->indices), end(obj->indices));
-			}
-			floor_model->index_count = (uint32_t)(all_indices.size() * 3);
-			floor_model->indices_buffer = ctx->create_buffer(dev, all_indices, buffer_type);
-		}
+		obj_loader::create_gpu_buffers(*model, ctx, dev);
 	}
 	
 	// clean up mem that isn't needed any more
 	if(cleanup_cpu_data) {
-		model->vertices.clear();
-		model->tex_coords.clear();
-		model->normals.clear();
-		model->binormals.clear();
-		model->tangents.clear();
-		model->material_indices.clear();
-		model->material_infos.clear();
-		for(auto& obj : model->objects) {
-			obj->indices.clear();
-		}
+		obj_loader::cleanup_cpu_data(*model);
 	}
 	
 	return model;
 }
+
+void obj_loader::create_gpu_buffers(obj_model& model,
+									shared_ptr<compute_context> ctx,
+									shared_ptr<compute_device> dev) {
+	const bool is_opengl = (ctx->get_compute_type() != COMPUTE_TYPE::METAL &&
+							ctx->get_compute_type() != COMPUTE_TYPE::VULKAN);
+	auto gl_model = (is_opengl ? (gl_obj_model*)&model : nullptr);
+	auto floor_model = (!is_opengl ? (floor_obj_model*)&model : nullptr);
+	
+	if(is_opengl) {
+		glGenBuffers(1, &gl_model->vertices_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, gl_model->vertices_vbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->vertices.size() * sizeof(float3)), &gl_model->vertices[0], GL_STATIC_DRAW);
+		glGenBuffers(1, &gl_model->tex_coords_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, gl_model->tex_coords_vbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->tex_coords.size() * sizeof(float2)), &gl_model->tex_coords[0], GL_STATIC_DRAW);
+		glGenBuffers(1, &gl_model->normals_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, gl_model->normals_vbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->normals.size() * sizeof(float3)), &gl_model->normals[0], GL_STATIC_DRAW);
+		glGenBuffers(1, &gl_model->binormals_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, gl_model->binormals_vbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->binormals.size() * sizeof(float3)), &gl_model->binormals[0], GL_STATIC_DRAW);
+		glGenBuffers(1, &gl_model->tangents_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, gl_model->tangents_vbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gl_model->tangents.size() * sizeof(float3)), &gl_model->tangents[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		
+		for(auto& obj : gl_model->objects) {
+			glGenBuffers(1, &obj->indices_gl_vbo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->indices_gl_vbo);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(obj->indices.size() * sizeof(uint3)), &obj->indices[0], GL_STATIC_DRAW);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		
+		glFinish();
+	}
+	else {
+		// set material indices (only needed for floor_obj_model)
+		model.material_indices.clear();
+		model.material_indices.resize(floor_model->vertices.size());
+		for(const auto& obj : floor_model->objects) {
+			for(const auto& index : obj->indices) {
+				floor_model->material_indices[index.x] = obj->mat_idx;
+				floor_model->material_indices[index.y] = obj->mat_idx;
+				floor_model->material_indices[index.z] = obj->mat_idx;
+			}
+		}
+		
+		// create buffers
+		const auto buffer_type = (COMPUTE_MEMORY_FLAG::READ |
+								  COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		floor_model->vertices_buffer = ctx->create_buffer(dev, floor_model->vertices, buffer_type);
+		floor_model->tex_coords_buffer = ctx->create_buffer(dev, floor_model->tex_coords, buffer_type);
+		floor_model->normals_buffer = ctx->create_buffer(dev, floor_model->normals, buffer_type);
+		floor_model->binormals_buffer = ctx->create_buffer(dev, floor_model->binormals, buffer_type);
+		floor_model->tangents_buffer = ctx->create_buffer(dev, floor_model->tangents, buffer_type);
+		floor_model->materials_buffer = ctx->create_buffer(dev, floor_model->material_indices, buffer_type);
+		
+		vector<uint3> all_indices;
+		for(auto& obj : floor_model->objects) {
+			obj->indices_floor_vbo = ctx->create_buffer(dev, obj->indices, buffer_type);
+			all_indices.insert(end(all_indices), begin(obj->indices), end(obj->indices));
+		}
+		floor_model->index_count = (uint32_t)(all_indices.size() * 3);
+		floor_model->indices_buffer = ctx->create_buffer(dev, all_indices, buffer_type);
+	}
+}
+
+void obj_loader::cleanup_cpu_data(obj_model& model) {
+	model.vertices.clear();
+	model.tex_coords.clear();
+	model.normals.clear();
+	model.binormals.clear();
+	model.tangents.clear();
+	model.material_indices.clear();
+	model.material_infos.clear();
+	for(auto& obj : model.objects) {
+		obj->indices.clear();
+	}
+}
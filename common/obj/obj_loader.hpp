@@ -100,6 +100,16 @@ public:
 									  const bool is_load_textures = true,
 									  const bool create_gpu_buffers = true);
 	
+	// creates the gpu/graphics buffers of a model that was loaded with "create_gpu_buffers = false"
+	// NOTE: must be called from the thread that owns the graphics context, while
+	//       "load" itself is thread-safe when neither textures nor gpu buffers are created
+	static void create_gpu_buffers(obj_model& model,
+								   shared_ptr<compute_context> ctx,
+								   shared_ptr<compute_device> dev);
+	
+	// frees all cpu-side model data (index counts are retained)
+	static void cleanup_cpu_data(obj_model& model);
+	
 	struct pvrtc_texture {
 		uint2 dim;
 		uint32_t bpp;
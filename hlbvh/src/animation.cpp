@@ -18,6 +18,249 @@
 
 #include "animation.hpp"
 #include <floor/threading/task.hpp>
+#include <floor/core/file_io.hpp>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined(__WINDOWS__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// key-frame cache file layout:
+// header, uint64_t keys[frame_count],
+// per frame: float3 triangles[tri_count * 3], float3 centroids[tri_count], (uint3 indices[tri_count])
+struct keyframe_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t frame_count;
+	uint32_t tri_count;
+	uint32_t has_indices;
+	uint32_t max_vertex_count;
+};
+static constexpr const uint32_t keyframe_cache_magic { 0x43464B48u }; // "HKFC"
+static constexpr const uint32_t keyframe_cache_version { 2u };
+
+// writes the key-frame cache one frame at a time, so that the cpu copies of each frame can be dropped right away
+// (the header is only filled in once all frames have been written, until then the cache is invalid)
+class keyframe_cache_writer {
+public:
+	keyframe_cache_writer(const string& file_name_, const vector<uint64_t>& keys, const bool has_indices_) :
+	file_name(file_name_), has_indices(has_indices_) {
+		file.open(file_name, ios::out | ios::binary | ios::trunc);
+		if(!file.is_open()) return;
+		const keyframe_cache_header header {};
+		file.write((const char*)&header, sizeof(keyframe_cache_header));
+		file.write((const char*)keys.data(), streamsize(keys.size() * sizeof(uint64_t)));
+	}
+	~keyframe_cache_writer() {
+		if(finished) return;
+		// remove incomplete caches
+		if(file.is_open()) {
+			file.close();
+		}
+		remove(file_name.c_str());
+	}
+	keyframe_cache_writer(const keyframe_cache_writer&) = delete;
+	keyframe_cache_writer& operator=(const keyframe_cache_writer&) = delete;
+	
+	bool write_frame(const vector<float3>& triangles, const vector<float3>& centroids, const vector<uint3>& indices) {
+		if(!file.good()) return false;
+		file.write((const char*)triangles.data(), streamsize(triangles.size() * sizeof(float3)));
+		file.write((const char*)centroids.data(), streamsize(centroids.size() * sizeof(float3)));
+		if(has_indices) {
+			file.write((const char*)indices.data(), streamsize(indices.size() * sizeof(uint3)));
+		}
+		return file.good();
+	}
+	
+	bool finish(const uint32_t frame_count, const uint32_t tri_count, const uint32_t max_vertex_count) {
+		if(!file.good()) {
+			log_warn("failed to write key-frame cache: %s", file_name);
+			return false;
+		}
+		const keyframe_cache_header header {
+			keyframe_cache_magic,
+			keyframe_cache_version,
+			frame_count,
+			tri_count,
+			(has_indices ? 1u : 0u),
+			max_vertex_count,
+		};
+		file.seekp(0);
+		file.write((const char*)&header, sizeof(keyframe_cache_header));
+		file.close();
+		if(file.fail()) {
+			log_warn("failed to write key-frame cache: %s", file_name);
+			return false;
+		}
+		finished = true;
+		return true;
+	}
+	
+protected:
+	const string file_name;
+	const bool has_indices;
+	ofstream file;
+	bool finished { false };
+	
+};
+
+// a key-frame as parsed by a loader thread (collision data is only set if it was linearized)
+struct parsed_keyframe {
+	shared_ptr<obj_model> model;
+	shared_ptr<vector<float3>> triangles;
+	shared_ptr<vector<float3>> centroids;
+	shared_ptr<vector<uint3>> indices;
+	bool success { false };
+	bool done { false };
+};
+
+// shared state of the key-frame loader threads and the uploading thread
+// NOTE: this is owned by all of them, so that it stays alive until the last loader thread is done with it
+struct keyframe_load_state {
+	vector<string> file_names;
+	uint32_t frame_count;
+	bool linearize;
+	bool with_indices;
+	vector<parsed_keyframe> parsed_frames;
+	mutex queue_lock;
+	condition_variable queue_cv;
+	uint32_t upload_frame { 0u };
+	bool abort_load { false };
+	uint32_t active_workers { 0u };
+	atomic<uint32_t> next_parse_frame { 0u };
+};
+
+// loads all key-frames in two phases:
+//  #1: parse (+ linearize) the frames on all hw threads (no graphics api or device calls in here)
+//  #2: call "upload_func" for each parsed frame in order on this thread
+// both phases overlap through a bounded queue: a frame is only parsed once it is within
+// KEYFRAME_UPLOAD_QUEUE_SIZE frames of the next frame that has to be uploaded
+template <typename F>
+static bool load_keyframes(const vector<string>& file_names, const bool linearize, const bool with_indices,
+						   F&& upload_func) {
+	auto state = make_shared<keyframe_load_state>();
+	state->file_names = file_names;
+	state->frame_count = (uint32_t)file_names.size();
+	state->linearize = linearize;
+	state->with_indices = with_indices;
+	state->parsed_frames.resize(state->frame_count);
+	const auto frame_count = state->frame_count;
+	const auto worker_count = std::min(frame_count, std::max(core::get_hw_thread_count(), 1u));
+	state->active_workers = worker_count;
+	for(uint32_t worker_id = 0; worker_id < worker_count; ++worker_id) {
+		task::spawn([state] {
+			for(;;) {
+				const auto frame_id = state->next_parse_frame++;
+				if(frame_id >= state->frame_count) break;
+				
+				// wait until there is room in the queue
+				{
+					unique_lock<mutex> lock(state->queue_lock);
+					state->queue_cv.wait(lock, [&] {
+						return (state->abort_load || frame_id < state->upload_frame + KEYFRAME_UPLOAD_QUEUE_SIZE);
+					});
+					if(state->abort_load) break;
+				}
+				
+				parsed_keyframe frame;
+				frame.model = obj_loader::load(state->file_names[frame_id], frame.success, hlbvh_state.ctx, hlbvh_state.dev,
+											   // don't scale anything
+											   1.0f,
+											   // keep cpu data, b/c we still need it (freed after the upload)
+											   false,
+											   // don't load textures, we don't need them
+											   false,
+											   // gpu/graphics buffers are created in phase #2
+											   false);
+				if(frame.success && state->linearize) {
+					// linearize triangles + compute centroids for them
+					// -> transforms the "face/vertex-idxs -> vertices" model into a linear array of triangles
+					// TODO: reorder triangles based on morton code?
+					const auto& model = frame.model;
+					frame.triangles = make_shared<vector<float3>>();
+					frame.centroids = make_shared<vector<float3>>();
+					frame.indices = make_shared<vector<uint3>>();
+					
+					uint32_t triangle_count = 0;
+					for(const auto& sub_obj : model->objects) {
+						triangle_count += sub_obj->indices.size();
+					}
+					frame.triangles->reserve(triangle_count * 3);
+					frame.centroids->reserve(triangle_count);
+					if(state->with_indices) {
+						frame.indices->reserve(triangle_count);
+					}
+					
+					for(const auto& sub_obj : model->objects) {
+						for(const auto& idx : sub_obj->indices) {
+							const float3 tri[] {
+								model->vertices[idx.x],
+								model->vertices[idx.y],
+								model->vertices[idx.z],
+							};
+							frame.triangles->emplace_back(tri[0]);
+							frame.triangles->emplace_back(tri[1]);
+							frame.triangles->emplace_back(tri[2]);
+							frame.centroids->emplace_back((tri[0] + tri[1] + tri[2]) * (1.0f / 3.0f));
+							if(state->with_indices) {
+								frame.indices->emplace_back(idx);
+							}
+						}
+					}
+				}
+				
+				{
+					lock_guard<mutex> lock(state->queue_lock);
+					frame.done = true;
+					state->parsed_frames[frame_id] = std::move(frame);
+				}
+				state->queue_cv.notify_all();
+			}
+			
+			// NOTE: notify while still holding the lock, the uploading thread may return as soon as it can observe
+			//       that all workers are done
+			lock_guard<mutex> lock(state->queue_lock);
+			--state->active_workers;
+			state->queue_cv.notify_all();
+		}, "keyframe loader");
+	}
+	
+	bool load_valid = true;
+	for(uint32_t frame_id = 0; frame_id < frame_count; ++frame_id) {
+		parsed_keyframe frame;
+		{
+			unique_lock<mutex> lock(state->queue_lock);
+			state->queue_cv.wait(lock, [&] { return state->parsed_frames[frame_id].done; });
+			frame = std::move(state->parsed_frames[frame_id]);
+		}
+		if(!frame.success || !upload_func(frame_id, frame)) {
+			load_valid = false;
+			break;
+		}
+		
+		// signal that there is room for another frame
+		{
+			lock_guard<mutex> lock(state->queue_lock);
+			++state->upload_frame;
+		}
+		state->queue_cv.notify_all();
+	}
+	
+	// wait until all workers have finished (or aborted)
+	{
+		unique_lock<mutex> lock(state->queue_lock);
+		state->abort_load = !load_valid;
+		state->queue_cv.notify_all();
+		state->queue_cv.wait(lock, [&] { return (state->active_workers == 0u); });
+	}
+	return load_valid;
+}
 
 animation::animation(const string& file_prefix,
 					 const string& file_suffix,
@@ -27,130 +270,111 @@ animation::animation(const string& file_prefix,
 loop_or_reset(loop_or_reset_), frame_count(frame_count_), step_size(step_size_) {
 	if(frame_count < 2) return;
 	
-	// read files in parallel
+	// all frame file names (width is always the same, so insert 0s where necessary, e.g. 00042)
 	const auto digits_width = const_math::int_width(frame_count);
+	vector<string> file_names(frame_count);
+	for(uint32_t i = 0; i < frame_count; ++i) {
+		string frame_str = to_string(i + 1);
+		frame_str.insert(0, digits_width - uint32_t(frame_str.size()), '0');
+		file_names[i] = floor::data_path(file_prefix + frame_str + file_suffix);
+	}
+	
+	// obj models are only needed for rendering (collision data is linearized separately)
+	const bool load_models = !hlbvh_state.benchmark;
+	const bool with_indices = (hlbvh_state.triangle_vis || hlbvh_state.self_collision);
+	
 	frames.resize(frame_count);
-	frames_triangles.resize(frame_count);
-	frames_centroids.resize(frame_count);
 	frames_triangles_buffer.resize(frame_count);
 	frames_centroids_buffer.resize(frame_count);
-	if(hlbvh_state.triangle_vis) {
+	if(with_indices) {
 		frames_indices.resize(frame_count);
 	}
-	atomic<uint32_t> done { frame_count };
-	atomic<uint32_t> load_valid { 1u };
-	atomic<uint32_t> max_vertex_count { 0 };
-	for(uint32_t i = 0; i < frame_count; ++i) {
-#define THREADED_OBJ_LOAD 0 // TODO: still need to make this thread-safe for opengl
-#if !THREADED_OBJ_LOAD // non-threaded
-		const auto frame_id = i;
-#else
-		task::spawn([this, frame_id = i, &done, &load_valid, &digits_width,
-					 &file_prefix, &file_suffix]() {
-#endif
-			// start with frame id suffix (width is always the same, so insert 0s where necessary, e.g. 00042)
-			string file_name = to_string(frame_id + 1);
-			file_name.insert(0, digits_width - uint32_t(file_name.size()), '0');
-			
-			// load
-			file_name.insert(0, file_prefix);
-			file_name += file_suffix;
-			//log_debug("file name: %s", file_name);
-			bool success = false;
-			auto model = obj_loader::load(floor::data_path(file_name), success, hlbvh_state.ctx, hlbvh_state.dev,
-										  // don't scale anything
-										  1.0f,
-										  // keep cpu data, b/c we still need it
-										  // TODO: delete at the end
-										  false,
-										  // don't load textures, we don't need them
-										  false,
-										  // create gpu/graphics buffers?
-										  !hlbvh_state.benchmark);
-			frames[frame_id] = model;
-			if(!success) {
-				// signal that something went wrong
-				load_valid = 0;
-			}
-			else {
-				// linearize triangles + compute centroids for them
-				// -> transforms the "face/vertex-idxs -> vertices" model into a linear array of triangles
-				// TODO: reorder triangles based on morton code?
-				auto mdl_triangles = make_shared<vector<float3>>();
-				auto mdl_centroids = make_shared<vector<float3>>();
-				auto mdl_indices = make_shared<vector<uint3>>();
-				
-				uint32_t triangle_count = 0;
-				for(const auto& sub_obj : model->objects) {
-					triangle_count += sub_obj->indices.size();
-				}
-				mdl_triangles->reserve(triangle_count * 3);
-				mdl_centroids->reserve(triangle_count);
-				if(hlbvh_state.triangle_vis) {
-					mdl_indices->reserve(triangle_count);
-				}
-				
-				size_t idx_count = 0;
-				for(const auto& sub_obj : model->objects) {
-					for(const auto& idx : sub_obj->indices) {
-						const float3 tri[] {
-							model->vertices[idx.x],
-							model->vertices[idx.y],
-							model->vertices[idx.z],
-						};
-						mdl_triangles->emplace_back(tri[0]);
-						mdl_triangles->emplace_back(tri[1]);
-						mdl_triangles->emplace_back(tri[2]);
-						mdl_centroids->emplace_back((tri[0] + tri[1] + tri[2]) * (1.0f / 3.0f));
-						if(hlbvh_state.triangle_vis) {
-							mdl_indices->emplace_back(idx);
-						}
-					}
-					idx_count += sub_obj->indices.size();
-				}
-				frames_triangles[frame_id] = mdl_triangles;
-				frames_centroids[frame_id] = mdl_centroids;
-				
-				// upload key-frame data for this animation
-				frames_triangles_buffer[frame_id] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, *mdl_triangles);
-				frames_centroids_buffer[frame_id] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, *mdl_centroids);
-				if(hlbvh_state.triangle_vis) {
-					frames_indices[frame_id] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, *mdl_indices);
-				}
-				
-				//
-				const auto vertex_count = (uint32_t)model->vertices.size();
-				for(;;) {
-					uint32_t expected = max_vertex_count;
-					if(expected >= vertex_count) break;
-					if(max_vertex_count.compare_exchange_strong(expected, vertex_count)) break;
-				}
-			}
-			--done;
-#if THREADED_OBJ_LOAD
-		}, "mdl loader");
-#endif
+	uint32_t max_vertex_count { 0u };
+	
+	// try to load the linearized key-frame data from the cache first
+	// (keyed by the size + modification time of all frame files, so that a cache hit doesn't have to read them)
+	const auto cache_file_name = floor::data_path(file_prefix + ".keyframes");
+	vector<uint64_t> file_keys;
+	const bool has_file_keys = key_files(file_names, file_keys);
+	
+	// streaming requires the key-frame cache as its source
+	streaming = (hlbvh_state.stream_keyframes && has_file_keys);
+	if(hlbvh_state.stream_keyframes && !streaming) {
+		log_warn("%s: can't stream key-frames without the key-frame cache", file_prefix);
 	}
-	// wait until all loaded
-	while(done > 0) {
-		this_thread::yield();
+	if(has_file_keys && load_keyframe_cache(cache_file_name, file_keys, with_indices, max_vertex_count)) {
+		log_debug("%s: loaded key-frames from cache", file_prefix);
+		// the collision data is complete, only the render models still have to be loaded
+		// (same parallel loader as below, just without linearizing anything)
+		if(load_models) {
+			const bool models_valid = load_keyframes(file_names, false, false,
+													 [this](const uint32_t frame_id, parsed_keyframe& frame) {
+				frames[frame_id] = frame.model;
+				obj_loader::create_gpu_buffers(*frame.model, hlbvh_state.ctx, hlbvh_state.dev);
+				obj_loader::cleanup_cpu_data(*frame.model);
+				return true;
+			});
+			if(!models_valid) return;
+		}
 	}
-	valid = (load_valid != 0);
-	if(!valid) return;
-	
-	// check if triangle count per frame is the same
-	// (differences in triangle count could be handled, but only at the cost of performance)
-	for(uint32_t i = 0; i < frame_count; ++i) {
-		const auto frame_tri_count = (uint32_t)(frames_triangles[i]->size() / 3);
-		if(i == 0) {
-			tri_count = frame_tri_count;
+	else {
+		// written alongside the upload, so that no frame has to be kept around on the cpu
+		unique_ptr<keyframe_cache_writer> cache_writer;
+		if(has_file_keys) {
+			cache_writer = make_unique<keyframe_cache_writer>(cache_file_name, file_keys, with_indices);
 		}
-		else if(tri_count != frame_tri_count) {
-			log_error("variable triangle count for \"%s\" frame #%u (first frame: %u, this frame: %u)",
-					  file_prefix + file_suffix, i, tri_count, frame_tri_count);
-			return;
+		bool cache_valid = has_file_keys;
+		
+		valid = load_keyframes(file_names, true, with_indices,
+							   [this, &cache_writer, &cache_valid, &max_vertex_count, &with_indices, &load_models,
+								&file_prefix, &file_suffix]
+							   (const uint32_t frame_id, parsed_keyframe& frame) {
+			// check if triangle count per frame is the same
+			// (differences in triangle count could be handled, but only at the cost of performance)
+			const auto frame_tri_count = (uint32_t)(frame.triangles->size() / 3);
+			if(frame_id == 0) {
+				tri_count = frame_tri_count;
+			}
+			else if(tri_count != frame_tri_count) {
+				log_error("variable triangle count for \"%s\" frame #%u (first frame: %u, this frame: %u)",
+						  file_prefix + file_suffix, frame_id, tri_count, frame_tri_count);
+				return false;
+			}
+			
+			// upload key-frame data for this animation
+			// (when streaming, this is deferred until the key-frame cache has been written)
+			frames[frame_id] = frame.model;
+			if(!streaming) {
+				frames_triangles_buffer[frame_id] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, *frame.triangles);
+				frames_centroids_buffer[frame_id] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, *frame.centroids);
+				if(with_indices) {
+					frames_indices[frame_id] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, *frame.indices);
+				}
+			}
+			if(cache_valid) {
+				cache_valid = cache_writer->write_frame(*frame.triangles, *frame.centroids, *frame.indices);
+			}
+			if(load_models) {
+				obj_loader::create_gpu_buffers(*frame.model, hlbvh_state.ctx, hlbvh_state.dev);
+			}
+			max_vertex_count = std::max(max_vertex_count, (uint32_t)frame.model->vertices.size());
+			obj_loader::cleanup_cpu_data(*frame.model);
+			return true;
+		});
+		if(!valid) return;
+		
+		if(has_file_keys) {
+			const bool cache_written = (cache_valid && cache_writer->finish(frame_count, tri_count, max_vertex_count));
+			cache_writer = nullptr;
+			if(streaming &&
+			   (!cache_written || !load_keyframe_cache(cache_file_name, file_keys, with_indices, max_vertex_count))) {
+				log_error("%s: failed to stream key-frames from the key-frame cache", file_prefix);
+				valid = false;
+				return;
+			}
 		}
 	}
+	valid = true;
 	log_debug("%s #triangles: %u", file_prefix, tri_count);
 	
 	// now that we have the max triangle count, allocate the morton codes + ping buffer with this max size.
@@ -163,7 +387,19 @@ loop_or_reset(loop_or_reset_), frame_count(frame_count_), step_size(step_size_)
 	
 	morton_codes = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, morton_codes_size);
 	morton_codes_ping = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, morton_codes_size);
+	
+	// large meshes need more precise morton codes, otherwise too many triangles end up with the same code
+	wide_morton_codes = (hlbvh_state.morton_code_bits == 63 ||
+						 (hlbvh_state.morton_code_bits == 0 && tri_count >= WIDE_MORTON_CODE_TRIANGLE_THRESHOLD));
+	if(wide_morton_codes) {
+		log_debug("%s: using 63-bit morton codes", file_prefix);
+		morton_codes_hi = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, tri_count * sizeof(uint32_t));
+		morton_codes_lo = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, tri_count * sizeof(uint32_t));
+	}
 	triangles = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, tri_count * sizeof(float3) * 3u);
+	if(hlbvh_state.ccd) {
+		triangles_prev = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, tri_count * sizeof(float3) * 3u);
+	}
 	
 	// N leaves + (N-1) internal nodes, allocating enough for max triangle count
 	bvh_leaves = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, tri_count * sizeof(uint32_t));
@@ -171,10 +407,16 @@ loop_or_reset(loop_or_reset_), frame_count(frame_count_), step_size(step_size_)
 	bvh_aabbs = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, (tri_count - 1u) * sizeof(float3) * 2u);
 	bvh_aabbs_leaves = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, tri_count * sizeof(float3) * 2u);
 	bvh_aabbs_counters = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, (tri_count - 1u) * sizeof(uint32_t));
+	if(hlbvh_state.compressed_bvh) {
+		bvh_compressed = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, (tri_count - 1u) * sizeof(compressed_bvh_node));
+	}
+	if(hlbvh_state.wide_bvh) {
+		bvh_wide = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, (tri_count - 1u) * sizeof(wide_bvh_node));
+	}
 	
 	// for visualization purposes
 	if(hlbvh_state.triangle_vis) {
-		log_debug("max vertex count: %u", max_vertex_count.load());
+		log_debug("max vertex count: %u", max_vertex_count);
 		colliding_vertices = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, max_vertex_count * sizeof(uint32_t),
 															COMPUTE_MEMORY_FLAG::READ_WRITE |
 															COMPUTE_MEMORY_FLAG::HOST_READ_WRITE |
@@ -186,7 +428,16 @@ loop_or_reset(loop_or_reset_), frame_count(frame_count_), step_size(step_size_)
 	}
 }
 
+animation::~animation() {
+	// an in-flight key-frame upload still references this animation
+	wait_for_upload();
+}
+
 void animation::do_step() {
+	prev_cur_frame = cur_frame;
+	prev_next_frame = next_frame;
+	prev_step = step;
+	
 	step += step_size;
 	if(step > 1.0f) {
 		if(!loop_or_reset) {
@@ -199,10 +450,316 @@ void animation::do_step() {
 			if(next_frame + 1 == frame_count) {
 				cur_frame = 0;
 				next_frame = 1;
+				// don't sweep over the reset
+				prev_cur_frame = 0;
+				prev_next_frame = 1;
+				prev_step = step - 1.0f;
 			}
 			// middle frame, just advance by one
 			else cur_frame = next_frame++;
 		}
 		step -= 1.0f;
 	}
+	
+	update_resident_frames();
+}
+
+void animation::set_phase(const float frame_offset) {
+	if(frame_count < 2) return;
+	
+	// looping animations cycle through all frames, resetting ones through [0, frame_count - 2] (+next frame)
+	const auto cycle_length = (loop_or_reset ? frame_count - 1u : frame_count);
+	const auto offset = max(frame_offset, 0.0f);
+	cur_frame = uint32_t(offset) % cycle_length;
+	next_frame = (cur_frame + 1u) % frame_count;
+	step = offset - std::floor(offset);
+	
+	prev_cur_frame = cur_frame;
+	prev_next_frame = next_frame;
+	prev_step = step;
+	
+	update_resident_frames();
+}
+
+// read-only view of a whole file, memory-mapped where possible
+class mapped_file {
+public:
+	mapped_file(const string& file_name) {
+#if !defined(__WINDOWS__)
+		const auto fd = open(file_name.c_str(), O_RDONLY);
+		if(fd < 0) return;
+		struct stat file_stat;
+		if(fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+			auto mapping = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapping != MAP_FAILED) {
+				data_ptr = (const uint8_t*)mapping;
+				data_size = (size_t)file_stat.st_size;
+				is_mapped = true;
+			}
+		}
+		close(fd);
+		if(is_mapped) return;
+#endif
+		// fallback: read the whole file into memory
+		if(!file_io::file_to_string(file_name, file_data)) return;
+		data_ptr = (const uint8_t*)file_data.data();
+		data_size = file_data.size();
+	}
+	~mapped_file() {
+#if !defined(__WINDOWS__)
+		if(is_mapped) {
+			munmap((void*)data_ptr, data_size);
+		}
+#endif
+	}
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	
+	const uint8_t* data() const { return data_ptr; }
+	size_t size() const { return data_size; }
+	
+	// hints that the specified range will be accessed soon (no-op if the file isn't mapped)
+	void prefetch(const size_t offset, const size_t size) const {
+#if !defined(__WINDOWS__)
+		if(!is_mapped || offset >= data_size) return;
+		static const auto page_size = (size_t)sysconf(_SC_PAGESIZE);
+		const auto page_offset = offset - (offset % page_size);
+		madvise((void*)(data_ptr + page_offset), std::min(size + (offset - page_offset), data_size - page_offset),
+				MADV_WILLNEED);
+#endif
+	}
+	
+protected:
+	const uint8_t* data_ptr { nullptr };
+	size_t data_size { 0 };
+	bool is_mapped { false };
+	string file_data;
+	
+};
+
+bool animation::key_files(const vector<string>& file_names, vector<uint64_t>& keys) {
+	keys.clear();
+	keys.reserve(file_names.size());
+	for(const auto& file_name : file_names) {
+		// only stat the file, its contents are never read here
+		struct stat file_stat;
+		if(stat(file_name.c_str(), &file_stat) != 0) return false;
+		const uint64_t key_data[] { uint64_t(file_stat.st_size), uint64_t(file_stat.st_mtime) };
+		
+		// 64-bit FNV-1a over size + modification time
+		uint64_t key = 0xCBF29CE484222325ull;
+		for(size_t i = 0; i < sizeof(key_data); ++i) {
+			key ^= ((const uint8_t*)key_data)[i];
+			key *= 0x100000001B3ull;
+		}
+		keys.emplace_back(key);
+	}
+	return true;
+}
+
+bool animation::load_keyframe_cache(const string& file_name, const vector<uint64_t>& keys,
+									const bool with_indices, uint32_t& max_vertex_count) {
+	if(!file_io::is_file(file_name)) return false;
+	auto file = make_shared<mapped_file>(file_name);
+	if(file->data() == nullptr || file->size() < sizeof(keyframe_cache_header)) return false;
+	
+	keyframe_cache_header header;
+	memcpy(&header, file->data(), sizeof(keyframe_cache_header));
+	if(header.magic != keyframe_cache_magic ||
+	   header.version != keyframe_cache_version ||
+	   header.frame_count != frame_count ||
+	   header.tri_count < 2u ||
+	   // indices are only stored if they were needed at the time the cache was written
+	   (with_indices && header.has_indices == 0u)) {
+		return false;
+	}
+	
+	const size_t triangles_size = header.tri_count * sizeof(float3) * 3u;
+	const size_t centroids_size = header.tri_count * sizeof(float3);
+	const size_t indices_size = (header.has_indices != 0u ? header.tri_count * sizeof(uint3) : 0u);
+	const size_t keys_size = frame_count * sizeof(uint64_t);
+	if(file->size() != (sizeof(keyframe_cache_header) + keys_size +
+						frame_count * (triangles_size + centroids_size + indices_size))) {
+		log_warn("invalid key-frame cache size: %s", file_name);
+		return false;
+	}
+	
+	// any changed source file invalidates the whole cache
+	if(memcmp(file->data() + sizeof(keyframe_cache_header), keys.data(), keys_size) != 0) {
+		return false;
+	}
+	
+	tri_count = header.tri_count;
+	max_vertex_count = header.max_vertex_count;
+	keyframe_has_indices = (header.has_indices != 0u);
+	const uint8_t* frame_data = file->data() + sizeof(keyframe_cache_header) + keys_size;
+	
+	// when streaming, keep the mapping around and only allocate the ring of frame buffers,
+	// which are then filled on demand
+	if(streaming) {
+		keyframe_cache = file;
+		keyframe_data = frame_data;
+		
+		const auto ring_size = std::min(frame_count, 3u /* prev, cur, next */ + KEYFRAME_STREAM_PREFETCH);
+		frames_triangles_buffer.resize(ring_size);
+		frames_centroids_buffer.resize(ring_size);
+		for(uint32_t i = 0; i < ring_size; ++i) {
+			frames_triangles_buffer[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, triangles_size);
+			frames_centroids_buffer[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, centroids_size);
+		}
+		if(with_indices) {
+			frames_indices.resize(ring_size);
+			for(uint32_t i = 0; i < ring_size; ++i) {
+				frames_indices[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, indices_size);
+			}
+		}
+		resident_frames.assign(ring_size, ~0u);
+		if(!upload_queue) {
+			upload_queue = hlbvh_state.ctx->create_queue(hlbvh_state.dev);
+		}
+		update_resident_frames();
+		return true;
+	}
+	
+	// otherwise: upload all frames directly from the mapped memory
+	for(uint32_t i = 0; i < frame_count; ++i) {
+		frames_triangles_buffer[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, triangles_size,
+																	(void*)frame_data);
+		frame_data += triangles_size;
+		frames_centroids_buffer[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, centroids_size,
+																	(void*)frame_data);
+		frame_data += centroids_size;
+		if(with_indices) {
+			frames_indices[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, indices_size, (void*)frame_data);
+		}
+		frame_data += indices_size;
+	}
+	return true;
+}
+
+uint32_t animation::buffer_index(const uint32_t frame) const {
+	if(!streaming) return frame;
+	for(uint32_t slot = 0, slot_count = (uint32_t)resident_frames.size(); slot < slot_count; ++slot) {
+		if(resident_frames[slot] == frame) return slot;
+	}
+	log_error("key-frame #%u is not resident", frame);
+	return 0;
+}
+
+void animation::wait_for_upload() const {
+	unique_lock<mutex> lock(upload_lock);
+	upload_cv.wait(lock, [this] { return !upload_pending; });
+}
+
+bool animation::is_upload_pending() const {
+	lock_guard<mutex> lock(upload_lock);
+	return upload_pending;
+}
+
+void animation::update_resident_frames() {
+	if(!streaming) return;
+	
+	// all key-frames that are needed by the current step (prev frames are used by ccd) + the prefetched ones
+	needed_frames[0] = prev_cur_frame;
+	needed_frames[1] = prev_next_frame;
+	needed_frames[2] = cur_frame;
+	needed_frames[3] = next_frame;
+	for(uint32_t i = 1; i <= KEYFRAME_STREAM_PREFETCH; ++i) {
+		needed_frames[3u + i] = (next_frame + i) % frame_count;
+	}
+	const auto is_needed = [this](const uint32_t frame) {
+		return (find(begin(needed_frames), end(needed_frames), frame) != end(needed_frames));
+	};
+	const auto is_uploading = [this](const uint32_t slot) {
+		return (is_upload_pending() &&
+				find(begin(upload_slots), begin(upload_slots) + upload_slot_count, slot) !=
+				begin(upload_slots) + upload_slot_count);
+	};
+	
+	const size_t triangles_size = tri_count * sizeof(float3) * 3u;
+	const size_t centroids_size = tri_count * sizeof(float3);
+	const size_t indices_size = (keyframe_has_indices ? tri_count * sizeof(uint3) : 0u);
+	const size_t frame_size = triangles_size + centroids_size + indices_size;
+	const bool with_indices = !frames_indices.empty();
+	array<uint32_t, KEYFRAME_STREAM_PREFETCH> new_upload_slots;
+	uint32_t new_upload_slot_count { 0u };
+	for(uint32_t i = 0; i < KEYFRAME_STREAM_NEEDED_FRAMES; ++i) {
+		const auto frame = needed_frames[i];
+		const bool prefetched = (i >= 4u);
+		auto slot_iter = find(begin(resident_frames), end(resident_frames), frame);
+		if(slot_iter != end(resident_frames)) {
+			// frames of this step must have finished uploading before they are used
+			if(!prefetched && is_uploading((uint32_t)distance(begin(resident_frames), slot_iter))) {
+				wait_for_upload();
+			}
+			continue;
+		}
+		
+		// replace a key-frame that is no longer needed
+		slot_iter = find_if(begin(resident_frames), end(resident_frames), [&is_needed](const uint32_t resident) {
+			return (resident == ~0u || !is_needed(resident));
+		});
+		if(slot_iter == end(resident_frames)) {
+			log_error("no free key-frame slot for frame #%u", frame);
+			return;
+		}
+		const auto slot = (uint32_t)distance(begin(resident_frames), slot_iter);
+		if(is_uploading(slot)) {
+			wait_for_upload();
+		}
+		*slot_iter = frame;
+		
+		// prefetched frames are uploaded asynchronously below, frames of this step are needed right away
+		if(prefetched) {
+			new_upload_slots[new_upload_slot_count++] = slot;
+			continue;
+		}
+		const uint8_t* data = keyframe_data + frame * frame_size;
+		frames_triangles_buffer[slot]->write(hlbvh_state.dev_queue, (void*)data, triangles_size);
+		frames_centroids_buffer[slot]->write(hlbvh_state.dev_queue, (void*)(data + triangles_size), centroids_size);
+		if(with_indices) {
+			frames_indices[slot]->write(hlbvh_state.dev_queue, (void*)(data + triangles_size + centroids_size),
+										indices_size);
+		}
+	}
+	
+	if(new_upload_slot_count > 0) {
+		// only one upload may be in flight at a time
+		wait_for_upload();
+		upload_slots = new_upload_slots;
+		upload_slot_count = new_upload_slot_count;
+		array<const uint8_t*, KEYFRAME_STREAM_PREFETCH> upload_data;
+		for(uint32_t i = 0; i < new_upload_slot_count; ++i) {
+			upload_data[i] = keyframe_data + resident_frames[new_upload_slots[i]] * frame_size;
+		}
+		{
+			lock_guard<mutex> lock(upload_lock);
+			upload_pending = true;
+		}
+		task::spawn([this, new_upload_slots, new_upload_slot_count, upload_data,
+					 triangles_size, centroids_size, indices_size, with_indices] {
+			for(uint32_t i = 0; i < new_upload_slot_count; ++i) {
+				const auto slot = new_upload_slots[i];
+				const auto data = upload_data[i];
+				frames_triangles_buffer[slot]->write(upload_queue, (void*)data, triangles_size);
+				frames_centroids_buffer[slot]->write(upload_queue, (void*)(data + triangles_size), centroids_size);
+				if(with_indices) {
+					frames_indices[slot]->write(upload_queue, (void*)(data + triangles_size + centroids_size),
+												indices_size);
+				}
+			}
+			upload_queue->finish();
+			
+			// NOTE: notify while still holding the lock, this animation may be destroyed as soon as a waiting thread
+			//       can observe that the upload has finished
+			lock_guard<mutex> lock(upload_lock);
+			upload_pending = false;
+			upload_cv.notify_all();
+		}, "keyframe upload");
+	}
+	
+	// let the os page in the key-frame after the prefetched ones in the background,
+	// so that its upload in one of the next steps doesn't have to wait for the disk
+	const auto upcoming_frame = (next_frame + KEYFRAME_STREAM_PREFETCH + 1u) % frame_count;
+	keyframe_cache->prefetch(size_t(keyframe_data - keyframe_cache->data()) + upcoming_frame * frame_size, frame_size);
 }
@@ -21,6 +21,10 @@
 
 #include "hlbvh_state.hpp"
 #include "obj_loader.hpp"
+#include <mutex>
+#include <condition_variable>
+
+class mapped_file;
 
 struct animation {
 	animation(const string& file_prefix,
@@ -28,11 +32,34 @@ struct animation {
 			  const uint32_t frame_count,
 			  const bool loop_or_reset = false,
 			  const float step_size = 0.025f);
+	~animation();
 	
 	bool is_valid() const { return valid; }
 	
 	void do_step();
 	
+	// starts the animation "frame_offset" key-frames later (fractional offsets start in between two key-frames)
+	void set_phase(const float frame_offset);
+	
+	// returns the device buffers of the specified key-frame
+	// NOTE: when streaming key-frames, only the previous, current, next and prefetched frames are resident
+	const shared_ptr<compute_buffer>& get_triangles_buffer(const uint32_t frame) const {
+		return frames_triangles_buffer[buffer_index(frame)];
+	}
+	const shared_ptr<compute_buffer>& get_centroids_buffer(const uint32_t frame) const {
+		return frames_centroids_buffer[buffer_index(frame)];
+	}
+	const shared_ptr<compute_buffer>& get_indices_buffer(const uint32_t frame) const {
+		return frames_indices[buffer_index(frame)];
+	}
+	
+	// binary key-frame cache: stores the linearized triangles, centroids and indices of all frames,
+	// keyed by the size + modification time of the source frame files
+	// NOTE: the cache is written one frame at a time while loading the frames (see keyframe_cache_writer)
+	static bool key_files(const vector<string>& file_names, vector<uint64_t>& keys);
+	bool load_keyframe_cache(const string& file_name, const vector<uint64_t>& keys,
+							 const bool with_indices, uint32_t& max_vertex_count);
+	
 	bool valid { false };
 	bool stopped { true };
 	bool loop_or_reset { false }; // false: loop, true: reset
@@ -42,10 +69,13 @@ struct animation {
 	uint32_t next_frame { 1 };
 	float step { 0.0f };
 	
+	// animation state of the previous step (used for ccd)
+	uint32_t prev_cur_frame { 0 };
+	uint32_t prev_next_frame { 1 };
+	float prev_step { 0.0f };
+	
 	uint32_t tri_count { 0 };
 	vector<shared_ptr<obj_model>> frames;
-	vector<shared_ptr<vector<float3>>> frames_triangles;
-	vector<shared_ptr<vector<float3>>> frames_centroids;
 	vector<shared_ptr<compute_buffer>> frames_triangles_buffer;
 	vector<shared_ptr<compute_buffer>> frames_centroids_buffer;
 	
@@ -53,23 +83,73 @@ struct animation {
 	
 	// interpolated triangles of the current+next frame
 	shared_ptr<compute_buffer> triangles;
+	// interpolated triangles of the previous step (only allocated for ccd)
+	shared_ptr<compute_buffer> triangles_prev;
 	
 	// morton code buffer (+ping buffer for radix sort) used by all frames
 	shared_ptr<compute_buffer> morton_codes;
 	shared_ptr<compute_buffer> morton_codes_ping;
 	
+	// if true, 63-bit morton codes are used, with the upper and lower 32-bit halves stored per triangle
+	// (the sorted morton codes buffer then only contains the upper half)
+	bool wide_morton_codes { false };
+	shared_ptr<compute_buffer> morton_codes_hi;
+	shared_ptr<compute_buffer> morton_codes_lo;
+	
 	// bvh buffers (leaf nodes + internal nodes)
 	shared_ptr<compute_buffer> bvh_leaves;
 	shared_ptr<compute_buffer> bvh_internal;
 	shared_ptr<compute_buffer> bvh_aabbs;
 	shared_ptr<compute_buffer> bvh_aabbs_leaves;
 	shared_ptr<compute_buffer> bvh_aabbs_counters;
+	// compressed copy of the bvh (only allocated if compressed bvhs are enabled)
+	shared_ptr<compute_buffer> bvh_compressed;
+	// wide copy of the bvh (only allocated if wide bvhs are enabled)
+	shared_ptr<compute_buffer> bvh_wide;
 	
 	uint32_t colliding_triangles_idx { 0 };
 	shared_ptr<compute_buffer> colliding_triangles[2];
 	shared_ptr<compute_buffer> colliding_vertices;
 	vector<shared_ptr<compute_buffer>> frames_indices;
 	
+	// key-frame streaming: the frame buffers above are a ring of device buffers, which are filled from the
+	// memory-mapped key-frame cache as the animation advances
+	bool streaming { false };
+	shared_ptr<mapped_file> keyframe_cache;
+	const uint8_t* keyframe_data { nullptr };
+	bool keyframe_has_indices { false };
+	// key-frame that is currently stored in each ring slot (~0u if none)
+	vector<uint32_t> resident_frames;
+	// key-frames needed by the current step (the first 4 are needed right away, the rest is prefetched)
+	array<uint32_t, KEYFRAME_STREAM_NEEDED_FRAMES> needed_frames;
+	
+	// prefetched key-frames are uploaded asynchronously by a task through its own queue, at most one such upload
+	// is in flight at any time and its slots may only be used once "upload_pending" has been cleared
+	// NOTE: "upload_pending" is guarded by "upload_lock", the upload task signals its completion through "upload_cv"
+	shared_ptr<compute_queue> upload_queue;
+	mutable mutex upload_lock;
+	mutable condition_variable upload_cv;
+	bool upload_pending { false };
+	array<uint32_t, KEYFRAME_STREAM_PREFETCH> upload_slots;
+	uint32_t upload_slot_count { 0u };
+	// blocks until the in-flight upload (if any) has finished
+	void wait_for_upload() const;
+	bool is_upload_pending() const;
+	
+	// maps a key-frame to its index in the frame buffers
+	uint32_t buffer_index(const uint32_t frame) const;
+	// makes sure that all key-frames needed by the next step (+prefetch) are resident
+	void update_resident_frames();
+	
+};
+
+// a rigidly transformed instance of an animation
+// NOTE: all instances of an animation share its triangle, morton code and bvh buffers (the bvh is built in local space)
+struct animation_instance {
+	// index of the instanced animation
+	uint32_t animation_idx;
+	// local -> world space transform (must be rigid, i.e. only rotation + translation)
+	matrix4f transform;
 };
 
 #endif
@@ -18,6 +18,8 @@
 
 #include "collider.hpp"
 #include <floor/core/timer.hpp>
+#include <floor/core/file_io.hpp>
+#include <sstream>
 
 #if defined(FLOOR_DEBUG)
 #define log_if_debug(...) { log_undecorated(__VA_ARGS__); logger::flush(); }
@@ -29,6 +31,7 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 	if(models.empty()) return collision_flags_host;
 	if(hlbvh_state.stop) return collision_flags_host;
 	
+	stats.begin_frame();
 	if(hlbvh_state.benchmark) {
 		hlbvh_state.dev_queue->finish();
 	}
@@ -41,26 +44,35 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 	// * compute bvh for each valid model (compute morton codes, compute actual bvh structure, compute aabbs)
 	// * intersect bvhs (and triangles) with each other for all potential model pairs (from step #2)
 	const auto model_count = models.size();
-	const auto total_aabb_checks = (uint32_t)(model_count * model_count - model_count) / 2u;
 	
-	// alloc all data (once every time model count changes)
+	// alloc all data (once every time model count changes, buffers only grow -> see grow_buffer)
 	if(model_count != allocated_model_count) {
 		allocated_model_count = model_count;
+		allocated_instance_count = 0; // force re-alloc in the instanced collide()
 		
-		collision_flags = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, model_count * sizeof(uint32_t),
-														 COMPUTE_MEMORY_FLAG::WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
-		collision_flags_host.resize(model_count);
+		alloc_collision_flags(model_count);
+		grow_buffer(aabbs, model_count * sizeof(float3) * 2, COMPUTE_MEMORY_FLAG::READ_WRITE);
+		if(hlbvh_state.self_collision) {
+			grow_buffer(self_collision_flags, model_count * sizeof(uint32_t),
+						COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+			self_collision_flags_host.assign(model_count, 0u);
+		}
+	}
 	
-		aabb_collision_flags = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, total_aabb_checks * sizeof(uint32_t),
-															  COMPUTE_MEMORY_FLAG::WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
-		
-		aabbs = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, model_count * sizeof(float3) * 2,
-											   COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+	if(hlbvh_state.contacts && !contacts) {
+		contacts = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, hlbvh_state.max_contacts * sizeof(triangle_contact),
+												  COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+		contacts_counter = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, sizeof(uint32_t),
+														  COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
 	}
 	
 	// init all data (every time this is called)
+	swap_collision_flags();
 	collision_flags->zero(hlbvh_state.dev_queue);
-	aabb_collision_flags->zero(hlbvh_state.dev_queue);
+	bvh_built.assign(model_count, 0u);
+	if(hlbvh_state.contacts) {
+		contacts_counter->zero(hlbvh_state.dev_queue);
+	}
 	
 	if(hlbvh_state.triangle_vis) {
 		for(const auto& mdl : models) {
@@ -70,12 +82,7 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 		}
 	}
 	
-	vector<float3> init_aabbs(model_count * 2);
-	for(size_t i = 0; i < model_count; ++i) {
-		init_aabbs[i * 2] = float3(__FLT_MAX__);
-		init_aabbs[i * 2 + 1] = float3(-__FLT_MAX__);
-	}
-	aabbs->write(hlbvh_state.dev_queue, init_aabbs);
+	init_aabbs(uint32_t(model_count));
 	
 	// compute root aabbs
 	uint32_t mdl_idx = 0;
@@ -84,115 +91,87 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 		const auto triangle_count = mdl->tri_count;
 		
 		log_if_debug("build_aabbs: %u (%u)", mdl_idx, triangle_count);
-		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_aabbs"],
-									   uint1 { triangle_count },
-									   uint1 { ROOT_AABB_GROUP_SIZE },
-									   mdl->frames_triangles_buffer[cur_frame],
-									   mdl->frames_triangles_buffer[next_frame],
-									   triangle_count,
-									   mdl_idx,
-									   mdl->step,
-									   aabbs,
-									   mdl->triangles);
+		stats.begin(collision_stats::STAGE::BUILD_AABBS, mdl_idx);
+		if(!hlbvh_state.ccd) {
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_aabbs"],
+										   uint1 { triangle_count },
+										   uint1 { ROOT_AABB_GROUP_SIZE },
+										   mdl->get_triangles_buffer(cur_frame),
+										   mdl->get_triangles_buffer(next_frame),
+										   triangle_count,
+										   mdl_idx,
+										   mdl->step,
+										   aabbs,
+										   mdl->triangles);
+		}
+		else {
+			// swept root aabb over the previous and current step (+store the triangles of the previous step)
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_aabbs_swept"],
+										   uint1 { triangle_count },
+										   uint1 { ROOT_AABB_GROUP_SIZE },
+										   mdl->get_triangles_buffer(cur_frame),
+										   mdl->get_triangles_buffer(next_frame),
+										   triangle_count,
+										   mdl_idx,
+										   mdl->step,
+										   aabbs,
+										   mdl->triangles,
+										   mdl->get_triangles_buffer(mdl->prev_cur_frame),
+										   mdl->get_triangles_buffer(mdl->prev_next_frame),
+										   mdl->prev_step,
+										   mdl->triangles_prev);
+		}
+		stats.end();
 		++mdl_idx;
 	}
 	
 	//
-	unordered_set<uint32_t> valid_meshes;
-	vector<uint2> potential_pairs;
-	{
-		log_if_debug("collide_root_aabbs");
-		auto aabb_collision_flags_host = make_unique<uint32_t[]>(total_aabb_checks);
-		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["collide_root_aabbs"],
-									   uint1 { total_aabb_checks },
-									   uint1 { hlbvh_state.kernel_max_local_size["collide_root_aabbs"] },
-									   aabbs,
-									   total_aabb_checks,
-									   uint32_t(model_count),
-									   aabb_collision_flags);
-		
-		// read back aabb collision flags
-		aabb_collision_flags->read(hlbvh_state.dev_queue, aabb_collision_flags_host.get());
+	auto& valid_meshes = valid_meshes_host;
+	auto& potential_pairs = potential_pairs_host;
+	valid_meshes.clear();
+	potential_pairs.clear();
+	stats.begin(collision_stats::STAGE::ROOT_AABBS);
+	find_potential_pairs(aabbs, uint32_t(model_count), valid_meshes, potential_pairs);
+	stats.end();
+	
+	// re-test the triangle pairs that collided in the last frame: pairs that still collide are resolved and neither
+	// need a bvh nor a full traversal
+	auto& pair_resolved = pair_resolved_host;
+	auto& pair_slots = pair_slots_host;
+	pair_resolved.assign(potential_pairs.size(), 0u);
+	pair_slots.assign(potential_pairs.size(), ~0u);
+	if(hlbvh_state.contact_cache) {
+		stats.begin(collision_stats::STAGE::COLLIDE_PAIRS);
+		resolve_contact_cache(uint32_t(model_count), models, potential_pairs, pair_resolved, pair_slots);
+		stats.end();
 		
-		// we're only interessted in further constructing+colliding bvhs for meshes whose root aabbs collide with something
-		// and also only the resp. collision pairs
-		for(uint32_t lin_idx = 0; lin_idx < total_aabb_checks; ++lin_idx) {
-			if(aabb_collision_flags_host[lin_idx] != 0) {
-				// reverse cantor (map 1D linear index onto "half triangle" of a square -> all unique combinations of (i, j), with i != j)
-				const auto q = (uint32_t)((const_math::EPSILON<float> + sqrt(1.0f + 8.0f * float(lin_idx))) * 0.5f - 0.5f);
-				const auto i = lin_idx - (q * (q + 1u)) / 2u;
-				const auto j = uint32_t(model_count) - q + i - 1u;
-				valid_meshes.insert(i);
-				valid_meshes.insert(j);
-				potential_pairs.emplace_back(i, j);
-				log_if_debug("possible collision: %u <-> %u", i, j);
+		valid_meshes.clear();
+		for(size_t p = 0; p < potential_pairs.size(); ++p) {
+			if(!pair_resolved[p]) {
+				valid_meshes.insert(potential_pairs[p].x);
+				valid_meshes.insert(potential_pairs[p].y);
 			}
 		}
 	}
 	
+	// with self-collision, all models need a bvh, regardless of the root aabb collisions
+	if(hlbvh_state.self_collision) {
+		for(uint32_t i = 0; i < model_count; ++i) {
+			valid_meshes.insert(i);
+		}
+	}
 	
 	// compute bvh
 	for(const auto& i : valid_meshes) {
-		const auto& mdl = models[i];
-		const auto cur_frame = mdl->cur_frame, next_frame = mdl->next_frame;
-		const auto triangle_count = mdl->tri_count;
-		const auto morton_codes_count = uint32_t(mdl->morton_codes->get_size() / sizeof(uint2));
-		
-		log_if_debug("compute_morton_codes: %u", i);
-		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["compute_morton_codes"],
-									   uint1 { morton_codes_count },
-									   uint1 { hlbvh_state.kernel_max_local_size["compute_morton_codes"] },
-									   aabbs,
-									   mdl->frames_centroids_buffer[cur_frame],
-									   mdl->frames_centroids_buffer[next_frame],
-									   triangle_count,
-									   i,
-									   mdl->step,
-									   mdl->morton_codes);
-		
-		log_if_debug("radix: %u", i);
-		radix_sort(mdl->morton_codes, mdl->morton_codes_ping, morton_codes_count, 30);
-		
-		//
-		const auto leaf_count = triangle_count;
-		const auto internal_node_count = leaf_count - 1u;
-		log_if_debug("build_bvh: %u (node count: %u/%u)", i, leaf_count, internal_node_count);
-		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh"],
-									   uint1 { internal_node_count },
-									   uint1 { hlbvh_state.kernel_max_local_size["build_bvh"] },
-									   mdl->morton_codes,
-									   mdl->bvh_internal,
-									   mdl->bvh_leaves,
-									   internal_node_count);
-		
-		log_if_debug("build_bvh_aabbs_leaves: %u", i);
-		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh_aabbs_leaves"],
-									   uint1 { leaf_count },
-									   uint1 { hlbvh_state.kernel_max_local_size["build_bvh_aabbs_leaves"] },
-									   mdl->morton_codes,
-									   leaf_count,
-									   mdl->triangles,
-									   mdl->bvh_aabbs_leaves);
-		
-		log_if_debug("build_bvh_aabbs: %u", i);
-		mdl->bvh_aabbs_counters->zero(hlbvh_state.dev_queue);
-		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh_aabbs"],
-									   uint1 { leaf_count },
-									   uint1 { hlbvh_state.kernel_max_local_size["build_bvh_aabbs"] },
-									   mdl->morton_codes,
-									   mdl->bvh_internal,
-									   mdl->bvh_leaves,
-									   internal_node_count,
-									   leaf_count,
-									   mdl->triangles,
-									   mdl->bvh_aabbs,
-									   mdl->bvh_aabbs_leaves,
-									   mdl->bvh_aabbs_counters);
+		build_bvh(models[i], i);
 	}
+	
 	// collide all potential mesh collision pairs with each other
-	for(const auto& col_pair : potential_pairs) {
-		const auto& i = col_pair.x;
-		const auto& j = col_pair.y;
+	for(size_t p = 0; p < potential_pairs.size(); ++p) {
+		if(pair_resolved[p]) continue;
+		
+		const auto& i = potential_pairs[p].x;
+		const auto& j = potential_pairs[p].y;
 		const auto& mdl_i = models[i];
 		const auto& mdl_j = models[j];
 		log_if_debug("collide: %u %u", i, j);
@@ -200,7 +179,199 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 		const auto leaf_count_i = mdl_i->tri_count;
 		const auto leaf_count_j = mdl_j->tri_count;
 		
-		if(hlbvh_state.triangle_vis) {
+		stats.begin(collision_stats::STAGE::COLLIDE_PAIRS, i);
+		if(pair_slots[p] != ~0u) {
+			// full traversal that also refills the cache slot of this pair
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels["collide_bvhs_record_contact_cache"],
+										   uint1 { leaf_count_i },
+										   uint1 { hlbvh_state.kernel_max_local_size["collide_bvhs_record_contact_cache"] },
+										   leaf_count_i,
+										   mdl_i->bvh_aabbs_leaves,
+										   mdl_i->triangles,
+										   mdl_i->morton_codes,
+										   mdl_j->bvh_internal,
+										   mdl_j->bvh_aabbs,
+										   mdl_j->bvh_aabbs_leaves,
+										   mdl_j->triangles,
+										   mdl_j->morton_codes,
+										   i, j,
+										   collision_flags,
+										   contact_cache,
+										   contact_cache_counts,
+										   pair_slots[p]);
+			stats.end();
+			continue;
+		}
+		
+		if(hlbvh_state.tandem && !hlbvh_state.ccd && !hlbvh_state.contacts) {
+			collide_tandem(mdl_i, mdl_j, i, j);
+			stats.end();
+			continue;
+		}
+		
+		if(hlbvh_state.ccd) {
+			const auto kernel_name = (hlbvh_state.triangle_vis ? "collide_bvhs_ccd_tri_vis" : "collide_bvhs_ccd_no_tri_vis");
+			if(hlbvh_state.triangle_vis) {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->triangles_prev,
+											   mdl_i->morton_codes,
+											   leaf_count_j - 1u,
+											   mdl_j->bvh_internal,
+											   mdl_j->bvh_aabbs,
+											   mdl_j->bvh_aabbs_leaves,
+											   mdl_j->triangles,
+											   mdl_j->triangles_prev,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags,
+											   mdl_i->colliding_triangles[mdl_i->colliding_triangles_idx],
+											   mdl_j->colliding_triangles[mdl_j->colliding_triangles_idx]);
+			}
+			else {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->triangles_prev,
+											   mdl_i->morton_codes,
+											   leaf_count_j - 1u,
+											   mdl_j->bvh_internal,
+											   mdl_j->bvh_aabbs,
+											   mdl_j->bvh_aabbs_leaves,
+											   mdl_j->triangles,
+											   mdl_j->triangles_prev,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags);
+			}
+		}
+		else if(hlbvh_state.contacts) {
+			const auto kernel_name = (hlbvh_state.triangle_vis ? "collide_bvhs_contacts_tri_vis" : "collide_bvhs_contacts");
+			if(hlbvh_state.triangle_vis) {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->morton_codes,
+											   leaf_count_j - 1u,
+											   mdl_j->bvh_internal,
+											   mdl_j->bvh_aabbs,
+											   mdl_j->bvh_aabbs_leaves,
+											   mdl_j->triangles,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags,
+											   mdl_i->colliding_triangles[mdl_i->colliding_triangles_idx],
+											   mdl_j->colliding_triangles[mdl_j->colliding_triangles_idx],
+											   contacts,
+											   contacts_counter,
+											   hlbvh_state.max_contacts,
+											   uint32_t(hlbvh_state.contact_points ? 1u : 0u));
+			}
+			else {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->morton_codes,
+											   leaf_count_j - 1u,
+											   mdl_j->bvh_internal,
+											   mdl_j->bvh_aabbs,
+											   mdl_j->bvh_aabbs_leaves,
+											   mdl_j->triangles,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags,
+											   contacts,
+											   contacts_counter,
+											   hlbvh_state.max_contacts,
+											   uint32_t(hlbvh_state.contact_points ? 1u : 0u));
+			}
+		}
+		else if(hlbvh_state.wide_bvh) {
+			const auto kernel_name = (hlbvh_state.triangle_vis ? "collide_bvhs_wide_tri_vis" : "collide_bvhs_wide_no_tri_vis");
+			if(hlbvh_state.triangle_vis) {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->morton_codes,
+											   mdl_j->bvh_wide,
+											   mdl_j->triangles,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags,
+											   mdl_i->colliding_triangles[mdl_i->colliding_triangles_idx],
+											   mdl_j->colliding_triangles[mdl_j->colliding_triangles_idx]);
+			}
+			else {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->morton_codes,
+											   mdl_j->bvh_wide,
+											   mdl_j->triangles,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags);
+			}
+		}
+		else if(hlbvh_state.compressed_bvh) {
+			const auto kernel_name = (hlbvh_state.triangle_vis ? "collide_bvhs_compressed_tri_vis" : "collide_bvhs_compressed_no_tri_vis");
+			if(hlbvh_state.triangle_vis) {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->morton_codes,
+											   mdl_j->bvh_compressed,
+											   mdl_j->triangles,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags,
+											   mdl_i->colliding_triangles[mdl_i->colliding_triangles_idx],
+											   mdl_j->colliding_triangles[mdl_j->colliding_triangles_idx]);
+			}
+			else {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count_i },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count_i,
+											   mdl_i->bvh_aabbs_leaves,
+											   mdl_i->triangles,
+											   mdl_i->morton_codes,
+											   mdl_j->bvh_compressed,
+											   mdl_j->triangles,
+											   mdl_j->morton_codes,
+											   i, j,
+											   collision_flags);
+			}
+		}
+		else if(hlbvh_state.batched_narrowphase) {
+			collide_batched(mdl_i, mdl_j, i, j);
+		}
+		else if(hlbvh_state.persistent) {
+			collide_persistent(mdl_i, mdl_j, i, j);
+		}
+		else if(hlbvh_state.triangle_vis) {
 			hlbvh_state.dev_queue->execute(hlbvh_state.kernels["collide_bvhs_tri_vis"],
 										   uint1 { leaf_count_i },
 										   uint1 { hlbvh_state.kernel_max_local_size["collide_bvhs_tri_vis"] },
@@ -246,6 +417,91 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 										   // also (ab)used as an abort condition here
 										   collision_flags);
 		}
+		stats.end();
+	}
+	
+	// check all models for self-intersections
+	if(hlbvh_state.self_collision) {
+		self_collision_flags->zero(hlbvh_state.dev_queue);
+		const auto kernel_name = (hlbvh_state.ccd ?
+								  (hlbvh_state.triangle_vis ? "collide_bvh_self_ccd_tri_vis" : "collide_bvh_self_ccd_no_tri_vis") :
+								  (hlbvh_state.triangle_vis ? "collide_bvh_self_tri_vis" : "collide_bvh_self_no_tri_vis"));
+		for(uint32_t i = 0; i < model_count; ++i) {
+			const auto& mdl = models[i];
+			const auto leaf_count = mdl->tri_count;
+			log_if_debug("collide self: %u", i);
+			stats.begin(collision_stats::STAGE::SELF_COLLISION, i);
+			if(hlbvh_state.ccd && hlbvh_state.triangle_vis) {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count,
+											   mdl->bvh_internal,
+											   mdl->bvh_aabbs,
+											   mdl->bvh_aabbs_leaves,
+											   mdl->triangles,
+											   mdl->triangles_prev,
+											   mdl->get_indices_buffer(mdl->cur_frame),
+											   mdl->morton_codes,
+											   i,
+											   collision_flags,
+											   self_collision_flags,
+											   mdl->colliding_triangles[mdl->colliding_triangles_idx]);
+			}
+			else if(hlbvh_state.ccd) {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count,
+											   mdl->bvh_internal,
+											   mdl->bvh_aabbs,
+											   mdl->bvh_aabbs_leaves,
+											   mdl->triangles,
+											   mdl->triangles_prev,
+											   mdl->get_indices_buffer(mdl->cur_frame),
+											   mdl->morton_codes,
+											   i,
+											   collision_flags,
+											   self_collision_flags);
+			}
+			else if(hlbvh_state.triangle_vis) {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count,
+											   mdl->bvh_internal,
+											   mdl->bvh_aabbs,
+											   mdl->bvh_aabbs_leaves,
+											   mdl->triangles,
+											   mdl->get_indices_buffer(mdl->cur_frame),
+											   mdl->morton_codes,
+											   i,
+											   collision_flags,
+											   self_collision_flags,
+											   mdl->colliding_triangles[mdl->colliding_triangles_idx]);
+			}
+			else {
+				hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+											   uint1 { leaf_count },
+											   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+											   leaf_count,
+											   mdl->bvh_internal,
+											   mdl->bvh_aabbs,
+											   mdl->bvh_aabbs_leaves,
+											   mdl->triangles,
+											   mdl->get_indices_buffer(mdl->cur_frame),
+											   mdl->morton_codes,
+											   i,
+											   collision_flags,
+											   self_collision_flags);
+			}
+			stats.end();
+		}
+		// NOTE: device collision flags aren't read back at this point, so neither are the self-collision flags
+		if(!hlbvh_state.device_collision_flags) {
+			self_collision_flags->read(hlbvh_state.dev_queue, self_collision_flags_host.data(),
+									   self_collision_flags_host.size() * sizeof(uint32_t));
+		}
 	}
 	
 	//
@@ -257,9 +513,8 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 		log_debug("time: %fms", ((long double)stop_time) / 1000.0L);
 	}
 	
-	// copy to host + return
-	// TODO: share buffer with gl/metal instead? (unless doing cpu side checking)
-	collision_flags->read(hlbvh_state.dev_queue, &collision_flags_host[0]);
+	// copy to host (or keep on the device) + return
+	finish_collision_flags();
 #if 0 // log collided models
 	string collision_str = "collisions: ";
 	for(const auto& col_flag : collision_flags_host) {
@@ -274,21 +529,949 @@ const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& m
 			const auto cur_frame = mdl->cur_frame;
 			const auto triangle_count = mdl->tri_count;
 			mdl->colliding_vertices->zero(hlbvh_state.dev_queue);
-			if(collision_flags_host[i] > 0) {
+			// NOTE: device collision flags aren't known on the host yet -> always map
+			if(hlbvh_state.device_collision_flags || collision_flags_host[i] > 0) {
+				stats.begin(collision_stats::STAGE::MAP_COLLIDED_TRIANGLES, i);
 				hlbvh_state.dev_queue->execute(hlbvh_state.kernels["map_collided_triangles"],
 											   uint1 { triangle_count },
 											   uint1 { hlbvh_state.kernel_max_local_size["map_collided_triangles"] },
 											   mdl->colliding_triangles[mdl->colliding_triangles_idx],
-											   mdl->frames_indices[cur_frame],
+											   mdl->get_indices_buffer(cur_frame),
 											   mdl->colliding_vertices,
 											   triangle_count);
+				stats.end();
 			}
 		}
 	}
 	
+	stats.end_frame();
+	return collision_flags_host;
+}
+
+const vector<uint32_t>& collider::collide(const vector<unique_ptr<animation>>& models,
+										  const vector<animation_instance>& instances) {
+	if(models.empty() || instances.empty()) return collision_flags_host;
+	if(hlbvh_state.stop) return collision_flags_host;
+	
+	stats.begin_frame();
+	if(hlbvh_state.benchmark) {
+		hlbvh_state.dev_queue->finish();
+	}
+	const auto start_time = floor_timer::start();
+	
+	// same as above, but:
+	// * root aabbs and bvhs are computed per animation (in local space)
+	// * root aabbs are then transformed into world space per instance and collided with each other
+	// * bvhs are only built for animations that have at least one potentially colliding instance
+	// * instance pairs are collided in the local space of the second instance
+	const auto model_count = models.size();
+	const auto instance_count = instances.size();
+	
+	if(model_count != allocated_model_count || instance_count != allocated_instance_count) {
+		// force re-alloc in the non-instanced collide()
+		allocated_model_count = 0;
+		allocated_instance_count = instance_count;
+		
+		alloc_collision_flags(instance_count);
+		
+		grow_buffer(aabbs, model_count * sizeof(float3) * 2, COMPUTE_MEMORY_FLAG::READ_WRITE);
+		grow_buffer(instance_aabbs, instance_count * sizeof(float3) * 2, COMPUTE_MEMORY_FLAG::READ_WRITE);
+		grow_buffer(instance_animations, instance_count * sizeof(uint32_t),
+					COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		grow_buffer(instance_transforms, instance_count * sizeof(matrix4f),
+					COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		grow_buffer(instance_inv_transforms, instance_count * sizeof(matrix4f),
+					COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		instance_animations_host.resize(instance_count);
+		instance_transforms_host.resize(instance_count);
+		instance_inv_transforms_host.resize(instance_count);
+	}
+	
+	// init all data (every time this is called)
+	swap_collision_flags();
+	collision_flags->zero(hlbvh_state.dev_queue);
+	bvh_built.clear();
+	
+	// instance transforms may change every frame
+	for(size_t i = 0; i < instance_count; ++i) {
+		instance_animations_host[i] = instances[i].animation_idx;
+		instance_transforms_host[i] = instances[i].transform;
+		instance_inv_transforms_host[i] = instances[i].transform.inverted();
+	}
+	instance_animations->write(hlbvh_state.dev_queue, instance_animations_host);
+	instance_transforms->write(hlbvh_state.dev_queue, instance_transforms_host);
+	instance_inv_transforms->write(hlbvh_state.dev_queue, instance_inv_transforms_host);
+	
+	init_aabbs(uint32_t(model_count));
+	
+	// compute local space root aabbs (once per animation)
+	for(uint32_t mdl_idx = 0; mdl_idx < uint32_t(model_count); ++mdl_idx) {
+		const auto& mdl = models[mdl_idx];
+		const auto triangle_count = mdl->tri_count;
+		log_if_debug("build_aabbs: %u (%u)", mdl_idx, triangle_count);
+		stats.begin(collision_stats::STAGE::BUILD_AABBS, mdl_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_aabbs"],
+									   uint1 { triangle_count },
+									   uint1 { ROOT_AABB_GROUP_SIZE },
+									   mdl->get_triangles_buffer(mdl->cur_frame),
+									   mdl->get_triangles_buffer(mdl->next_frame),
+									   triangle_count,
+									   mdl_idx,
+									   mdl->step,
+									   aabbs,
+									   mdl->triangles);
+		stats.end();
+	}
+	
+	// -> world space instance root aabbs
+	stats.begin(collision_stats::STAGE::ROOT_AABBS);
+	hlbvh_state.dev_queue->execute(hlbvh_state.kernels["transform_root_aabbs"],
+								   uint1 { uint32_t(instance_count) },
+								   uint1 { hlbvh_state.kernel_max_local_size["transform_root_aabbs"] },
+								   aabbs,
+								   instance_animations,
+								   instance_transforms,
+								   uint32_t(instance_count),
+								   instance_aabbs);
+	
+	auto& valid_instances = valid_instances_host;
+	auto& potential_pairs = potential_pairs_host;
+	valid_instances.clear();
+	potential_pairs.clear();
+	find_potential_pairs(instance_aabbs, uint32_t(instance_count), valid_instances, potential_pairs);
+	stats.end();
+	
+	// compute bvh (once per animation)
+	auto& valid_meshes = valid_meshes_host;
+	valid_meshes.clear();
+	for(const auto& i : valid_instances) {
+		valid_meshes.insert(instances[i].animation_idx);
+	}
+	for(const auto& i : valid_meshes) {
+		build_bvh(models[i], i);
+	}
+	
+	// collide all potential instance collision pairs with each other
+	for(const auto& col_pair : potential_pairs) {
+		const auto& i = col_pair.x;
+		const auto& j = col_pair.y;
+		const auto& mdl_i = models[instances[i].animation_idx];
+		const auto& mdl_j = models[instances[j].animation_idx];
+		log_if_debug("collide instances: %u %u", i, j);
+		
+		const auto leaf_count_i = mdl_i->tri_count;
+		stats.begin(collision_stats::STAGE::COLLIDE_PAIRS, instances[i].animation_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["collide_bvhs_instanced"],
+									   uint1 { leaf_count_i },
+									   uint1 { hlbvh_state.kernel_max_local_size["collide_bvhs_instanced"] },
+									   leaf_count_i,
+									   mdl_i->bvh_aabbs_leaves,
+									   mdl_i->triangles,
+									   mdl_i->morton_codes,
+									   mdl_j->bvh_internal,
+									   mdl_j->bvh_aabbs,
+									   mdl_j->bvh_aabbs_leaves,
+									   mdl_j->triangles,
+									   mdl_j->morton_codes,
+									   instance_transforms,
+									   instance_inv_transforms,
+									   i, j,
+									   collision_flags);
+		stats.end();
+	}
+	
+	//
+	if(hlbvh_state.benchmark) {
+		hlbvh_state.dev_queue->finish();
+	}
+	const auto stop_time = floor_timer::stop<chrono::microseconds>(start_time);
+	if(hlbvh_state.benchmark) {
+		log_debug("time: %fms", ((long double)stop_time) / 1000.0L);
+	}
+	
+	finish_collision_flags();
+	stats.end_frame();
 	return collision_flags_host;
 }
 
+void collider::alloc_collision_flags(const size_t count) {
+	collision_flags_host.assign(count, 0u);
+	if(!hlbvh_state.device_collision_flags) {
+		grow_buffer(collision_flags, count * sizeof(uint32_t), COMPUTE_MEMORY_FLAG::WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+		return;
+	}
+	
+	// double-buffered, so that the renderer (and the delayed read back) can use the flags of the last frame while
+	// the next frame is already being computed
+	for(auto& flags_buffer : collision_flags_buffers) {
+		if(!hlbvh_state.no_opengl) {
+			grow_buffer(flags_buffer, count * sizeof(uint32_t),
+						COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE | COMPUTE_MEMORY_FLAG::OPENGL_SHARING,
+						GL_ARRAY_BUFFER);
+		}
+		else {
+			grow_buffer(flags_buffer, count * sizeof(uint32_t),
+						COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+		}
+	}
+	collision_flags_idx = 0;
+	collision_flags = collision_flags_buffers[0];
+	collision_flags_pending = false;
+}
+
+bool collider::grow_buffer(shared_ptr<compute_buffer>& buffer, const size_t size,
+						   const COMPUTE_MEMORY_FLAG flags, const uint32_t opengl_type) {
+	if(buffer && buffer->get_size() >= size) return false;
+	const auto capacity = max(size, buffer ? buffer->get_size() * 2u : size);
+	buffer = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, capacity, flags, opengl_type);
+	return true;
+}
+
+void collider::init_aabbs(const uint32_t count) {
+	hlbvh_state.dev_queue->execute(hlbvh_state.kernels["init_aabbs"],
+								   uint1 { count },
+								   uint1 { hlbvh_state.kernel_max_local_size["init_aabbs"] },
+								   aabbs,
+								   count);
+}
+
+void collider::swap_collision_flags() {
+	if(!hlbvh_state.device_collision_flags) return;
+	if(collision_flags_pending && hlbvh_state.collision_flags_readback) {
+		collision_flags->read(hlbvh_state.dev_queue, collision_flags_host.data(), collision_flags_host.size() * sizeof(uint32_t));
+	}
+	collision_flags_pending = false;
+	collision_flags_idx = 1u - collision_flags_idx;
+	collision_flags = collision_flags_buffers[collision_flags_idx];
+}
+
+void collider::finish_collision_flags() {
+	if(!hlbvh_state.device_collision_flags) {
+		collision_flags->read(hlbvh_state.dev_queue, collision_flags_host.data(), collision_flags_host.size() * sizeof(uint32_t));
+		return;
+	}
+	collision_flags_pending = true;
+}
+
+void collider::find_potential_pairs(shared_ptr<compute_buffer> root_aabbs,
+									   const uint32_t count,
+									   unordered_set<uint32_t>& valid_meshes,
+									   vector<uint2>& potential_pairs) {
+	const bool use_sweep = (hlbvh_state.broadphase == 2 ||
+							(hlbvh_state.broadphase == 0 && count >= SWEEP_BROADPHASE_MESH_THRESHOLD));
+	if(use_sweep) {
+		find_potential_pairs_sweep(root_aabbs, count, valid_meshes, potential_pairs);
+		return;
+	}
+	
+	const auto total_aabb_checks = (count * count - count) / 2u;
+	grow_buffer(aabb_collision_flags, total_aabb_checks * sizeof(uint32_t),
+				COMPUTE_MEMORY_FLAG::WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+	aabb_collision_flags->zero(hlbvh_state.dev_queue);
+	
+	log_if_debug("collide_root_aabbs");
+	aabb_collision_flags_host.resize(total_aabb_checks);
+	hlbvh_state.dev_queue->execute(hlbvh_state.kernels["collide_root_aabbs"],
+								   uint1 { total_aabb_checks },
+								   uint1 { hlbvh_state.kernel_max_local_size["collide_root_aabbs"] },
+								   root_aabbs,
+								   total_aabb_checks,
+								   count,
+								   aabb_collision_flags);
+	
+	// read back aabb collision flags
+	aabb_collision_flags->read(hlbvh_state.dev_queue, aabb_collision_flags_host.data(), total_aabb_checks * sizeof(uint32_t));
+	
+	// we're only interessted in further constructing+colliding bvhs for meshes whose root aabbs collide with something
+	// and also only the resp. collision pairs
+	for(uint32_t lin_idx = 0; lin_idx < total_aabb_checks; ++lin_idx) {
+		if(aabb_collision_flags_host[lin_idx] != 0) {
+			// reverse cantor (map 1D linear index onto "half triangle" of a square -> all unique combinations of (i, j), with i != j)
+			const auto q = (uint32_t)((const_math::EPSILON<float> + sqrt(1.0f + 8.0f * float(lin_idx))) * 0.5f - 0.5f);
+			const auto i = lin_idx - (q * (q + 1u)) / 2u;
+			const auto j = count - q + i - 1u;
+			valid_meshes.insert(i);
+			valid_meshes.insert(j);
+			potential_pairs.emplace_back(i, j);
+			log_if_debug("possible collision: %u <-> %u", i, j);
+		}
+	}
+}
+
+void collider::find_potential_pairs_sweep(shared_ptr<compute_buffer> root_aabbs,
+										 const uint32_t count,
+										 unordered_set<uint32_t>& valid_meshes,
+										 vector<uint2>& potential_pairs) {
+	// sort keys need to be padded for radix sort (see animation morton codes)
+	static constexpr const uint32_t rs_alignment = 32u * COMPACTION_GROUP_SIZE;
+	const auto key_count = ((count + rs_alignment - 1u) / rs_alignment) * rs_alignment;
+	grow_buffer(sweep_keys, key_count * sizeof(uint2), COMPUTE_MEMORY_FLAG::READ_WRITE);
+	grow_buffer(sweep_keys_ping, key_count * sizeof(uint2), COMPUTE_MEMORY_FLAG::READ_WRITE);
+	if(!sweep_pair_counter) {
+		sweep_pair_counter = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, sizeof(uint32_t),
+															COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+	}
+	
+	// sort all root aabbs by their min x
+	log_if_debug("compute_sweep_keys");
+	hlbvh_state.dev_queue->execute(hlbvh_state.kernels["compute_sweep_keys"],
+								   uint1 { key_count },
+								   uint1 { hlbvh_state.kernel_max_local_size["compute_sweep_keys"] },
+								   root_aabbs,
+								   count,
+								   key_count,
+								   sweep_keys);
+	radix_sort(sweep_keys, sweep_keys_ping, key_count, 32);
+	
+	// sweep, re-run with a larger pairs buffer if there wasn't enough space
+	uint32_t pair_count = 0;
+	for(;;) {
+		// use the whole capacity of the pooled buffer
+		grow_buffer(sweep_pairs, max_sweep_pairs * sizeof(uint2),
+					COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+		max_sweep_pairs = uint32_t(sweep_pairs->get_size() / sizeof(uint2));
+		
+		log_if_debug("sweep_root_aabbs");
+		sweep_pair_counter->zero(hlbvh_state.dev_queue);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["sweep_root_aabbs"],
+									   uint1 { count },
+									   uint1 { hlbvh_state.kernel_max_local_size["sweep_root_aabbs"] },
+									   root_aabbs,
+									   sweep_keys,
+									   count,
+									   sweep_pairs,
+									   sweep_pair_counter,
+									   max_sweep_pairs);
+		sweep_pair_counter->read_to(pair_count, hlbvh_state.dev_queue);
+		if(pair_count <= max_sweep_pairs) {
+			break;
+		}
+		max_sweep_pairs = pair_count;
+	}
+	
+	potential_pairs.resize(pair_count);
+	if(pair_count > 0) {
+		sweep_pairs->read(hlbvh_state.dev_queue, &potential_pairs[0], pair_count * sizeof(uint2));
+	}
+	for(const auto& pair : potential_pairs) {
+		valid_meshes.insert(pair.x);
+		valid_meshes.insert(pair.y);
+		log_if_debug("possible collision: %u <-> %u", pair.x, pair.y);
+	}
+}
+
+void collider::collide_tandem(const unique_ptr<animation>& mdl_a, const unique_ptr<animation>& mdl_b,
+							  const uint32_t mdl_idx_a, const uint32_t mdl_idx_b) {
+	if(!tandem_node_pairs[0]) {
+		for(uint32_t i = 0; i < 2; ++i) {
+			tandem_node_pairs[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, TANDEM_MAX_NODE_PAIRS * sizeof(uint2),
+																  COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+			tandem_node_pair_counts[i] = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, sizeof(uint32_t),
+																		COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		}
+		tandem_node_pair_queue_head = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, sizeof(uint32_t),
+																	 COMPUTE_MEMORY_FLAG::READ_WRITE);
+	}
+	
+	// start with both root nodes
+	static const uint2 root_pair { 0u, 0u };
+	static const uint32_t root_pair_count { 1u };
+	tandem_node_pairs[0]->write(hlbvh_state.dev_queue, &root_pair, sizeof(uint2));
+	tandem_node_pair_counts[0]->write(hlbvh_state.dev_queue, &root_pair_count, sizeof(uint32_t));
+	
+	// breadth-first expansion of the first levels: level N contains at most 2^N pairs, which also determines the
+	// launch size (the actual pair count is only known on the device)
+	const auto expand_name = (hlbvh_state.triangle_vis ? "expand_tandem_node_pairs_tri_vis" : "expand_tandem_node_pairs_no_tri_vis");
+	const auto expand_local_size = hlbvh_state.kernel_max_local_size[expand_name];
+	uint32_t in_idx = 0;
+	for(uint32_t level = 0; level < TANDEM_SEED_LEVELS; ++level) {
+		const auto out_idx = 1u - in_idx;
+		const auto global_size = min(((1u << level) + expand_local_size - 1u) / expand_local_size * expand_local_size,
+									 TANDEM_MAX_THREADS);
+		log_if_debug("expand tandem: %u %u, level %u", mdl_idx_a, mdl_idx_b, level);
+		
+		tandem_node_pair_counts[out_idx]->zero(hlbvh_state.dev_queue);
+		if(hlbvh_state.triangle_vis) {
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels[expand_name],
+										   uint1 { global_size },
+										   uint1 { expand_local_size },
+										   tandem_node_pairs[in_idx],
+										   tandem_node_pair_counts[in_idx],
+										   tandem_node_pairs[out_idx],
+										   tandem_node_pair_counts[out_idx],
+										   mdl_a->bvh_internal,
+										   mdl_a->bvh_aabbs,
+										   mdl_a->bvh_aabbs_leaves,
+										   mdl_a->triangles,
+										   mdl_a->morton_codes,
+										   mdl_b->bvh_internal,
+										   mdl_b->bvh_aabbs,
+										   mdl_b->bvh_aabbs_leaves,
+										   mdl_b->triangles,
+										   mdl_b->morton_codes,
+										   mdl_idx_a, mdl_idx_b,
+										   collision_flags,
+										   mdl_a->colliding_triangles[mdl_a->colliding_triangles_idx],
+										   mdl_b->colliding_triangles[mdl_b->colliding_triangles_idx]);
+		}
+		else {
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels[expand_name],
+										   uint1 { global_size },
+										   uint1 { expand_local_size },
+										   tandem_node_pairs[in_idx],
+										   tandem_node_pair_counts[in_idx],
+										   tandem_node_pairs[out_idx],
+										   tandem_node_pair_counts[out_idx],
+										   mdl_a->bvh_internal,
+										   mdl_a->bvh_aabbs,
+										   mdl_a->bvh_aabbs_leaves,
+										   mdl_a->triangles,
+										   mdl_a->morton_codes,
+										   mdl_b->bvh_internal,
+										   mdl_b->bvh_aabbs,
+										   mdl_b->bvh_aabbs_leaves,
+										   mdl_b->triangles,
+										   mdl_b->morton_codes,
+										   mdl_idx_a, mdl_idx_b,
+										   collision_flags);
+		}
+		in_idx = out_idx;
+	}
+	
+	// depth-first traversal of all remaining pairs (work-items pop pairs from the queue until it is empty)
+	const auto kernel_name = (hlbvh_state.triangle_vis ? "collide_bvhs_tandem_tri_vis" : "collide_bvhs_tandem_no_tri_vis");
+	const auto local_size = hlbvh_state.kernel_max_local_size[kernel_name];
+	const auto global_size = min((TANDEM_MAX_NODE_PAIRS + local_size - 1u) / local_size * local_size, TANDEM_MAX_THREADS);
+	log_if_debug("collide tandem: %u %u", mdl_idx_a, mdl_idx_b);
+	tandem_node_pair_queue_head->zero(hlbvh_state.dev_queue);
+	if(hlbvh_state.triangle_vis) {
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+									   uint1 { global_size },
+									   uint1 { local_size },
+									   tandem_node_pairs[in_idx],
+									   tandem_node_pair_counts[in_idx],
+									   tandem_node_pair_queue_head,
+									   mdl_a->bvh_internal,
+									   mdl_a->bvh_aabbs,
+									   mdl_a->bvh_aabbs_leaves,
+									   mdl_a->triangles,
+									   mdl_a->morton_codes,
+									   mdl_b->bvh_internal,
+									   mdl_b->bvh_aabbs,
+									   mdl_b->bvh_aabbs_leaves,
+									   mdl_b->triangles,
+									   mdl_b->morton_codes,
+									   mdl_idx_a, mdl_idx_b,
+									   collision_flags,
+									   mdl_a->colliding_triangles[mdl_a->colliding_triangles_idx],
+									   mdl_b->colliding_triangles[mdl_b->colliding_triangles_idx]);
+	}
+	else {
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+									   uint1 { global_size },
+									   uint1 { local_size },
+									   tandem_node_pairs[in_idx],
+									   tandem_node_pair_counts[in_idx],
+									   tandem_node_pair_queue_head,
+									   mdl_a->bvh_internal,
+									   mdl_a->bvh_aabbs,
+									   mdl_a->bvh_aabbs_leaves,
+									   mdl_a->triangles,
+									   mdl_a->morton_codes,
+									   mdl_b->bvh_internal,
+									   mdl_b->bvh_aabbs,
+									   mdl_b->bvh_aabbs_leaves,
+									   mdl_b->triangles,
+									   mdl_b->morton_codes,
+									   mdl_idx_a, mdl_idx_b,
+									   collision_flags);
+	}
+}
+
+void collider::collide_batched(const unique_ptr<animation>& mdl_a, const unique_ptr<animation>& mdl_b,
+							   const uint32_t mdl_idx_a, const uint32_t mdl_idx_b) {
+	if(!narrowphase_candidates) {
+		narrowphase_candidates = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, NARROWPHASE_MAX_CANDIDATES * sizeof(uint2),
+																COMPUTE_MEMORY_FLAG::READ_WRITE);
+		narrowphase_candidate_counter = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, sizeof(uint32_t),
+																	   COMPUTE_MEMORY_FLAG::READ_WRITE);
+	}
+	narrowphase_candidate_counter->zero(hlbvh_state.dev_queue);
+	
+	const auto leaf_count_a = mdl_a->tri_count;
+	const auto collect_name = (hlbvh_state.triangle_vis ? "collect_candidate_pairs_tri_vis" : "collect_candidate_pairs_no_tri_vis");
+	const auto test_name = (hlbvh_state.triangle_vis ? "test_candidate_pairs_tri_vis" : "test_candidate_pairs_no_tri_vis");
+	
+	// the test pass loops over all candidates, so only launch enough work-groups to fill the device
+	// (if the unit count is unknown, assume 16)
+	const auto test_local_size = hlbvh_state.kernel_max_local_size[test_name];
+	const auto unit_count = (hlbvh_state.dev->units != 0 ? hlbvh_state.dev->units : 16u);
+	const auto test_global_size = unit_count * PERSISTENT_GROUPS_PER_UNIT * test_local_size;
+	
+	if(hlbvh_state.triangle_vis) {
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels[collect_name],
+									   uint1 { leaf_count_a },
+									   uint1 { hlbvh_state.kernel_max_local_size[collect_name] },
+									   0u,
+									   leaf_count_a,
+									   mdl_a->bvh_aabbs_leaves,
+									   mdl_a->triangles,
+									   mdl_a->morton_codes,
+									   mdl_b->bvh_internal,
+									   mdl_b->bvh_aabbs,
+									   mdl_b->bvh_aabbs_leaves,
+									   mdl_b->triangles,
+									   mdl_b->morton_codes,
+									   mdl_idx_a, mdl_idx_b,
+									   collision_flags,
+									   mdl_a->colliding_triangles[mdl_a->colliding_triangles_idx],
+									   mdl_b->colliding_triangles[mdl_b->colliding_triangles_idx],
+									   narrowphase_candidates,
+									   narrowphase_candidate_counter);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels[test_name],
+									   uint1 { test_global_size },
+									   uint1 { test_local_size },
+									   narrowphase_candidates,
+									   narrowphase_candidate_counter,
+									   mdl_a->triangles,
+									   mdl_b->triangles,
+									   mdl_idx_a, mdl_idx_b,
+									   collision_flags,
+									   mdl_a->colliding_triangles[mdl_a->colliding_triangles_idx],
+									   mdl_b->colliding_triangles[mdl_b->colliding_triangles_idx]);
+	}
+	else {
+		// collect + test in chunks of leaves: the test pass of each chunk sets the collision flags, which then lets the
+		// collection of all following chunks stop early (the flags are only ever checked on the device)
+		for(uint32_t first_leaf = 0; first_leaf < leaf_count_a; first_leaf += NARROWPHASE_COLLECT_CHUNK_SIZE) {
+			const auto chunk_leaf_count = min(leaf_count_a - first_leaf, NARROWPHASE_COLLECT_CHUNK_SIZE);
+			if(first_leaf > 0) {
+				narrowphase_candidate_counter->zero(hlbvh_state.dev_queue);
+			}
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels[collect_name],
+										   uint1 { chunk_leaf_count },
+										   uint1 { hlbvh_state.kernel_max_local_size[collect_name] },
+										   first_leaf,
+										   chunk_leaf_count,
+										   mdl_a->bvh_aabbs_leaves,
+										   mdl_a->triangles,
+										   mdl_a->morton_codes,
+										   mdl_b->bvh_internal,
+										   mdl_b->bvh_aabbs,
+										   mdl_b->bvh_aabbs_leaves,
+										   mdl_b->triangles,
+										   mdl_b->morton_codes,
+										   mdl_idx_a, mdl_idx_b,
+										   collision_flags,
+										   narrowphase_candidates,
+										   narrowphase_candidate_counter);
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels[test_name],
+										   uint1 { test_global_size },
+										   uint1 { test_local_size },
+										   narrowphase_candidates,
+										   narrowphase_candidate_counter,
+										   mdl_a->triangles,
+										   mdl_b->triangles,
+										   mdl_idx_a, mdl_idx_b,
+										   collision_flags);
+		}
+	}
+}
+
+void collider::collide_persistent(const unique_ptr<animation>& mdl_a, const unique_ptr<animation>& mdl_b,
+								  const uint32_t mdl_idx_a, const uint32_t mdl_idx_b) {
+	if(!persistent_leaf_counter) {
+		persistent_leaf_counter = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, sizeof(uint32_t),
+																 COMPUTE_MEMORY_FLAG::READ_WRITE);
+	}
+	persistent_leaf_counter->zero(hlbvh_state.dev_queue);
+	
+	const auto leaf_count_a = mdl_a->tri_count;
+	const auto leaf_count_b = mdl_b->tri_count;
+	const auto kernel_name = (hlbvh_state.triangle_vis ? "collide_bvhs_persistent_tri_vis" : "collide_bvhs_persistent_no_tri_vis");
+	const auto local_size = hlbvh_state.kernel_max_local_size[kernel_name];
+	
+	// launch enough work-groups to fill the device, but no more than there are leaf batches
+	// (if the unit count is unknown, assume 16)
+	const auto unit_count = (hlbvh_state.dev->units != 0 ? hlbvh_state.dev->units : 16u);
+	const auto batch_count = (leaf_count_a + PERSISTENT_LEAF_BATCH_SIZE - 1u) / PERSISTENT_LEAF_BATCH_SIZE;
+	const auto group_count = max(min(unit_count * PERSISTENT_GROUPS_PER_UNIT, (batch_count + local_size - 1u) / local_size), 1u);
+	
+	if(hlbvh_state.triangle_vis) {
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+									   uint1 { group_count * local_size },
+									   uint1 { local_size },
+									   leaf_count_a,
+									   mdl_a->bvh_aabbs_leaves,
+									   mdl_a->triangles,
+									   mdl_a->morton_codes,
+									   leaf_count_b - 1u,
+									   mdl_b->bvh_internal,
+									   mdl_b->bvh_aabbs,
+									   mdl_b->bvh_aabbs_leaves,
+									   mdl_b->triangles,
+									   mdl_b->morton_codes,
+									   mdl_idx_a, mdl_idx_b,
+									   collision_flags,
+									   mdl_a->colliding_triangles[mdl_a->colliding_triangles_idx],
+									   mdl_b->colliding_triangles[mdl_b->colliding_triangles_idx],
+									   persistent_leaf_counter);
+	}
+	else {
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+									   uint1 { group_count * local_size },
+									   uint1 { local_size },
+									   leaf_count_a,
+									   mdl_a->bvh_aabbs_leaves,
+									   mdl_a->triangles,
+									   mdl_a->morton_codes,
+									   leaf_count_b - 1u,
+									   mdl_b->bvh_internal,
+									   mdl_b->bvh_aabbs,
+									   mdl_b->bvh_aabbs_leaves,
+									   mdl_b->triangles,
+									   mdl_b->morton_codes,
+									   mdl_idx_a, mdl_idx_b,
+									   collision_flags,
+									   persistent_leaf_counter);
+	}
+}
+
+void collider::resolve_contact_cache(const uint32_t model_count,
+									 const vector<unique_ptr<animation>>& models,
+									 const vector<uint2>& potential_pairs,
+									 vector<uint8_t>& pair_resolved,
+									 vector<uint32_t>& pair_slots) {
+	if(!contact_cache) {
+		contact_cache = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, CONTACT_CACHE_MAX_PAIRS * CONTACT_CACHE_SIZE * sizeof(uint2),
+													   COMPUTE_MEMORY_FLAG::READ_WRITE);
+		contact_cache_counts = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, CONTACT_CACHE_MAX_PAIRS * sizeof(uint32_t),
+															  COMPUTE_MEMORY_FLAG::READ_WRITE);
+		contact_cache_hits = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, CONTACT_CACHE_MAX_PAIRS * sizeof(uint32_t),
+															COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+		contact_cache_meshes = hlbvh_state.ctx->create_buffer(hlbvh_state.dev, CONTACT_CACHE_MAX_PAIRS * sizeof(uint2),
+															  COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		contact_cache_meshes_host.reserve(CONTACT_CACHE_MAX_PAIRS);
+	}
+	
+	// periodically (and when the models change) drop all cached pairs, so that every pair is fully traversed again
+	if(model_count != contact_cache_model_count || (contact_cache_frame % CONTACT_CACHE_REFRESH_INTERVAL) == 0) {
+		contact_cache_model_count = model_count;
+		contact_cache_slots.clear();
+		contact_cache_meshes_host.clear();
+		contact_cache_counts->zero(hlbvh_state.dev_queue);
+	}
+	++contact_cache_frame;
+	
+	bool any_cached = false;
+	for(size_t p = 0; p < potential_pairs.size(); ++p) {
+		const auto slot_iter = contact_cache_slots.find((uint64_t(potential_pairs[p].x) << 32ull) |
+														uint64_t(potential_pairs[p].y));
+		if(slot_iter == contact_cache_slots.end()) continue;
+		pair_slots[p] = slot_iter->second;
+		any_cached = true;
+	}
+	
+	// re-test the cached pairs of all slots at once (this first gathers the triangles of each involved mesh),
+	// then drop the cached pairs of all slots that no longer collide, so that these can be refilled
+	const auto slot_count = uint32_t(contact_cache_slots.size());
+	auto& hits = contact_cache_hits_host;
+	if(any_cached) {
+		const auto cache_entry_count = slot_count * CONTACT_CACHE_SIZE;
+		grow_buffer(contact_cache_triangles, cache_entry_count * sizeof(float3) * 6u, COMPUTE_MEMORY_FLAG::READ_WRITE);
+		contact_cache_hits->zero(hlbvh_state.dev_queue);
+		
+		contact_cache_mesh_flags.assign(model_count, 0u);
+		for(const auto& meshes : contact_cache_meshes_host) {
+			contact_cache_mesh_flags[meshes.x] = 1u;
+			contact_cache_mesh_flags[meshes.y] = 1u;
+		}
+		for(uint32_t i = 0; i < model_count; ++i) {
+			if(!contact_cache_mesh_flags[i]) continue;
+			hlbvh_state.dev_queue->execute(hlbvh_state.kernels["gather_contact_cache_triangles"],
+										   uint1 { cache_entry_count },
+										   uint1 { hlbvh_state.kernel_max_local_size["gather_contact_cache_triangles"] },
+										   contact_cache,
+										   contact_cache_counts,
+										   contact_cache_meshes,
+										   slot_count,
+										   i,
+										   models[i]->triangles,
+										   contact_cache_triangles);
+		}
+		
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["retest_contact_cache"],
+									   uint1 { cache_entry_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["retest_contact_cache"] },
+									   contact_cache_counts,
+									   contact_cache_meshes,
+									   contact_cache_triangles,
+									   slot_count,
+									   collision_flags,
+									   contact_cache_hits);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["reset_contact_cache_misses"],
+									   uint1 { slot_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["reset_contact_cache_misses"] },
+									   contact_cache_hits,
+									   slot_count,
+									   contact_cache_counts);
+		
+		// the host still needs to know which pairs are resolved, so that their bvh builds and traversals can be
+		// skipped (single small read back, this is the only sync point of the contact cache)
+		hits.resize(slot_count);
+		contact_cache_hits->read(hlbvh_state.dev_queue, hits.data(), slot_count * sizeof(uint32_t));
+	}
+	
+	// unresolved pairs without a slot: allocate a new one (if still possible)
+	// NOTE: counts of new slots are still zero from the last refresh
+	for(size_t p = 0; p < potential_pairs.size(); ++p) {
+		if(pair_slots[p] != ~0u) {
+			if(hits[pair_slots[p]] != 0u) {
+				pair_resolved[p] = 1u;
+			}
+		}
+		else if(contact_cache_slots.size() < CONTACT_CACHE_MAX_PAIRS) {
+			pair_slots[p] = uint32_t(contact_cache_slots.size());
+			contact_cache_slots.emplace((uint64_t(potential_pairs[p].x) << 32ull) | uint64_t(potential_pairs[p].y),
+										pair_slots[p]);
+			contact_cache_meshes_host.emplace_back(potential_pairs[p]);
+		}
+	}
+	
+	// upload the meshes of all new slots at once
+	if(contact_cache_meshes_host.size() > slot_count) {
+		contact_cache_meshes->write(hlbvh_state.dev_queue, &contact_cache_meshes_host[slot_count],
+									(contact_cache_meshes_host.size() - slot_count) * sizeof(uint2),
+									slot_count * sizeof(uint2));
+	}
+}
+
+void collider::build_bvh(const unique_ptr<animation>& mdl, const uint32_t mdl_idx) {
+	const auto cur_frame = mdl->cur_frame, next_frame = mdl->next_frame;
+	const auto triangle_count = mdl->tri_count;
+	const auto morton_codes_count = uint32_t(mdl->morton_codes->get_size() / sizeof(uint2));
+	
+	const auto leaf_count = triangle_count;
+	const auto internal_node_count = leaf_count - 1u;
+	if(mdl_idx < bvh_built.size()) {
+		bvh_built[mdl_idx] = 1u;
+	}
+	if(!mdl->wide_morton_codes) {
+		log_if_debug("compute_morton_codes: %u", mdl_idx);
+		stats.begin(collision_stats::STAGE::MORTON_CODES, mdl_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["compute_morton_codes"],
+									   uint1 { morton_codes_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["compute_morton_codes"] },
+									   aabbs,
+									   mdl->get_centroids_buffer(cur_frame),
+									   mdl->get_centroids_buffer(next_frame),
+									   triangle_count,
+									   mdl_idx,
+									   mdl->step,
+									   mdl->morton_codes);
+		stats.end();
+		
+		log_if_debug("radix: %u", mdl_idx);
+		stats.begin(collision_stats::STAGE::RADIX_SORT, mdl_idx);
+		radix_sort(mdl->morton_codes, mdl->morton_codes_ping, morton_codes_count, 30);
+		stats.end();
+		
+		//
+		log_if_debug("build_bvh: %u (node count: %u/%u)", mdl_idx, leaf_count, internal_node_count);
+		stats.begin(collision_stats::STAGE::BUILD_BVH, mdl_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh"],
+									   uint1 { internal_node_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["build_bvh"] },
+									   mdl->morton_codes,
+									   mdl->bvh_internal,
+									   mdl->bvh_leaves,
+									   internal_node_count);
+		stats.end();
+	}
+	else {
+		log_if_debug("compute_morton_codes_wide: %u", mdl_idx);
+		stats.begin(collision_stats::STAGE::MORTON_CODES, mdl_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["compute_morton_codes_wide"],
+									   uint1 { morton_codes_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["compute_morton_codes_wide"] },
+									   aabbs,
+									   mdl->get_centroids_buffer(cur_frame),
+									   mdl->get_centroids_buffer(next_frame),
+									   triangle_count,
+									   mdl_idx,
+									   mdl->step,
+									   mdl->morton_codes,
+									   mdl->morton_codes_hi,
+									   mdl->morton_codes_lo);
+		stats.end();
+		
+		// sort by lower half first, then by upper half (radix sort is stable)
+		// NOTE: both use an even number of passes, so that the sorted result always ends up in morton_codes
+		log_if_debug("radix (lo): %u", mdl_idx);
+		stats.begin(collision_stats::STAGE::RADIX_SORT, mdl_idx);
+		radix_sort(mdl->morton_codes, mdl->morton_codes_ping, morton_codes_count, 32);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["gather_morton_codes_hi"],
+									   uint1 { morton_codes_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["gather_morton_codes_hi"] },
+									   mdl->morton_codes,
+									   mdl->morton_codes_hi,
+									   morton_codes_count);
+		log_if_debug("radix (hi): %u", mdl_idx);
+		radix_sort(mdl->morton_codes, mdl->morton_codes_ping, morton_codes_count, 32);
+		stats.end();
+		
+		//
+		log_if_debug("build_bvh_wide: %u (node count: %u/%u)", mdl_idx, leaf_count, internal_node_count);
+		stats.begin(collision_stats::STAGE::BUILD_BVH, mdl_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh_wide"],
+									   uint1 { internal_node_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["build_bvh_wide"] },
+									   mdl->morton_codes,
+									   mdl->morton_codes_lo,
+									   mdl->bvh_internal,
+									   mdl->bvh_leaves,
+									   internal_node_count);
+		stats.end();
+	}
+	
+	log_if_debug("build_bvh_aabbs_leaves: %u", mdl_idx);
+	stats.begin(collision_stats::STAGE::BVH_AABBS, mdl_idx);
+	if(!hlbvh_state.ccd) {
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh_aabbs_leaves"],
+									   uint1 { leaf_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["build_bvh_aabbs_leaves"] },
+									   mdl->morton_codes,
+									   leaf_count,
+									   mdl->triangles,
+									   mdl->bvh_aabbs_leaves);
+	}
+	else {
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh_aabbs_leaves_swept"],
+									   uint1 { leaf_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["build_bvh_aabbs_leaves_swept"] },
+									   mdl->morton_codes,
+									   leaf_count,
+									   mdl->triangles,
+									   mdl->triangles_prev,
+									   mdl->bvh_aabbs_leaves);
+	}
+	
+	log_if_debug("build_bvh_aabbs: %u", mdl_idx);
+	mdl->bvh_aabbs_counters->zero(hlbvh_state.dev_queue);
+	hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_bvh_aabbs"],
+								   uint1 { leaf_count },
+								   uint1 { hlbvh_state.kernel_max_local_size["build_bvh_aabbs"] },
+								   mdl->morton_codes,
+								   mdl->bvh_internal,
+								   mdl->bvh_leaves,
+								   internal_node_count,
+								   leaf_count,
+								   mdl->triangles,
+								   mdl->bvh_aabbs,
+								   mdl->bvh_aabbs_leaves,
+								   mdl->bvh_aabbs_counters);
+	
+	if(hlbvh_state.compressed_bvh) {
+		log_if_debug("build_compressed_bvh: %u", mdl_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_compressed_bvh"],
+									   uint1 { internal_node_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["build_compressed_bvh"] },
+									   mdl->bvh_internal,
+									   mdl->bvh_aabbs,
+									   mdl->bvh_aabbs_leaves,
+									   internal_node_count,
+									   mdl->bvh_compressed);
+	}
+	
+	if(hlbvh_state.wide_bvh) {
+		log_if_debug("build_wide_bvh: %u", mdl_idx);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["build_wide_bvh"],
+									   uint1 { internal_node_count },
+									   uint1 { hlbvh_state.kernel_max_local_size["build_wide_bvh"] },
+									   mdl->bvh_internal,
+									   mdl->bvh_aabbs,
+									   mdl->bvh_aabbs_leaves,
+									   internal_node_count,
+									   mdl->bvh_wide);
+	}
+	stats.end();
+}
+
+bool collider::query_rays(const vector<unique_ptr<animation>>& models,
+						  shared_ptr<compute_buffer> rays,
+						  const uint32_t ray_count,
+						  shared_ptr<compute_buffer> hits) {
+	return query("query_rays", models, rays, ray_count, hits);
+}
+
+bool collider::query_closest_points(const vector<unique_ptr<animation>>& models,
+									shared_ptr<compute_buffer> points,
+									const uint32_t point_count,
+									shared_ptr<compute_buffer> hits) {
+	return query("query_closest_points", models, points, point_count, hits);
+}
+
+bool collider::query(const char* kernel_name,
+					 const vector<unique_ptr<animation>>& models,
+					 shared_ptr<compute_buffer> queries,
+					 const uint32_t query_count,
+					 shared_ptr<compute_buffer> hits) {
+	if(models.empty() || query_count == 0) return false;
+	if(hlbvh_state.instance_count > 0) {
+		log_error("queries are not supported with instancing");
+		return false;
+	}
+	if(bvh_built.size() != models.size()) {
+		log_error("collide() must be called before any query");
+		return false;
+	}
+	
+	// query each bvh in turn, each one only replaces the hits of the previous ones if it has a closer hit
+	for(uint32_t i = 0; i < uint32_t(models.size()); ++i) {
+		const auto& mdl = models[i];
+		if(!bvh_built[i]) {
+			build_bvh(mdl, i);
+		}
+		
+		log_if_debug("%s: %u", kernel_name, i);
+		hlbvh_state.dev_queue->execute(hlbvh_state.kernels[kernel_name],
+									   uint1 { query_count },
+									   uint1 { hlbvh_state.kernel_max_local_size[kernel_name] },
+									   queries,
+									   query_count,
+									   i,
+									   uint32_t(i == 0 ? 1u : 0u),
+									   mdl->bvh_internal,
+									   mdl->bvh_aabbs,
+									   mdl->bvh_aabbs_leaves,
+									   mdl->triangles,
+									   mdl->morton_codes,
+									   hits);
+	}
+	return true;
+}
+
+const vector<triangle_contact>& collider::read_contacts(uint32_t& overflow) {
+	overflow = 0;
+	if(!hlbvh_state.contacts || !contacts_counter) {
+		contacts_host.clear();
+		return contacts_host;
+	}
+	
+	uint32_t contact_count = 0;
+	contacts_counter->read_to(contact_count, hlbvh_state.dev_queue);
+	if(contact_count > hlbvh_state.max_contacts) {
+		overflow = contact_count - hlbvh_state.max_contacts;
+		contact_count = hlbvh_state.max_contacts;
+	}
+	
+	contacts_host.resize(contact_count);
+	if(contact_count > 0) {
+		contacts->read(hlbvh_state.dev_queue, &contacts_host[0], contact_count * sizeof(triangle_contact));
+	}
+	return contacts_host;
+}
+
 void collider::radix_sort(shared_ptr<compute_buffer> buffer,
 						  shared_ptr<compute_buffer> ping_buffer,
 						  const size_t size,
@@ -302,6 +1485,7 @@ void collider::radix_sort(shared_ptr<compute_buffer> buffer,
 	for(uint32_t bit = 0u; bit < max_bit; ++bit) {
 		const auto mask_op_bit = uint32_t(1u << bit);
 		//log_if_debug("radix sort: %u, %X, size: %u", bit, mask_op_bit, size);
+		stats.begin_radix_pass();
 		
 		hlbvh_state.dev_queue->execute(hlbvh_state.kernels["radix_sort_count"],
 									   uint1 { COMPACTION_GROUP_COUNT * COMPACTION_GROUP_SIZE },
@@ -327,7 +1511,170 @@ void collider::radix_sort(shared_ptr<compute_buffer> buffer,
 									   uint32_t(size / COMPACTION_GROUP_COUNT),
 									   mask_op_bit,
 									   valid_counts_buffer);
+		stats.end_radix_pass();
 		
 		buffer.swap(ping_buffer);
 	}
 }
+
+const char* collision_stats::stage_name(const STAGE stage) {
+	switch(stage) {
+		case STAGE::BUILD_AABBS: return "build_aabbs";
+		case STAGE::ROOT_AABBS: return "root_aabbs";
+		case STAGE::MORTON_CODES: return "morton_codes";
+		case STAGE::RADIX_SORT: return "radix_sort";
+		case STAGE::BUILD_BVH: return "build_bvh";
+		case STAGE::BVH_AABBS: return "bvh_aabbs";
+		case STAGE::COLLIDE_PAIRS: return "collide_pairs";
+		case STAGE::SELF_COLLISION: return "self_collision";
+		case STAGE::MAP_COLLIDED_TRIANGLES: return "map_collided_triangles";
+		case STAGE::TOTAL: return "total";
+		case STAGE::__MAX_STAGE: break;
+	}
+	return "<unknown>";
+}
+
+double collision_stats::elapsed_ms(const chrono::time_point<chrono::high_resolution_clock>& start) {
+	return double(chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count()) / 1000000.0;
+}
+
+void collision_stats::begin_frame() {
+	if(!hlbvh_state.stats) return;
+	hlbvh_state.dev_queue->finish();
+	frames.emplace_back();
+	in_frame = true;
+	frame_start = chrono::high_resolution_clock::now();
+}
+
+void collision_stats::end_frame() {
+	if(!hlbvh_state.stats || !in_frame) return;
+	hlbvh_state.dev_queue->finish();
+	frames.back().stages[uint32_t(STAGE::TOTAL)] = elapsed_ms(frame_start);
+	in_frame = false;
+}
+
+void collision_stats::begin(const STAGE stage, const uint32_t mdl_idx) {
+	if(!hlbvh_state.stats || !in_frame) return;
+	// don't attribute previously enqueued work to this stage
+	hlbvh_state.dev_queue->finish();
+	cur_stage = stage;
+	cur_mdl_idx = mdl_idx;
+	stage_start = chrono::high_resolution_clock::now();
+}
+
+void collision_stats::end() {
+	if(!hlbvh_state.stats || !in_frame) return;
+	hlbvh_state.dev_queue->finish();
+	const auto time = elapsed_ms(stage_start);
+	auto& frame = frames.back();
+	frame.stages[uint32_t(cur_stage)] += time;
+	if(cur_mdl_idx != ~0u) {
+		if(frame.models.size() <= cur_mdl_idx) {
+			frame.models.resize(cur_mdl_idx + 1u, 0.0);
+		}
+		frame.models[cur_mdl_idx] += time;
+	}
+}
+
+void collision_stats::begin_radix_pass() {
+	if(!hlbvh_state.stats || !in_frame) return;
+	hlbvh_state.dev_queue->finish();
+	radix_pass_start = chrono::high_resolution_clock::now();
+}
+
+void collision_stats::end_radix_pass() {
+	if(!hlbvh_state.stats || !in_frame) return;
+	hlbvh_state.dev_queue->finish();
+	radix_pass_times.emplace_back(elapsed_ms(radix_pass_start));
+}
+
+//! returns the mean and 99th percentile of the specified samples
+static pair<double, double> mean_and_p99(vector<double> samples) {
+	if(samples.empty()) return { 0.0, 0.0 };
+	double sum = 0.0;
+	for(const auto& sample : samples) {
+		sum += sample;
+	}
+	sort(begin(samples), end(samples));
+	const auto p99_idx = min(size_t(ceil(double(samples.size()) * 0.99)), samples.size()) - 1u;
+	return { sum / double(samples.size()), samples[p99_idx] };
+}
+
+pair<double, double> collision_stats::stage_times(const STAGE stage) const {
+	vector<double> samples;
+	samples.reserve(frames.size());
+	for(const auto& frame : frames) {
+		samples.emplace_back(frame.stages[uint32_t(stage)]);
+	}
+	return mean_and_p99(samples);
+}
+
+void collision_stats::clear() {
+	frames.clear();
+	radix_pass_times.clear();
+	in_frame = false;
+}
+
+void collision_stats::print_summary() const {
+	if(frames.empty()) return;
+	log_msg("collision stats (%u frames, mean / p99 in ms):", frames.size());
+	for(uint32_t stage = 0; stage < stage_count; ++stage) {
+		const auto times = stage_times(STAGE(stage));
+		log_msg("\t%s: %f / %f", stage_name(STAGE(stage)), times.first, times.second);
+	}
+	if(!radix_pass_times.empty()) {
+		const auto times = mean_and_p99(radix_pass_times);
+		log_msg("\tradix_sort pass (%u passes): %f / %f", radix_pass_times.size(), times.first, times.second);
+	}
+	
+	// per model (only frames in which the model had any work)
+	size_t model_count = 0;
+	for(const auto& frame : frames) {
+		model_count = max(model_count, frame.models.size());
+	}
+	for(size_t mdl_idx = 0; mdl_idx < model_count; ++mdl_idx) {
+		vector<double> samples;
+		for(const auto& frame : frames) {
+			if(mdl_idx < frame.models.size() && frame.models[mdl_idx] > 0.0) {
+				samples.emplace_back(frame.models[mdl_idx]);
+			}
+		}
+		const auto times = mean_and_p99(samples);
+		log_msg("\tmodel #%u (%u frames): %f / %f", mdl_idx, samples.size(), times.first, times.second);
+	}
+}
+
+bool collision_stats::write_csv(const string& file_name) const {
+	size_t model_count = 0;
+	for(const auto& frame : frames) {
+		model_count = max(model_count, frame.models.size());
+	}
+	
+	stringstream csv;
+	csv << "frame";
+	for(uint32_t stage = 0; stage < stage_count; ++stage) {
+		csv << "," << stage_name(STAGE(stage));
+	}
+	for(size_t mdl_idx = 0; mdl_idx < model_count; ++mdl_idx) {
+		csv << ",model_" << mdl_idx;
+	}
+	csv << endl;
+	
+	for(size_t frame_idx = 0, frame_count = frames.size(); frame_idx < frame_count; ++frame_idx) {
+		const auto& frame = frames[frame_idx];
+		csv << frame_idx;
+		for(const auto& time : frame.stages) {
+			csv << "," << time;
+		}
+		for(size_t mdl_idx = 0; mdl_idx < model_count; ++mdl_idx) {
+			csv << "," << (mdl_idx < frame.models.size() ? frame.models[mdl_idx] : 0.0);
+		}
+		csv << endl;
+	}
+	
+	if(!file_io::string_to_file(file_name, csv.str())) {
+		log_error("failed to write collision stats to \"%s\"", file_name);
+		return false;
+	}
+	return true;
+}
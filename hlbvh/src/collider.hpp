@@ -21,18 +21,257 @@
 
 #include "hlbvh_state.hpp"
 #include "animation.hpp"
+#include <chrono>
+
+//! per-stage timing of the collision pipeline (only recorded if hlbvh_state.stats is enabled)
+//! NOTE: each stage is fenced by a queue finish(), so this serializes the pipeline and adds some overhead,
+//!       but allows attributing the device time to each stage
+class collision_stats {
+public:
+	enum class STAGE : uint32_t {
+		BUILD_AABBS,
+		ROOT_AABBS, // broadphase incl. readback
+		MORTON_CODES,
+		RADIX_SORT,
+		BUILD_BVH,
+		BVH_AABBS, // leaf + internal node aabbs (+compressed/wide bvh)
+		COLLIDE_PAIRS,
+		SELF_COLLISION,
+		MAP_COLLIDED_TRIANGLES,
+		TOTAL,
+		__MAX_STAGE
+	};
+	static constexpr const uint32_t stage_count { uint32_t(STAGE::__MAX_STAGE) };
+	static const char* stage_name(const STAGE stage);
+	
+	//! starts/ends a frame (i.e. one collide() call)
+	//! NOTE: stages outside of a frame (e.g. bvh builds triggered by a query) are not recorded
+	void begin_frame();
+	void end_frame();
+	
+	//! starts timing the specified stage (of the specified model, ~0u if this isn't a per-model stage)
+	void begin(const STAGE stage, const uint32_t mdl_idx = ~0u);
+	//! stops timing the current stage
+	void end();
+	
+	//! times a single radix sort pass (these are also accumulated into RADIX_SORT)
+	void begin_radix_pass();
+	void end_radix_pass();
+	
+	//! returns the mean and p99 time in ms of the specified stage over all recorded frames
+	pair<double, double> stage_times(const STAGE stage) const;
+	
+	//! removes all recorded frames
+	void clear();
+	
+	//! logs mean + p99 of each stage and the mean time per model
+	void print_summary() const;
+	
+	//! writes the per-frame stage times (and per-model times) in ms to a .csv file
+	bool write_csv(const string& file_name) const;
+	
+protected:
+	struct frame_times {
+		array<double, stage_count> stages {};
+		vector<double> models;
+	};
+	vector<frame_times> frames;
+	vector<double> radix_pass_times;
+	
+	bool in_frame { false };
+	STAGE cur_stage { STAGE::TOTAL };
+	uint32_t cur_mdl_idx { ~0u };
+	chrono::time_point<chrono::high_resolution_clock> stage_start;
+	chrono::time_point<chrono::high_resolution_clock> frame_start;
+	chrono::time_point<chrono::high_resolution_clock> radix_pass_start;
+	
+	static double elapsed_ms(const chrono::time_point<chrono::high_resolution_clock>& start);
+	
+};
 
 class collider {
 public:
 	const vector<uint32_t>& collide(const vector<unique_ptr<animation>>& models);
 	
+	//! collides all instances with each other, returns the per-instance collision flags
+	//! NOTE: bvhs are only built once per animation (in local space), regardless of the instance count
+	const vector<uint32_t>& collide(const vector<unique_ptr<animation>>& models,
+									const vector<animation_instance>& instances);
+	
+	//! reads back the contacts of the last collide() call (only if contacts are enabled),
+	//! "overflow" is set to the amount of contacts that didn't fit into the contacts buffer
+	const vector<triangle_contact>& read_contacts(uint32_t& overflow);
+	
+	//! device contacts buffer (contains up to hlbvh_state.max_contacts contacts)
+	shared_ptr<compute_buffer> get_contacts_buffer() const {
+		return contacts;
+	}
+	//! device contacts counter (single uint32_t, total contact count including any overflow)
+	shared_ptr<compute_buffer> get_contacts_counter() const {
+		return contacts_counter;
+	}
+	
+	//! batched ray casts against all models, reusing the bvhs and triangles of the last collide() call
+	//! (bvhs of models that weren't needed by collide() are built on demand, once per frame)
+	//! "rays" must contain "ray_count" query_rays, "hits" receives the closest hit of each ray (see query_hit)
+	//! NOTE: not supported with instancing
+	bool query_rays(const vector<unique_ptr<animation>>& models,
+					shared_ptr<compute_buffer> rays,
+					const uint32_t ray_count,
+					shared_ptr<compute_buffer> hits);
+	
+	//! batched closest point queries against all models, same as query_rays otherwise
+	//! "points" must contain "point_count" query_points, "hits" receives the closest triangle of each point
+	bool query_closest_points(const vector<unique_ptr<animation>>& models,
+							  shared_ptr<compute_buffer> points,
+							  const uint32_t point_count,
+							  shared_ptr<compute_buffer> hits);
+	
+	//! per-stage timing of all collide() calls so far (only recorded if hlbvh_state.stats is enabled)
+	const collision_stats& get_stats() const {
+		return stats;
+	}
+	collision_stats& get_stats() {
+		return stats;
+	}
+	
+	//! per-model self-collision flags of the last collide() call (only if hlbvh_state.self_collision is enabled),
+	//! these are set independently of any collisions with other models (not read back with device collision flags)
+	const vector<uint32_t>& get_self_collision_flags() const {
+		return self_collision_flags_host;
+	}
+	
+	//! device collision flags of the last collide() call (one uint32_t per model or instance)
+	//! NOTE: with hlbvh_state.device_collision_flags, this can be consumed directly by the renderers
+	//!       (shared with opengl, or used as a metal buffer), the host flags are then one frame behind
+	const shared_ptr<compute_buffer>& get_collision_flags_buffer() const {
+		return collision_flags;
+	}
+	
 protected:
+	collision_stats stats;
+	
 	size_t allocated_model_count { 0 };
 	shared_ptr<compute_buffer> collision_flags;
 	shared_ptr<compute_buffer> aabb_collision_flags;
 	shared_ptr<compute_buffer> aabbs;
 	shared_ptr<compute_buffer> valid_counts_buffer;
 	vector<uint32_t> collision_flags_host;
+	shared_ptr<compute_buffer> self_collision_flags;
+	vector<uint32_t> self_collision_flags_host;
+	
+	//! buffer pool: makes sure that "buffer" can hold at least "size" bytes, growing it to at least twice its capacity
+	//! if not, returns true if the buffer was (re)created (-> contents are undefined)
+	//! NOTE: buffers never shrink, so that instances/models joining and leaving a scene don't cause allocation churn
+	static bool grow_buffer(shared_ptr<compute_buffer>& buffer, const size_t size,
+							const COMPUTE_MEMORY_FLAG flags, const uint32_t opengl_type = 0);
+	
+	//! resets the first "count" root aabbs to empty (inverted) aabbs
+	void init_aabbs(const uint32_t count);
+	
+	//! per-frame host data, reused across frames
+	unordered_set<uint32_t> valid_meshes_host;
+	unordered_set<uint32_t> valid_instances_host;
+	vector<uint2> potential_pairs_host;
+	vector<uint8_t> pair_resolved_host;
+	vector<uint32_t> pair_slots_host;
+	vector<uint32_t> contact_cache_hits_host;
+	vector<uint32_t> aabb_collision_flags_host;
+	
+	//! (re)allocates the collision flags (double-buffered with hlbvh_state.device_collision_flags)
+	void alloc_collision_flags(const size_t count);
+	//! device collision flags: switches to the other flags buffer, reading back the flags of the previous frame
+	//! if enabled (these have been completed while the previous frame was rendered)
+	void swap_collision_flags();
+	//! copies the flags to the host (w/o device collision flags) or marks them for the delayed read back
+	void finish_collision_flags();
+	shared_ptr<compute_buffer> collision_flags_buffers[2];
+	uint32_t collision_flags_idx { 0 };
+	bool collision_flags_pending { false };
+	
+	shared_ptr<compute_buffer> contacts;
+	shared_ptr<compute_buffer> contacts_counter;
+	vector<triangle_contact> contacts_host;
+	
+	size_t allocated_instance_count { 0 };
+	shared_ptr<compute_buffer> instance_aabbs;
+	shared_ptr<compute_buffer> instance_animations;
+	shared_ptr<compute_buffer> instance_transforms;
+	shared_ptr<compute_buffer> instance_inv_transforms;
+	vector<uint32_t> instance_animations_host;
+	vector<matrix4f> instance_transforms_host;
+	vector<matrix4f> instance_inv_transforms_host;
+	
+	//! collides all root aabbs with each other, adds all colliding pairs to "potential_pairs" and the resp. indices
+	//! to "valid_meshes"
+	void find_potential_pairs(shared_ptr<compute_buffer> root_aabbs,
+							  const uint32_t count,
+							  unordered_set<uint32_t>& valid_meshes,
+							  vector<uint2>& potential_pairs);
+	
+	//! sort-and-sweep variant of the above (used for large mesh counts)
+	void find_potential_pairs_sweep(shared_ptr<compute_buffer> root_aabbs,
+									const uint32_t count,
+									unordered_set<uint32_t>& valid_meshes,
+									vector<uint2>& potential_pairs);
+	shared_ptr<compute_buffer> sweep_keys;
+	shared_ptr<compute_buffer> sweep_keys_ping;
+	shared_ptr<compute_buffer> sweep_pairs;
+	shared_ptr<compute_buffer> sweep_pair_counter;
+	uint32_t max_sweep_pairs { 4096 };
+	
+	//! collides the bvhs of model A and B via tandem traversal (see hlbvh_state.tandem)
+	void collide_tandem(const unique_ptr<animation>& mdl_a, const unique_ptr<animation>& mdl_b,
+						const uint32_t mdl_idx_a, const uint32_t mdl_idx_b);
+	shared_ptr<compute_buffer> tandem_node_pairs[2];
+	shared_ptr<compute_buffer> tandem_node_pair_counts[2];
+	shared_ptr<compute_buffer> tandem_node_pair_queue_head;
+	
+	//! collides the bvhs of model A and B via the persistent-threads per-leaf traversal (see hlbvh_state.persistent)
+	void collide_persistent(const unique_ptr<animation>& mdl_a, const unique_ptr<animation>& mdl_b,
+							const uint32_t mdl_idx_a, const uint32_t mdl_idx_b);
+	shared_ptr<compute_buffer> persistent_leaf_counter;
+	
+	//! collides the bvhs of model A and B via the batched narrowphase (see hlbvh_state.batched_narrowphase)
+	void collide_batched(const unique_ptr<animation>& mdl_a, const unique_ptr<animation>& mdl_b,
+						 const uint32_t mdl_idx_a, const uint32_t mdl_idx_b);
+	shared_ptr<compute_buffer> narrowphase_candidates;
+	shared_ptr<compute_buffer> narrowphase_candidate_counter;
+	
+	//! builds the bvh of the specified model (root aabbs must have been computed already)
+	void build_bvh(const unique_ptr<animation>& mdl, const uint32_t mdl_idx);
+	//! flags which models have an up-to-date bvh for the current frame (only used by the non-instanced collide())
+	vector<uint8_t> bvh_built;
+	
+	//! contact cache (see hlbvh_state.contact_cache): re-tests the cached triangle pairs of all cache slots in one
+	//! launch and flags the potential pairs that still collide in "pair_resolved", all other pairs get a (reset)
+	//! cache slot in "pair_slots" if one is available (~0u otherwise)
+	void resolve_contact_cache(const uint32_t model_count,
+							   const vector<unique_ptr<animation>>& models,
+							   const vector<uint2>& potential_pairs,
+							   vector<uint8_t>& pair_resolved,
+							   vector<uint32_t>& pair_slots);
+	shared_ptr<compute_buffer> contact_cache;
+	shared_ptr<compute_buffer> contact_cache_counts;
+	shared_ptr<compute_buffer> contact_cache_hits;
+	//! mesh pair of each cache slot (+host copy)
+	shared_ptr<compute_buffer> contact_cache_meshes;
+	vector<uint2> contact_cache_meshes_host;
+	//! triangles of all cached pairs of this frame, gathered from their meshes (2 triangles per cache entry)
+	shared_ptr<compute_buffer> contact_cache_triangles;
+	//! flags which meshes are part of any cache slot
+	vector<uint8_t> contact_cache_mesh_flags;
+	//! mesh pair (i << 32 | j) -> cache slot
+	unordered_map<uint64_t, uint32_t> contact_cache_slots;
+	size_t contact_cache_model_count { 0 };
+	uint32_t contact_cache_frame { 0 };
+	
+	//! runs the specified query kernel on all models (-> query_rays and query_closest_points)
+	bool query(const char* kernel_name,
+			   const vector<unique_ptr<animation>>& models,
+			   shared_ptr<compute_buffer> queries,
+			   const uint32_t query_count,
+			   shared_ptr<compute_buffer> hits);
 	
 	void radix_sort(shared_ptr<compute_buffer> buffer,
 					shared_ptr<compute_buffer> ping_buffer,
@@ -41,7 +41,9 @@ bool gl_renderer::init() {
 }
 
 void gl_renderer::render(const vector<unique_ptr<animation>>& models,
+						 const vector<animation_instance>& instances,
 						 const vector<uint32_t>& collisions,
+						 const shared_ptr<compute_buffer>& collisions_buffer,
 						 const bool cam_mode,
 						 const camera& cam) {
 	// draws ogl stuff
@@ -68,6 +70,8 @@ void gl_renderer::render(const vector<unique_ptr<animation>>& models,
 	static const auto norm_a_location = (GLuint)shd.program.attributes["in_normal_a"].location;
 	static const auto norm_b_location = (GLuint)shd.program.attributes["in_normal_b"].location;
 	static const auto is_collision_location = (hlbvh_state.triangle_vis ? (GLuint)shd.program.attributes["is_collision"].location : 0);
+	const bool device_flags = (hlbvh_state.device_collision_flags && !hlbvh_state.triangle_vis);
+	static const auto model_collision_location = (device_flags ? (GLuint)shd.program.attributes["model_collision"].location : 0);
 	
 	const matrix4f mproj {
 		matrix4f().perspective(72.0f, float(floor::get_width()) / float(floor::get_height()),
@@ -95,17 +99,30 @@ void gl_renderer::render(const vector<unique_ptr<animation>>& models,
 	};
 	static constexpr const float4 collision_color { 1.0f, 0.0f, 0.0f, 1.0f };
 	
-	glUniformMatrix4fv(mvpm_location, 1, false, &uniforms.mvpm.data[0]);
 	glUniform4fv(repl_color_location, 1, uniforms.repl_color.data());
 	glUniform4fv(default_color_location, 1, uniforms.default_color.data());
 	glUniform3fv(light_dir_location, 1, uniforms.light_dir.data());
 	
-	for(uint32_t i = 0; i < (uint32_t)models.size(); ++i) {
-		const auto& mdl = models[i];
+	// device collision flags: the flag of each instance is sourced as a per-instance attribute (divisor 1, offset to
+	// the flag of the instance), so that every non-instanced draw reads the flag of its instance
+	if(device_flags) {
+		collisions_buffer->release_opengl_object(hlbvh_state.dev_queue);
+		glBindBuffer(GL_ARRAY_BUFFER, collisions_buffer->get_opengl_object());
+		glEnableVertexAttribArray(model_collision_location);
+		glVertexAttribDivisor(model_collision_location, 1);
+	}
+	
+	for(uint32_t i = 0; i < (uint32_t)instances.size(); ++i) {
+		const auto& mdl = models[instances[i].animation_idx];
 		const auto cur_frame = (const gl_obj_model*)mdl->frames[mdl->cur_frame].get();
 		const auto next_frame = (const gl_obj_model*)mdl->frames[mdl->next_frame].get();
 		
-		if(!hlbvh_state.triangle_vis) {
+		if(device_flags) {
+			glBindBuffer(GL_ARRAY_BUFFER, collisions_buffer->get_opengl_object());
+			glVertexAttribIPointer(model_collision_location, 1, GL_UNSIGNED_INT, 0,
+								   (const void*)(size_t(i) * sizeof(uint32_t)));
+		}
+		else if(!hlbvh_state.triangle_vis) {
 			glUniform4fv(default_color_location, 1,
 						 collisions[i] == 0 ? uniforms.default_color.data() : collision_color.data());
 		}
@@ -114,6 +131,9 @@ void gl_renderer::render(const vector<unique_ptr<animation>>& models,
 		}
 		glUniform1f(delta_location, mdl->step);
 		
+		const matrix4f mvpm { instances[i].transform * uniforms.mvpm };
+		glUniformMatrix4fv(mvpm_location, 1, false, &mvpm.data[0]);
+		
 		if(hlbvh_state.triangle_vis) {
 			mdl->colliding_vertices->release_opengl_object(hlbvh_state.dev_queue);
 			glBindBuffer(GL_ARRAY_BUFFER, mdl->colliding_vertices->get_opengl_object());
@@ -146,6 +166,11 @@ void gl_renderer::render(const vector<unique_ptr<animation>>& models,
 			mdl->colliding_vertices->acquire_opengl_object(hlbvh_state.dev_queue);
 		}
 	}
+	if(device_flags) {
+		glVertexAttribDivisor(model_collision_location, 0);
+		glDisableVertexAttribArray(model_collision_location);
+		collisions_buffer->acquire_opengl_object(hlbvh_state.dev_queue);
+	}
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	
@@ -169,6 +194,9 @@ bool gl_renderer::compile_shaders() {
 		in uint is_collision;
 		noperspective out float collision;
 #endif
+#if DEVICE_COLLISION_FLAGS
+		in uint model_collision;
+#endif
 		
 		out vec4 color;
 		out vec3 normal;
@@ -188,6 +216,11 @@ bool gl_renderer::compile_shaders() {
 			else {
 				color = default_color;
 				normal = mix(in_normal_a, in_normal_b, delta);
+#if DEVICE_COLLISION_FLAGS
+				if(model_collision > 0u) {
+					color = vec4(1.0, 0.0, 0.0, 1.0);
+				}
+#endif
 			}
 		}
 	)RAWSTR"};
@@ -242,8 +275,11 @@ bool gl_renderer::compile_shaders() {
 		const auto shd = floor_compile_shader("SHADE",
 											  hlbvh_vs_text.c_str(),
 											  hlbvh_fs_text.c_str(),
-											  150,
-											  { { "COLLIDING_TRIANGLES_VIS", hlbvh_state.triangle_vis ? 1 : 0 } });
+											  330,
+											  {
+												  { "COLLIDING_TRIANGLES_VIS", hlbvh_state.triangle_vis ? 1 : 0 },
+												  { "DEVICE_COLLISION_FLAGS", hlbvh_state.device_collision_flags && !hlbvh_state.triangle_vis ? 1 : 0 },
+											  });
 		if(!shd.first) return false;
 		shader_objects.emplace(shd.second.name, shd.second);
 	}
@@ -123,16 +123,39 @@ static uint32_t morton(uint32_t x, uint32_t y, uint32_t z) {
 }
 #endif
 
+// 63-bit morton code (21 bits per axis), same bit interleaving as above, only with 64-bit masks
+// (no arch specific variant here, 64-bit integer multiplies are never faster than the shift/or/and approach)
+static uint64_t morton_spread_21(uint64_t v) {
+	v = (v | (v << 32ull)) & 0x001F00000000FFFFull;
+	v = (v | (v << 16ull)) & 0x001F0000FF0000FFull;
+	v = (v | (v <<  8ull)) & 0x100F00F00F00F00Full;
+	v = (v | (v <<  4ull)) & 0x10C30C30C30C30C3ull;
+	v = (v | (v <<  2ull)) & 0x1249249249249249ull;
+	return v;
+}
+static uint64_t morton_64(uint32_t x, uint32_t y, uint32_t z) {
+	return (morton_spread_21(x) |
+			(morton_spread_21(y) << 1ull) |
+			(morton_spread_21(z) << 2ull));
+}
+
 // computes all interpolated triangles for this frame, stores these in a global buffer
 // and continues to build the root aabb of the mesh (which will be needed later on)
+// swept: also computes the triangles at the start of the step (previous interpolation state) and
+//        builds the root aabb so that it encloses the triangles at both the start and end of the step
 // TODO: directly combine with build_bvh_aabbs_leaves?
-kernel void build_aabbs(buffer<const float3> triangles_cur,
-						buffer<const float3> triangles_next,
-						param<uint32_t> triangle_count,
-						param<uint32_t> mesh_idx,
-						param<float> interp,
-						buffer<float> aabbs,
-						buffer<float3> triangles) {
+template <bool swept>
+floor_inline_always static void build_aabbs_impl(buffer<const float3> triangles_cur,
+												 buffer<const float3> triangles_next,
+												 const uint32_t triangle_count,
+												 const uint32_t mesh_idx,
+												 const float interp,
+												 buffer<float> aabbs,
+												 buffer<float3> triangles,
+												 buffer<const float3> triangles_prev_cur,
+												 buffer<const float3> triangles_prev_next,
+												 const float prev_interp,
+												 buffer<float3> triangles_prev) {
 	const auto id = global_id.x;
 	float3 aabb_min, aabb_max;
 	if(id < triangle_count) {
@@ -144,6 +167,17 @@ kernel void build_aabbs(buffer<const float3> triangles_cur,
 		triangles[id * 3 + 2] = v2;
 		aabb_min = v0.minned(v1).minned(v2);
 		aabb_max = v0.maxed(v1).maxed(v2);
+		
+		if constexpr(swept) {
+			const auto pv0 = triangles_prev_cur[id * 3].interpolated(triangles_prev_next[id * 3], prev_interp);
+			const auto pv1 = triangles_prev_cur[id * 3 + 1].interpolated(triangles_prev_next[id * 3 + 1], prev_interp);
+			const auto pv2 = triangles_prev_cur[id * 3 + 2].interpolated(triangles_prev_next[id * 3 + 2], prev_interp);
+			triangles_prev[id * 3] = pv0;
+			triangles_prev[id * 3 + 1] = pv1;
+			triangles_prev[id * 3 + 2] = pv2;
+			aabb_min.min(pv0.minned(pv1).minned(pv2));
+			aabb_max.max(pv0.maxed(pv1).maxed(pv2));
+		}
 	}
 	else {
 		aabb_min = __FLT_MAX__;
@@ -166,6 +200,40 @@ kernel void build_aabbs(buffer<const float3> triangles_cur,
 	}
 }
 
+// resets all root aabbs to empty (inverted) aabbs, so that they can be grown via atomic min/max
+kernel void init_aabbs(buffer<float3> aabbs, param<uint32_t> count) {
+	const auto idx = global_id.x;
+	if(idx >= count) return;
+	aabbs[idx * 2] = float3(__FLT_MAX__);
+	aabbs[idx * 2 + 1] = float3(-__FLT_MAX__);
+}
+
+kernel void build_aabbs(buffer<const float3> triangles_cur,
+						buffer<const float3> triangles_next,
+						param<uint32_t> triangle_count,
+						param<uint32_t> mesh_idx,
+						param<float> interp,
+						buffer<float> aabbs,
+						buffer<float3> triangles) {
+	build_aabbs_impl<false>(triangles_cur, triangles_next, triangle_count, mesh_idx, interp, aabbs, triangles,
+							nullptr, nullptr, 0.0f, nullptr);
+}
+
+kernel void build_aabbs_swept(buffer<const float3> triangles_cur,
+							  buffer<const float3> triangles_next,
+							  param<uint32_t> triangle_count,
+							  param<uint32_t> mesh_idx,
+							  param<float> interp,
+							  buffer<float> aabbs,
+							  buffer<float3> triangles,
+							  buffer<const float3> triangles_prev_cur,
+							  buffer<const float3> triangles_prev_next,
+							  param<float> prev_interp,
+							  buffer<float3> triangles_prev) {
+	build_aabbs_impl<true>(triangles_cur, triangles_next, triangle_count, mesh_idx, interp, aabbs, triangles,
+						   triangles_prev_cur, triangles_prev_next, prev_interp, triangles_prev);
+}
+
 kernel void compute_morton_codes(buffer<const float3> aabbs,
 								 buffer<const float3> centroids_cur,
 								 buffer<const float3> centroids_next,
@@ -198,6 +266,54 @@ kernel void compute_morton_codes(buffer<const float3> aabbs,
 	morton_codes[id] = { morton_code, id };
 }
 
+// 63-bit variant of the above: since radix sort only handles { 32-bit key, value } pairs, the morton code is split into
+// two halves, with both being stored per triangle and the sorted buffer initially containing { lower half, triangle id }.
+// after sorting by the lower half, "gather_morton_codes_hi" replaces the key with the upper half, which is then sorted
+// in a second (stable) radix sort run -> results in codes sorted by { upper, lower }.
+kernel void compute_morton_codes_wide(buffer<const float3> aabbs,
+									  buffer<const float3> centroids_cur,
+									  buffer<const float3> centroids_next,
+									  param<uint32_t> triangle_count,
+									  param<uint32_t> mesh_idx,
+									  param<float> interp,
+									  buffer<uint2> morton_codes,
+									  buffer<uint32_t> morton_codes_hi,
+									  buffer<uint32_t> morton_codes_lo) {
+	const auto id = global_id.x;
+	if(id >= triangle_count) {
+		// mark as unused (triangle id is invalid as well)
+		morton_codes[id] = 0xFFFFFFFFu;
+		return;
+	}
+	
+	const auto bbox_min = aabbs[mesh_idx * 2];
+	const auto bbox_max = aabbs[mesh_idx * 2 + 1];
+	auto coord = centroids_cur[id].interpolated(centroids_next[id], interp);
+	
+	// scale to [0, 1], then to [0, 2097151] as integer (so it fits into 21-bit)
+	coord = (coord - bbox_min).abs() / (bbox_max - bbox_min);
+	const auto scaled_coord = uint3(coord * 2097152.0f).min(2097151u);
+	const auto morton_code = morton_64(scaled_coord.x, scaled_coord.y, scaled_coord.z);
+	
+	const auto code_hi = uint32_t(morton_code >> 32ull);
+	const auto code_lo = uint32_t(morton_code & 0xFFFFFFFFull);
+	morton_codes_hi[id] = code_hi;
+	morton_codes_lo[id] = code_lo;
+	morton_codes[id] = { code_lo, id };
+}
+
+kernel void gather_morton_codes_hi(buffer<uint2> morton_codes,
+								   buffer<const uint32_t> morton_codes_hi,
+								   param<uint32_t> morton_codes_count) {
+	const auto id = global_id.x;
+	if(id >= morton_codes_count) return;
+	
+	const auto code = morton_codes[id];
+	// unused entries stay at 0xFFFFFFFF, so that they'll still be sorted to the end
+	if(code.y == 0xFFFFFFFFu) return;
+	morton_codes[id].x = morton_codes_hi[code.y];
+}
+
 // NOTE: prefix = clz(morton code ^ morton code)
 // this is getting to ugly ...
 #define prefix_checked(a, b, c) prefix_checked_int_(a, b, c, morton_codes, internal_node_count)
@@ -229,28 +345,65 @@ static int32_t prefix_unchecked(const uint32_t& mc_i, const uint32_t& mc_j) {
 	return math::clz(mc_i ^ mc_j);
 }
 
-kernel void build_bvh(buffer<const uint2> morton_codes,
-					  buffer<uint3> bvh_internal,
-					  buffer<uint32_t> bvh_leaves,
-					  param<uint32_t> internal_node_count) {
-	const auto idx = global_id.x;
-	if(global_id.x >= internal_node_count) {
-		return;
+// 63-bit morton codes: the sorted buffer contains { upper 32 bits, triangle id },
+// the lower 32 bits are stored per triangle in "morton_codes_lo"
+static uint64_t load_wide_morton_code(global const uint2* morton_codes,
+									  global const uint32_t* morton_codes_lo,
+									  const uint32_t& idx) {
+	const auto code = morton_codes[idx];
+	// unused entries have no triangle (and thus no lower half)
+	if(code.x > 0x7FFFFFFFu) {
+		return ~0ull;
 	}
-	
+	return (uint64_t(code.x) << 32ull) | uint64_t(morton_codes_lo[code.y]);
+}
+
+#define prefix_checked_wide(a, b, c) prefix_checked_wide_int_(a, b, c, morton_codes, morton_codes_lo, internal_node_count)
+static int32_t prefix_checked_wide_int_(const uint64_t& mc_i,
+										const uint32_t& i,
+										const int32_t& j,
+										global const uint2* morton_codes,
+										global const uint32_t* morton_codes_lo,
+										const uint32_t& internal_node_count) {
+	// out of range checks (i and j)
+	if(mc_i > 0x7FFFFFFFFFFFFFFFull) {
+		return -1;
+	}
+	if(j < 0 || uint32_t(j) > internal_node_count) {
+		return -1;
+	}
+	const uint64_t mc_j = load_wide_morton_code(morton_codes, morton_codes_lo, uint32_t(j));
+	// identical morton codes: fall back to i and j (see above), but add 64 instead of 32
+	if(mc_i == mc_j) {
+		return 64 + math::clz(i ^ uint32_t(j));
+	}
+	return math::clz(mc_i ^ mc_j);
+}
+static int32_t prefix_unchecked(const uint64_t& mc_i, const uint64_t& mc_j) {
+	return math::clz(mc_i ^ mc_j);
+}
+
+// shared by the 30-bit and 63-bit variants:
+// "load_code" returns the morton code at the specified (sorted) index, "prefix_checked_func" wraps one of the above
+template <typename load_code_func_type, typename prefix_checked_func_type>
+floor_inline_always static void build_bvh_impl(const uint32_t idx,
+											   load_code_func_type&& load_code,
+											   prefix_checked_func_type&& prefix_checked_func,
+											   buffer<uint3> bvh_internal,
+											   buffer<uint32_t> bvh_leaves) {
 	// credits: https://research.nvidia.com/sites/default/files/publications/karras2012hpg_paper.pdf
 	
 	// -> determine_range
 	// determine direction of the range (+1 or -1)
-	const auto mc_idx = morton_codes[idx].x;
-	const int prefix_prev = (idx > 0 ? prefix_checked(mc_idx, idx, int(idx) - 1) : -1);
-	const int prefix_next = prefix_checked(mc_idx, idx, int(idx) + 1);
+	const auto mc_idx = load_code(idx);
+	const int prefix_prev = (idx > 0 ? prefix_checked_func(mc_idx, idx, int(idx) - 1) : -1);
+	const int prefix_next = prefix_checked_func(mc_idx, idx, int(idx) + 1);
 	const int d = (prefix_next - prefix_prev < 0 ? -1 : 1);
 	
 	// compute upper bound for the length of the range
 	const int delta_min = (d < 0 ? prefix_next : prefix_prev);
 	int l_max = 2;
-	while(prefix_checked(mc_idx, idx, int(idx) + l_max * d) > delta_min) {
+	while(prefix_checked_func(mc_idx, idx, int(idx) + l_max * d) > delta_min) {
 		l_max <<= 1;
 	}
 	// TODO: use paper hint with l_max <<= 2u and starting at 128? --good enough for now
@@ -258,7 +411,7 @@ kernel void build_bvh(buffer<const uint2> morton_codes,
 	// find the other end using binary search
 	int l = 0;
 	for(int t = l_max >> 1; t > 0; t >>= 1) {
-		if(prefix_checked(mc_idx, idx, int(idx) + (l + t) * d) > delta_min) {
+		if(prefix_checked_func(mc_idx, idx, int(idx) + (l + t) * d) > delta_min) {
 			l += t;
 		}
 	}
@@ -272,8 +425,8 @@ kernel void build_bvh(buffer<const uint2> morton_codes,
 	
 	// -> find_split
 	// credits: http://devblogs.nvidia.com/parallelforall/thinking-parallel-part-iii-tree-construction-gpu
-	const auto mc_begin = morton_codes[range.x].x;
-	const auto mc_end = morton_codes[range.y].x;
+	const auto mc_begin = load_code(range.x);
+	const auto mc_end = load_code(range.y);
 	uint32_t split = 0u;
 	if(mc_begin != mc_end) {
 		const auto common_prefix = prefix_unchecked(mc_begin, mc_end);
@@ -285,7 +438,7 @@ kernel void build_bvh(buffer<const uint2> morton_codes,
 			const auto new_split = split + step;
 			
 			if(new_split < range.y) {
-				const auto split_code = morton_codes[new_split].x;
+				const auto split_code = load_code(new_split);
 				const auto split_prefix = prefix_unchecked(mc_begin, split_code);
 				if(split_prefix > common_prefix) {
 					split = new_split;
@@ -298,7 +451,7 @@ kernel void build_bvh(buffer<const uint2> morton_codes,
 		// and simply uses "(range.x + range.y) >> 1", but this is wrong under certain conditions
 		// -> use the same code as above, but with checked parameters
 		// note that this shouldn't influence general performance, because it happens only very rarely
-		const auto common_prefix = prefix_checked(mc_begin, range.x, int(range.y));
+		const auto common_prefix = prefix_checked_func(mc_begin, range.x, int(range.y));
 		split = range.x;
 		auto step = range.y - range.x;
 		
@@ -307,7 +460,7 @@ kernel void build_bvh(buffer<const uint2> morton_codes,
 			const auto new_split = split + step;
 			
 			if(new_split < range.y) {
-				const auto split_prefix = prefix_checked(mc_begin, range.x, int(new_split));
+				const auto split_prefix = prefix_checked_func(mc_begin, range.x, int(new_split));
 				if(split_prefix > common_prefix) {
 					split = new_split;
 				}
@@ -339,6 +492,41 @@ kernel void build_bvh(buffer<const uint2> morton_codes,
 	}
 }
 
+kernel void build_bvh(buffer<const uint2> morton_codes,
+					  buffer<uint3> bvh_internal,
+					  buffer<uint32_t> bvh_leaves,
+					  param<uint32_t> internal_node_count) {
+	const auto idx = global_id.x;
+	if(global_id.x >= internal_node_count) {
+		return;
+	}
+	build_bvh_impl(idx,
+				   [&morton_codes](const uint32_t& code_idx) { return morton_codes[code_idx].x; },
+				   [&morton_codes, &internal_node_count](const uint32_t& mc_i, const uint32_t& i, const int32_t& j) {
+					   return prefix_checked(mc_i, i, j);
+				   },
+				   bvh_internal, bvh_leaves);
+}
+
+kernel void build_bvh_wide(buffer<const uint2> morton_codes,
+						   buffer<const uint32_t> morton_codes_lo,
+						   buffer<uint3> bvh_internal,
+						   buffer<uint32_t> bvh_leaves,
+						   param<uint32_t> internal_node_count) {
+	const auto idx = global_id.x;
+	if(global_id.x >= internal_node_count) {
+		return;
+	}
+	build_bvh_impl(idx,
+				   [&morton_codes, &morton_codes_lo](const uint32_t& code_idx) {
+					   return load_wide_morton_code(morton_codes, morton_codes_lo, code_idx);
+				   },
+				   [&morton_codes, &morton_codes_lo, &internal_node_count](const uint64_t& mc_i, const uint32_t& i, const int32_t& j) {
+					   return prefix_checked_wide(mc_i, i, j);
+				   },
+				   bvh_internal, bvh_leaves);
+}
+
 kernel void build_bvh_aabbs_leaves(buffer<const uint2> morton_codes,
 								   param<uint32_t> leaf_count,
 								   buffer<const float3> triangles,
@@ -359,6 +547,29 @@ kernel void build_bvh_aabbs_leaves(buffer<const uint2> morton_codes,
 	bvh_aabbs_leaves[idx * 2 + 1] = v0.maxed(v1).maxed(v2);
 }
 
+// same as above, but the leaf aabb encloses the triangle at both the start and end of the step
+kernel void build_bvh_aabbs_leaves_swept(buffer<const uint2> morton_codes,
+										 param<uint32_t> leaf_count,
+										 buffer<const float3> triangles,
+										 buffer<const float3> triangles_prev,
+										 buffer<float3> bvh_aabbs_leaves) {
+	const auto idx = global_id.x;
+	if(idx >= leaf_count) {
+		return;
+	}
+	
+	const auto tri_id = morton_codes[idx].y;
+	const auto v0 = triangles[tri_id * 3];
+	const auto v1 = triangles[tri_id * 3 + 1];
+	const auto v2 = triangles[tri_id * 3 + 2];
+	const auto pv0 = triangles_prev[tri_id * 3];
+	const auto pv1 = triangles_prev[tri_id * 3 + 1];
+	const auto pv2 = triangles_prev[tri_id * 3 + 2];
+	
+	bvh_aabbs_leaves[idx * 2] = v0.minned(v1).minned(v2).minned(pv0).minned(pv1).minned(pv2);
+	bvh_aabbs_leaves[idx * 2 + 1] = v0.maxed(v1).maxed(v2).maxed(pv0).maxed(pv1).maxed(pv2);
+}
+
 kernel void build_bvh_aabbs(buffer<const uint2> morton_codes floor_unused,
 							buffer<const uint3> bvh_internal,
 							buffer<const uint32_t> bvh_leaves,
@@ -447,51 +658,189 @@ static const_array<float3, 3> read_triangle(buffer<const float3> triangles, cons
 	}};
 }
 
-template <bool triangle_vis>
-floor_inline_always static void collide_bvhs(// the leaves of bvh A that we want to collide with bvh B
-											 const uint32_t leaf_count_a,
-											 buffer<const float3> bvh_aabbs_leaves_a,
-											 buffer<const float3> triangles_a,
-											 buffer<const uint2> morton_codes_a,
-											 // the complete bvh B
-											 const uint32_t internal_node_count_b floor_unused,
-											 buffer<const uint3> bvh_internal_b,
-											 buffer<const float3> bvh_aabbs_b,
-											 buffer<const float3> bvh_aabbs_leaves_b,
-											 buffer<const float3> triangles_b,
-											 buffer<const uint2> morton_codes_b,
-											 // mesh indices of A and B
-											 const uint32_t mesh_idx_a,
-											 const uint32_t mesh_idx_b,
-											 // flags if resp. mesh A/B collides with anything
-											 // also (ab)used as an abort condition here
-											 buffer<uint32_t> collision_flags,
-											 buffer<uint32_t> colliding_triangles_a,
-											 buffer<uint32_t> colliding_triangles_b) {
-	const auto idx = global_id.x;
-	if(idx >= leaf_count_a) {
-		return;
+// continuous collision detection for linearly moving vertices (start of step: prev_*, end of step: *):
+// two triangles that don't intersect at the start of the step can only start to intersect when a vertex of one
+// passes through the face of the other or when an edge of one passes through an edge of the other. both require the
+// 4 involved points to be coplanar, which for linear motion is a cubic in t -> all roots in [0, 1] of these 6
+// vertex/face and 9 edge/edge cubics are computed, and the features are checked for actually touching at each root.
+
+// coefficients (t^3, t^2, t, 1) of the coplanarity cubic (b(t) - a(t)) x (c(t) - a(t)) . (d(t) - a(t))
+static float4 coplanarity_cubic(const float3& a0, const float3& b0, const float3& c0, const float3& d0,
+								const float3& a1, const float3& b1, const float3& c1, const float3& d1) {
+	const float3 x21 = b0 - a0, x31 = c0 - a0, x41 = d0 - a0;
+	const float3 v21 = (b1 - a1) - x21, v31 = (c1 - a1) - x31, v41 = (d1 - a1) - x41;
+	const auto xx = x21.crossed(x31);
+	const auto vv = v21.crossed(v31);
+	const auto xv = x21.crossed(v31) + v21.crossed(x31);
+	return { vv.dot(v41), xv.dot(v41) + vv.dot(x41), xv.dot(x41) + xx.dot(v41), xx.dot(x41) };
+}
+
+static float eval_cubic(const float4& c, const float& t) {
+	return ((c.x * t + c.y) * t + c.z) * t + c.w;
+}
+
+// calls "touch_func(t)" for each root of the cubic in [0, 1] (in ascending order) until it returns true,
+// returns that root or a value > 1 if there is none
+template <typename touch_func_type>
+floor_inline_always static float find_first_touching_root(const float4& c, touch_func_type&& touch_func) {
+	// split [0, 1] at the extrema of the cubic (roots of 3 * c.x * t^2 + 2 * c.y * t + c.z),
+	// so that each interval is monotonic and contains at most one root
+	float split_0 = 1.0f, split_1 = 1.0f;
+	const float qa = 3.0f * c.x, qb = 2.0f * c.y, qc = c.z;
+	if(qa != 0.0f) {
+		const auto disc = qb * qb - 4.0f * qa * qc;
+		if(disc > 0.0f) {
+			const auto sqrt_disc = sqrt(disc);
+			const auto r0 = (-qb - sqrt_disc) / (2.0f * qa), r1 = (-qb + sqrt_disc) / (2.0f * qa);
+			split_0 = const_math::clamp(min(r0, r1), 0.0f, 1.0f);
+			split_1 = const_math::clamp(max(r0, r1), 0.0f, 1.0f);
+		}
+	}
+	else if(qb != 0.0f) {
+		split_0 = const_math::clamp(-qc / qb, 0.0f, 1.0f);
 	}
 	
-	// leaf aabb
-	const float3 b_min = bvh_aabbs_leaves_a[idx * 2];
-	const float3 b_max = bvh_aabbs_leaves_a[idx * 2 + 1];
+	const float bounds[4] { 0.0f, split_0, split_1, 1.0f };
+#pragma unroll
+	for(uint32_t i = 0; i < 3; ++i) {
+		auto lo = bounds[i], hi = bounds[i + 1];
+		if(hi < lo) continue;
+		auto f_lo = eval_cubic(c, lo);
+		const auto f_hi = eval_cubic(c, hi);
+		if((f_lo < 0.0f && f_hi < 0.0f) || (f_lo > 0.0f && f_hi > 0.0f)) continue;
+		
+		// bisect
+		for(uint32_t iter = 0; iter < CCD_ROOT_ITERATIONS; ++iter) {
+			const auto mid = (lo + hi) * 0.5f;
+			const auto f_mid = eval_cubic(c, mid);
+			if((f_lo <= 0.0f && f_mid <= 0.0f) || (f_lo >= 0.0f && f_mid >= 0.0f)) {
+				lo = mid;
+				f_lo = f_mid;
+			}
+			else {
+				hi = mid;
+			}
+		}
+		if(touch_func(hi)) {
+			return hi;
+		}
+	}
+	return 2.0f;
+}
+
+// checks if the (coplanar) point p lies inside the triangle (a, b, c) (with some tolerance)
+static bool check_vertex_face_touch(const float3& p, const float3& a, const float3& b, const float3& c) {
+	const auto e1 = b - a, e2 = c - a, w = p - a;
+	const auto n = e1.crossed(e2);
+	const auto nn = n.dot(n);
+	if(nn == 0.0f) return false;
 	
-	//
-	uint32_t stack[64];
+	// distance to the plane (relative to the triangle size)
+	const auto dist = n.dot(w);
+	const auto max_edge_sq = max(max(e1.dot(e1), e2.dot(e2)), (c - b).dot(c - b));
+	if(dist * dist > CCD_TOLERANCE * CCD_TOLERANCE * max_edge_sq * nn) return false;
+	
+	// barycentric coordinates
+	const auto u = w.crossed(e2).dot(n) / nn;
+	const auto v = e1.crossed(w).dot(n) / nn;
+	return (u >= -CCD_TOLERANCE && v >= -CCD_TOLERANCE && u + v <= 1.0f + CCD_TOLERANCE);
+}
+
+// checks if the (coplanar) edges (p0, p1) and (q0, q1) touch (with some tolerance)
+static bool check_edge_edge_touch(const float3& p0, const float3& p1, const float3& q0, const float3& q1) {
+	// closest points of both segments
+	const auto d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+	const auto a = d1.dot(d1), e = d2.dot(d2);
+	// degenerate edges are covered by the vertex/face tests
+	if(a == 0.0f || e == 0.0f) return false;
+	const auto b = d1.dot(d2), c = d1.dot(r), f = d2.dot(r);
+	const auto denom = a * e - b * b;
+	auto s = (denom != 0.0f ? const_math::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f);
+	auto t = (b * s + f) / e;
+	if(t < 0.0f) {
+		t = 0.0f;
+		s = const_math::clamp(-c / a, 0.0f, 1.0f);
+	}
+	else if(t > 1.0f) {
+		t = 1.0f;
+		s = const_math::clamp((b - c) / a, 0.0f, 1.0f);
+	}
+	const auto diff = (p0 + d1 * s) - (q0 + d2 * t);
+	return (diff.dot(diff) <= CCD_TOLERANCE * CCD_TOLERANCE * max(a, e));
+}
+
+// swept triangle/triangle test (see above),
+// returns the time of impact in [0, 1], or a value > 1 if both triangles don't intersect during the step
+static float check_swept_triangle_intersection(const const_array<float3, 3>& prev_a, const const_array<float3, 3>& a,
+											   const const_array<float3, 3>& prev_b, const const_array<float3, 3>& b) {
+	if(check_triangle_intersection(prev_a[0], prev_a[1], prev_a[2], prev_b[0], prev_b[1], prev_b[2])) {
+		return 0.0f;
+	}
+	
+	float toi = 2.0f;
+	
+	// vertex of one triangle vs face of the other
+	const auto vertex_face = [&toi](const float3& p0, const float3& p1,
+									const const_array<float3, 3>& prev_f, const const_array<float3, 3>& f) {
+		const auto cubic = coplanarity_cubic(prev_f[0], prev_f[1], prev_f[2], p0, f[0], f[1], f[2], p1);
+		toi = min(toi, find_first_touching_root(cubic, [&](const float& t) {
+			return check_vertex_face_touch(p0.interpolated(p1, t),
+										   prev_f[0].interpolated(f[0], t),
+										   prev_f[1].interpolated(f[1], t),
+										   prev_f[2].interpolated(f[2], t));
+		}));
+	};
+#pragma unroll
+	for(uint32_t i = 0; i < 3; ++i) {
+		vertex_face(prev_a[i], a[i], prev_b, b);
+		vertex_face(prev_b[i], b[i], prev_a, a);
+	}
+	
+	// edge vs edge
+#pragma unroll
+	for(uint32_t i = 0; i < 3; ++i) {
+#pragma unroll
+		for(uint32_t j = 0; j < 3; ++j) {
+			const auto& pp0 = prev_a[i], &pp1 = prev_a[(i + 1u) % 3u], &p0 = a[i], &p1 = a[(i + 1u) % 3u];
+			const auto& pq0 = prev_b[j], &pq1 = prev_b[(j + 1u) % 3u], &q0 = b[j], &q1 = b[(j + 1u) % 3u];
+			const auto cubic = coplanarity_cubic(pp0, pp1, pq0, pq1, p0, p1, q0, q1);
+			toi = min(toi, find_first_touching_root(cubic, [&](const float& t) {
+				return check_edge_edge_touch(pp0.interpolated(p0, t), pp1.interpolated(p1, t),
+											 pq0.interpolated(q0, t), pq1.interpolated(q1, t));
+			}));
+		}
+	}
+	if(toi <= 1.0f) {
+		return toi;
+	}
+	
+	// roots that were missed numerically (e.g. degenerate cubics of features that stay coplanar): still report
+	// triangles that intersect at the end of the step
+	if(check_triangle_intersection(a[0], a[1], a[2], b[0], b[1], b[2])) {
+		return 1.0f;
+	}
+	return 2.0f;
+}
+
+// traverses bvh B with the query aabb (b_min, b_max), starting at the root node
+// * "leaf_func(leaf_idx)" is called for each leaf of B that overlaps the query aabb
+// * "abort_func()" is called once per traversal step, traversal ends when it returns true
+template <typename leaf_func_type, typename abort_func_type>
+floor_inline_always static void traverse_bvh(const float3& b_min,
+											 const float3& b_max,
+											 buffer<const uint3> bvh_internal_b,
+											 buffer<const float3> bvh_aabbs_b,
+											 buffer<const float3> bvh_aabbs_leaves_b,
+											 leaf_func_type&& leaf_func,
+											 abort_func_type&& abort_func) {
+	uint32_t stack[BVH_MAX_DEPTH];
 	auto stack_ptr = stack;
 	*stack_ptr++ = 0; // push
 	
 	// traverse nodes starting from the root
 	uint32_t node = 0;
-	uint32_t iters = 0;
 	do {
-		if constexpr(!triangle_vis) {
-			// check abort condition (no need to do further checking when a collision has been found already)
-			// NOTE: need to check both, because either could have been set previously
-			// NOTE: if both have been set to true previously, this will also immediately return (as it should)
-			if(collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0) break;
-		}
+		if(abort_func()) break;
 		
 		bool traverse = false;
 #pragma unroll
@@ -508,23 +857,7 @@ floor_inline_always static void collide_bvhs(// the leaves of bvh A that we want
 			// query overlaps a leaf node
 			if(check_overlap(b_min, b_max, child_min, child_max)) {
 				if(is_leaf) {
-					// read triangle for this leaf node
-					const auto overlap_triangle_idx = morton_codes_b[masked_idx].y;
-					const auto ov = read_triangle(triangles_b, overlap_triangle_idx);
-					
-					// read triangle for querry node (leaf triangle)
-					// NOTE: this is faster / uses less registers than reading the triangle outside/before the traversal loop!
-					const auto triangle_idx = morton_codes_a[idx].y;
-					const auto v = read_triangle(triangles_a, triangle_idx);
-					
-					if(check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2])) {
-						atomic_inc(&collision_flags[mesh_idx_a]);
-						atomic_inc(&collision_flags[mesh_idx_b]);
-						if constexpr(triangle_vis) {
-							atomic_inc(&colliding_triangles_a[triangle_idx]);
-							atomic_inc(&colliding_triangles_b[overlap_triangle_idx]);
-						}
-					}
+					leaf_func(masked_idx);
 				}
 				else {
 					// query overlaps an internal node => traverse
@@ -542,10 +875,154 @@ floor_inline_always static void collide_bvhs(// the leaves of bvh A that we want
 		if(!traverse) {
 			node = *--stack_ptr;
 		}
-		++iters;
 	} while(node != 0);
 }
 
+// appends a contact to the bounded contacts buffer
+// NOTE: the counter is always incremented, so that the host can determine how many contacts didn't fit (overflow)
+static void append_contact(buffer<triangle_contact> contacts,
+						   buffer<uint32_t> contacts_counter,
+						   const uint32_t& max_contacts,
+						   const triangle_contact& contact) {
+	const auto contact_idx = atomic_inc(&contacts_counter[0]);
+	if(contact_idx < max_contacts) {
+		contacts[contact_idx] = contact;
+	}
+}
+
+// triangle_vis: also flag the colliding triangles of A and B
+// contacts: append all colliding triangle pairs to "contacts" (this disables the early abort)
+// swept: continuous collision detection, the leaf aabbs and bvh of A and B must have been built with the swept
+//        variants, triangles_prev_* contain the triangles at the start of the step
+template <bool triangle_vis, bool contacts, bool swept>
+floor_inline_always static void collide_bvh_leaf(// the leaf of bvh A that we want to collide with bvh B
+												 const uint32_t idx,
+												 buffer<const float3> bvh_aabbs_leaves_a,
+												 buffer<const float3> triangles_a,
+												 buffer<const uint2> morton_codes_a,
+												 // the complete bvh B
+												 const uint32_t internal_node_count_b floor_unused,
+												 buffer<const uint3> bvh_internal_b,
+												 buffer<const float3> bvh_aabbs_b,
+												 buffer<const float3> bvh_aabbs_leaves_b,
+												 buffer<const float3> triangles_b,
+												 buffer<const uint2> morton_codes_b,
+												 // mesh indices of A and B
+												 const uint32_t mesh_idx_a,
+												 const uint32_t mesh_idx_b,
+												 // flags if resp. mesh A/B collides with anything
+												 // also (ab)used as an abort condition here
+												 buffer<uint32_t> collision_flags,
+												 buffer<uint32_t> colliding_triangles_a,
+												 buffer<uint32_t> colliding_triangles_b,
+												 // contacts output
+												 buffer<triangle_contact> contacts_out,
+												 buffer<uint32_t> contacts_counter,
+												 const uint32_t max_contacts,
+												 const uint32_t compute_contact_points,
+												 // ccd: triangles at the start of the step
+												 buffer<const float3> triangles_prev_a,
+												 buffer<const float3> triangles_prev_b) {
+	// leaf aabb
+	const float3 b_min = bvh_aabbs_leaves_a[idx * 2];
+	const float3 b_max = bvh_aabbs_leaves_a[idx * 2 + 1];
+	
+	traverse_bvh(b_min, b_max, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b,
+				 [&](const uint32_t& leaf_idx_b) {
+		// read triangle for this leaf node
+		const auto overlap_triangle_idx = morton_codes_b[leaf_idx_b].y;
+		const auto ov = read_triangle(triangles_b, overlap_triangle_idx);
+		
+		// read triangle for querry node (leaf triangle)
+		// NOTE: this is faster / uses less registers than reading the triangle outside/before the traversal loop!
+		const auto triangle_idx = morton_codes_a[idx].y;
+		const auto v = read_triangle(triangles_a, triangle_idx);
+		
+		bool is_intersecting = false;
+		if constexpr(!swept) {
+			is_intersecting = check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2]);
+		}
+		else {
+			is_intersecting = (check_swept_triangle_intersection(read_triangle(triangles_prev_a, triangle_idx), v,
+																 read_triangle(triangles_prev_b, overlap_triangle_idx), ov) <= 1.0f);
+		}
+		
+		if(is_intersecting) {
+			atomic_inc(&collision_flags[mesh_idx_a]);
+			atomic_inc(&collision_flags[mesh_idx_b]);
+			if constexpr(triangle_vis) {
+				atomic_inc(&colliding_triangles_a[triangle_idx]);
+				atomic_inc(&colliding_triangles_b[overlap_triangle_idx]);
+			}
+			if constexpr(contacts) {
+				triangle_contact contact {
+					.mesh_a = mesh_idx_a,
+					.triangle_a = triangle_idx,
+					.mesh_b = mesh_idx_b,
+					.triangle_b = overlap_triangle_idx,
+					.point_0 = {},
+					.point_1 = {},
+				};
+				if(compute_contact_points != 0u) {
+					compute_triangle_intersection_segment(v[0], v[1], v[2], ov[0], ov[1], ov[2],
+														  contact.point_0, contact.point_1);
+				}
+				append_contact(contacts_out, contacts_counter, max_contacts, contact);
+			}
+		}
+	}, [&]() {
+		if constexpr(!triangle_vis && !contacts) {
+			// check abort condition (no need to do further checking when a collision has been found already)
+			// NOTE: need to check both, because either could have been set previously
+			// NOTE: if both have been set to true previously, this will also immediately return (as it should)
+			return (collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0);
+		}
+		return false;
+	});
+}
+
+// one work-item per leaf of A (see collide_bvh_leaf)
+template <bool triangle_vis, bool contacts, bool swept>
+floor_inline_always static void collide_bvhs(// the leaves of bvh A that we want to collide with bvh B
+											 const uint32_t leaf_count_a,
+											 buffer<const float3> bvh_aabbs_leaves_a,
+											 buffer<const float3> triangles_a,
+											 buffer<const uint2> morton_codes_a,
+											 // the complete bvh B
+											 const uint32_t internal_node_count_b,
+											 buffer<const uint3> bvh_internal_b,
+											 buffer<const float3> bvh_aabbs_b,
+											 buffer<const float3> bvh_aabbs_leaves_b,
+											 buffer<const float3> triangles_b,
+											 buffer<const uint2> morton_codes_b,
+											 // mesh indices of A and B
+											 const uint32_t mesh_idx_a,
+											 const uint32_t mesh_idx_b,
+											 // flags if resp. mesh A/B collides with anything
+											 // also (ab)used as an abort condition here
+											 buffer<uint32_t> collision_flags,
+											 buffer<uint32_t> colliding_triangles_a,
+											 buffer<uint32_t> colliding_triangles_b,
+											 // contacts output
+											 buffer<triangle_contact> contacts_out,
+											 buffer<uint32_t> contacts_counter,
+											 const uint32_t max_contacts,
+											 const uint32_t compute_contact_points,
+											 // ccd: triangles at the start of the step
+											 buffer<const float3> triangles_prev_a,
+											 buffer<const float3> triangles_prev_b) {
+	const auto idx = global_id.x;
+	if(idx >= leaf_count_a) {
+		return;
+	}
+	collide_bvh_leaf<triangle_vis, contacts, swept>(idx, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+													internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b,
+													triangles_b, morton_codes_b, mesh_idx_a, mesh_idx_b, collision_flags,
+													colliding_triangles_a, colliding_triangles_b,
+													contacts_out, contacts_counter, max_contacts, compute_contact_points,
+													triangles_prev_a, triangles_prev_b);
+}
+
 kernel void collide_bvhs_no_tri_vis(param<uint32_t> leaf_count_a,
 									buffer<const float3> bvh_aabbs_leaves_a,
 									buffer<const float3> triangles_a,
@@ -559,9 +1036,10 @@ kernel void collide_bvhs_no_tri_vis(param<uint32_t> leaf_count_a,
 									param<uint32_t> mesh_idx_a,
 									param<uint32_t> mesh_idx_b,
 									buffer<uint32_t> collision_flags) {
-	collide_bvhs<false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
-						internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
-						mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr);
+	collide_bvhs<false, false, false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							   internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+							   mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr,
+							   nullptr, nullptr, 0u, 0u, nullptr, nullptr);
 }
 
 kernel void collide_bvhs_tri_vis(param<uint32_t> leaf_count_a,
@@ -579,21 +1057,536 @@ kernel void collide_bvhs_tri_vis(param<uint32_t> leaf_count_a,
 								 buffer<uint32_t> collision_flags,
 								 buffer<uint32_t> colliding_triangles_a,
 								 buffer<uint32_t> colliding_triangles_b) {
-	collide_bvhs<true>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
-					   internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
-					   mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b);
+	collide_bvhs<true, false, false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							  internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+							  mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b,
+							  nullptr, nullptr, 0u, 0u, nullptr, nullptr);
 }
 
-kernel void collide_root_aabbs(buffer<const float3> aabbs,
-							   param<uint32_t> total_aabb_checks,
-							   param<uint32_t> mesh_count,
-							   buffer<uint32_t> aabb_collision_flags) {
-	const auto id = global_id.x;
-	if(id >= total_aabb_checks) return;
+// persistent-threads variant of collide_bvhs: only as many work-items are launched as the device can keep resident,
+// each of which repeatedly grabs the next batch of leaves of A from "leaf_counter" until all leaves have been processed
+// -> traversal costs are very uneven (leaves far from B exit after the root test, leaves in the contact region traverse
+//    deeply), so work-items that finish early continue with new leaves instead of idling until the whole group is done
+// NOTE: "leaf_counter" must be zero-initialized
+template <bool triangle_vis>
+floor_inline_always static void collide_bvhs_persistent(const uint32_t leaf_count_a,
+														buffer<const float3> bvh_aabbs_leaves_a,
+														buffer<const float3> triangles_a,
+														buffer<const uint2> morton_codes_a,
+														const uint32_t internal_node_count_b,
+														buffer<const uint3> bvh_internal_b,
+														buffer<const float3> bvh_aabbs_b,
+														buffer<const float3> bvh_aabbs_leaves_b,
+														buffer<const float3> triangles_b,
+														buffer<const uint2> morton_codes_b,
+														const uint32_t mesh_idx_a,
+														const uint32_t mesh_idx_b,
+														buffer<uint32_t> collision_flags,
+														buffer<uint32_t> colliding_triangles_a,
+														buffer<uint32_t> colliding_triangles_b,
+														buffer<uint32_t> leaf_counter) {
+	for(;;) {
+		// no need to grab more leaves once both meshes are known to collide
+		if constexpr(!triangle_vis) {
+			if(collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0) {
+				return;
+			}
+		}
+		
+		const auto first_leaf = atomic_add(&leaf_counter[0], PERSISTENT_LEAF_BATCH_SIZE);
+		if(first_leaf >= leaf_count_a) {
+			return;
+		}
+		const auto end_leaf = min(first_leaf + PERSISTENT_LEAF_BATCH_SIZE, leaf_count_a);
+		for(uint32_t idx = first_leaf; idx < end_leaf; ++idx) {
+			collide_bvh_leaf<triangle_vis, false, false>(idx, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+														 internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b,
+														 triangles_b, morton_codes_b, mesh_idx_a, mesh_idx_b, collision_flags,
+														 colliding_triangles_a, colliding_triangles_b,
+														 nullptr, nullptr, 0u, 0u, nullptr, nullptr);
+		}
+	}
+}
+
+kernel void collide_bvhs_persistent_no_tri_vis(param<uint32_t> leaf_count_a,
+											   buffer<const float3> bvh_aabbs_leaves_a,
+											   buffer<const float3> triangles_a,
+											   buffer<const uint2> morton_codes_a,
+											   param<uint32_t> internal_node_count_b,
+											   buffer<const uint3> bvh_internal_b,
+											   buffer<const float3> bvh_aabbs_b,
+											   buffer<const float3> bvh_aabbs_leaves_b,
+											   buffer<const float3> triangles_b,
+											   buffer<const uint2> morton_codes_b,
+											   param<uint32_t> mesh_idx_a,
+											   param<uint32_t> mesh_idx_b,
+											   buffer<uint32_t> collision_flags,
+											   buffer<uint32_t> leaf_counter) {
+	collide_bvhs_persistent<false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+								   internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+								   mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr, leaf_counter);
+}
+
+kernel void collide_bvhs_persistent_tri_vis(param<uint32_t> leaf_count_a,
+											buffer<const float3> bvh_aabbs_leaves_a,
+											buffer<const float3> triangles_a,
+											buffer<const uint2> morton_codes_a,
+											param<uint32_t> internal_node_count_b,
+											buffer<const uint3> bvh_internal_b,
+											buffer<const float3> bvh_aabbs_b,
+											buffer<const float3> bvh_aabbs_leaves_b,
+											buffer<const float3> triangles_b,
+											buffer<const uint2> morton_codes_b,
+											param<uint32_t> mesh_idx_a,
+											param<uint32_t> mesh_idx_b,
+											buffer<uint32_t> collision_flags,
+											buffer<uint32_t> colliding_triangles_a,
+											buffer<uint32_t> colliding_triangles_b,
+											buffer<uint32_t> leaf_counter) {
+	collide_bvhs_persistent<true>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+								  internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+								  mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b, leaf_counter);
+}
+
+// batched narrowphase, pass #1: traverses bvh B for each leaf of A, but instead of testing the overlapping triangles
+// directly, only appends the candidate triangle pairs to "candidates" (-> memory-bound traversal w/o any exact tests)
+// NOTE: if the candidate buffer is full, the remaining pairs are tested directly instead
+// NOTE: only handles "leaf_count_a" leaves starting at "first_leaf_a" (w/o triangle visualization, leaves are processed
+//       in chunks, so that the collision flags set by the test pass of one chunk let the following chunks stop early)
+template <bool triangle_vis>
+floor_inline_always static void collect_candidate_pairs(const uint32_t first_leaf_a,
+														const uint32_t leaf_count_a,
+														buffer<const float3> bvh_aabbs_leaves_a,
+														buffer<const float3> triangles_a,
+														buffer<const uint2> morton_codes_a,
+														buffer<const uint3> bvh_internal_b,
+														buffer<const float3> bvh_aabbs_b,
+														buffer<const float3> bvh_aabbs_leaves_b,
+														buffer<const float3> triangles_b,
+														buffer<const uint2> morton_codes_b,
+														const uint32_t mesh_idx_a,
+														const uint32_t mesh_idx_b,
+														buffer<uint32_t> collision_flags,
+														buffer<uint32_t> colliding_triangles_a,
+														buffer<uint32_t> colliding_triangles_b,
+														buffer<uint2> candidates,
+														buffer<uint32_t> candidate_counter) {
+	if(global_id.x >= leaf_count_a) {
+		return;
+	}
+	const auto idx = first_leaf_a + global_id.x;
 	
-	// reverse cantor (map 1D linear index onto "half triangle" of a square -> all unique combinations of (i, j), with i != j)
-	const auto q = (uint32_t)fma(const_math::EPSILON<float> + sqrt(1.0f + 8.0f * float(id)), 0.5f, -0.5f);
-	const auto i = id - (q * (q + 1u)) / 2u;
+	const float3 b_min = bvh_aabbs_leaves_a[idx * 2];
+	const float3 b_max = bvh_aabbs_leaves_a[idx * 2 + 1];
+	traverse_bvh(b_min, b_max, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b,
+				 [&](const uint32_t& leaf_idx_b) {
+		const auto triangle_idx = morton_codes_a[idx].y;
+		const auto overlap_triangle_idx = morton_codes_b[leaf_idx_b].y;
+		const auto candidate_idx = atomic_inc(&candidate_counter[0]);
+		if(candidate_idx < NARROWPHASE_MAX_CANDIDATES) {
+			candidates[candidate_idx] = uint2 { triangle_idx, overlap_triangle_idx };
+			return;
+		}
+		
+		// overflow fallback
+		const auto v = read_triangle(triangles_a, triangle_idx);
+		const auto ov = read_triangle(triangles_b, overlap_triangle_idx);
+		if(check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2])) {
+			atomic_inc(&collision_flags[mesh_idx_a]);
+			atomic_inc(&collision_flags[mesh_idx_b]);
+			if constexpr(triangle_vis) {
+				atomic_inc(&colliding_triangles_a[triangle_idx]);
+				atomic_inc(&colliding_triangles_b[overlap_triangle_idx]);
+			}
+		}
+	}, [&]() {
+		if constexpr(!triangle_vis) {
+			return (collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0);
+		}
+		return false;
+	});
+}
+
+// batched narrowphase, pass #2: each work-item loads NARROWPHASE_BATCH_WIDTH candidate pairs into registers (SoA)
+// and then tests all of them with the branch-free triangle/triangle test (-> ALU-bound, no divergence)
+// NOTE: launched with a fixed amount of work-items that loop over all candidates, so that the candidate count never
+//       has to be read back to the host
+template <bool triangle_vis>
+floor_inline_always static void test_candidate_pairs(buffer<const uint2> candidates,
+													 buffer<const uint32_t> candidate_counter,
+													 buffer<const float3> triangles_a,
+													 buffer<const float3> triangles_b,
+													 const uint32_t mesh_idx_a,
+													 const uint32_t mesh_idx_b,
+													 buffer<uint32_t> collision_flags,
+													 buffer<uint32_t> colliding_triangles_a,
+													 buffer<uint32_t> colliding_triangles_b) {
+	const auto candidate_count = min(candidate_counter[0], NARROWPHASE_MAX_CANDIDATES);
+	const auto stride = global_size.x * NARROWPHASE_BATCH_WIDTH;
+	for(uint32_t first = global_id.x * NARROWPHASE_BATCH_WIDTH; first < candidate_count; first += stride) {
+		// no need to test any further pairs once both meshes are known to collide
+		if constexpr(!triangle_vis) {
+			if(collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0) {
+				return;
+			}
+		}
+		
+		// gather (out-of-range slots test the last valid pair again and are masked out below)
+		uint2 pairs[NARROWPHASE_BATCH_WIDTH];
+		float3 a0[NARROWPHASE_BATCH_WIDTH], a1[NARROWPHASE_BATCH_WIDTH], a2[NARROWPHASE_BATCH_WIDTH];
+		float3 b0[NARROWPHASE_BATCH_WIDTH], b1[NARROWPHASE_BATCH_WIDTH], b2[NARROWPHASE_BATCH_WIDTH];
+#pragma unroll
+		for(uint32_t i = 0; i < NARROWPHASE_BATCH_WIDTH; ++i) {
+			pairs[i] = candidates[min(first + i, candidate_count - 1u)];
+			const auto v = read_triangle(triangles_a, pairs[i].x);
+			const auto ov = read_triangle(triangles_b, pairs[i].y);
+			a0[i] = v[0];
+			a1[i] = v[1];
+			a2[i] = v[2];
+			b0[i] = ov[0];
+			b1[i] = ov[1];
+			b2[i] = ov[2];
+		}
+		
+		// test
+		bool hits[NARROWPHASE_BATCH_WIDTH];
+#pragma unroll
+		for(uint32_t i = 0; i < NARROWPHASE_BATCH_WIDTH; ++i) {
+			hits[i] = ((first + i < candidate_count) &
+					   check_triangle_intersection_branchless(a0[i], a1[i], a2[i], b0[i], b1[i], b2[i]));
+		}
+		
+		// scatter
+		bool any_hit = false;
+#pragma unroll
+		for(uint32_t i = 0; i < NARROWPHASE_BATCH_WIDTH; ++i) {
+			if constexpr(triangle_vis) {
+				if(hits[i]) {
+					atomic_inc(&colliding_triangles_a[pairs[i].x]);
+					atomic_inc(&colliding_triangles_b[pairs[i].y]);
+				}
+			}
+			any_hit |= hits[i];
+		}
+		if(any_hit) {
+			atomic_inc(&collision_flags[mesh_idx_a]);
+			atomic_inc(&collision_flags[mesh_idx_b]);
+		}
+	}
+}
+
+kernel void collect_candidate_pairs_no_tri_vis(param<uint32_t> first_leaf_a,
+											   param<uint32_t> leaf_count_a,
+											   buffer<const float3> bvh_aabbs_leaves_a,
+											   buffer<const float3> triangles_a,
+											   buffer<const uint2> morton_codes_a,
+											   buffer<const uint3> bvh_internal_b,
+											   buffer<const float3> bvh_aabbs_b,
+											   buffer<const float3> bvh_aabbs_leaves_b,
+											   buffer<const float3> triangles_b,
+											   buffer<const uint2> morton_codes_b,
+											   param<uint32_t> mesh_idx_a,
+											   param<uint32_t> mesh_idx_b,
+											   buffer<uint32_t> collision_flags,
+											   buffer<uint2> candidates,
+											   buffer<uint32_t> candidate_counter) {
+	collect_candidate_pairs<false>(first_leaf_a, leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+								   bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+								   mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr, candidates, candidate_counter);
+}
+
+kernel void collect_candidate_pairs_tri_vis(param<uint32_t> first_leaf_a,
+											param<uint32_t> leaf_count_a,
+											buffer<const float3> bvh_aabbs_leaves_a,
+											buffer<const float3> triangles_a,
+											buffer<const uint2> morton_codes_a,
+											buffer<const uint3> bvh_internal_b,
+											buffer<const float3> bvh_aabbs_b,
+											buffer<const float3> bvh_aabbs_leaves_b,
+											buffer<const float3> triangles_b,
+											buffer<const uint2> morton_codes_b,
+											param<uint32_t> mesh_idx_a,
+											param<uint32_t> mesh_idx_b,
+											buffer<uint32_t> collision_flags,
+											buffer<uint32_t> colliding_triangles_a,
+											buffer<uint32_t> colliding_triangles_b,
+											buffer<uint2> candidates,
+											buffer<uint32_t> candidate_counter) {
+	collect_candidate_pairs<true>(first_leaf_a, leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+								  bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+								  mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b,
+								  candidates, candidate_counter);
+}
+
+kernel void test_candidate_pairs_no_tri_vis(buffer<const uint2> candidates,
+											buffer<const uint32_t> candidate_counter,
+											buffer<const float3> triangles_a,
+											buffer<const float3> triangles_b,
+											param<uint32_t> mesh_idx_a,
+											param<uint32_t> mesh_idx_b,
+											buffer<uint32_t> collision_flags) {
+	test_candidate_pairs<false>(candidates, candidate_counter, triangles_a, triangles_b, mesh_idx_a, mesh_idx_b,
+								collision_flags, nullptr, nullptr);
+}
+
+kernel void test_candidate_pairs_tri_vis(buffer<const uint2> candidates,
+										 buffer<const uint32_t> candidate_counter,
+										 buffer<const float3> triangles_a,
+										 buffer<const float3> triangles_b,
+										 param<uint32_t> mesh_idx_a,
+										 param<uint32_t> mesh_idx_b,
+										 buffer<uint32_t> collision_flags,
+										 buffer<uint32_t> colliding_triangles_a,
+										 buffer<uint32_t> colliding_triangles_b) {
+	test_candidate_pairs<true>(candidates, candidate_counter, triangles_a, triangles_b, mesh_idx_a, mesh_idx_b,
+							   collision_flags, colliding_triangles_a, colliding_triangles_b);
+}
+
+kernel void collide_bvhs_contacts(param<uint32_t> leaf_count_a,
+								  buffer<const float3> bvh_aabbs_leaves_a,
+								  buffer<const float3> triangles_a,
+								  buffer<const uint2> morton_codes_a,
+								  param<uint32_t> internal_node_count_b,
+								  buffer<const uint3> bvh_internal_b,
+								  buffer<const float3> bvh_aabbs_b,
+								  buffer<const float3> bvh_aabbs_leaves_b,
+								  buffer<const float3> triangles_b,
+								  buffer<const uint2> morton_codes_b,
+								  param<uint32_t> mesh_idx_a,
+								  param<uint32_t> mesh_idx_b,
+								  buffer<uint32_t> collision_flags,
+								  buffer<triangle_contact> contacts,
+								  buffer<uint32_t> contacts_counter,
+								  param<uint32_t> max_contacts,
+								  param<uint32_t> compute_contact_points) {
+	collide_bvhs<false, true, false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							  internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+							  mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr,
+							  contacts, contacts_counter, max_contacts, compute_contact_points, nullptr, nullptr);
+}
+
+kernel void collide_bvhs_contacts_tri_vis(param<uint32_t> leaf_count_a,
+										  buffer<const float3> bvh_aabbs_leaves_a,
+										  buffer<const float3> triangles_a,
+										  buffer<const uint2> morton_codes_a,
+										  param<uint32_t> internal_node_count_b,
+										  buffer<const uint3> bvh_internal_b,
+										  buffer<const float3> bvh_aabbs_b,
+										  buffer<const float3> bvh_aabbs_leaves_b,
+										  buffer<const float3> triangles_b,
+										  buffer<const uint2> morton_codes_b,
+										  param<uint32_t> mesh_idx_a,
+										  param<uint32_t> mesh_idx_b,
+										  buffer<uint32_t> collision_flags,
+										  buffer<uint32_t> colliding_triangles_a,
+										  buffer<uint32_t> colliding_triangles_b,
+										  buffer<triangle_contact> contacts,
+										  buffer<uint32_t> contacts_counter,
+										  param<uint32_t> max_contacts,
+										  param<uint32_t> compute_contact_points) {
+	collide_bvhs<true, true, false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							 internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+							 mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b,
+							 contacts, contacts_counter, max_contacts, compute_contact_points, nullptr, nullptr);
+}
+
+kernel void collide_bvhs_ccd_no_tri_vis(param<uint32_t> leaf_count_a,
+										buffer<const float3> bvh_aabbs_leaves_a,
+										buffer<const float3> triangles_a,
+										buffer<const float3> triangles_prev_a,
+										buffer<const uint2> morton_codes_a,
+										param<uint32_t> internal_node_count_b,
+										buffer<const uint3> bvh_internal_b,
+										buffer<const float3> bvh_aabbs_b,
+										buffer<const float3> bvh_aabbs_leaves_b,
+										buffer<const float3> triangles_b,
+										buffer<const float3> triangles_prev_b,
+										buffer<const uint2> morton_codes_b,
+										param<uint32_t> mesh_idx_a,
+										param<uint32_t> mesh_idx_b,
+										buffer<uint32_t> collision_flags) {
+	collide_bvhs<false, false, true>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+									 internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+									 mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr,
+									 nullptr, nullptr, 0u, 0u, triangles_prev_a, triangles_prev_b);
+}
+
+kernel void collide_bvhs_ccd_tri_vis(param<uint32_t> leaf_count_a,
+									 buffer<const float3> bvh_aabbs_leaves_a,
+									 buffer<const float3> triangles_a,
+									 buffer<const float3> triangles_prev_a,
+									 buffer<const uint2> morton_codes_a,
+									 param<uint32_t> internal_node_count_b,
+									 buffer<const uint3> bvh_internal_b,
+									 buffer<const float3> bvh_aabbs_b,
+									 buffer<const float3> bvh_aabbs_leaves_b,
+									 buffer<const float3> triangles_b,
+									 buffer<const float3> triangles_prev_b,
+									 buffer<const uint2> morton_codes_b,
+									 param<uint32_t> mesh_idx_a,
+									 param<uint32_t> mesh_idx_b,
+									 buffer<uint32_t> collision_flags,
+									 buffer<uint32_t> colliding_triangles_a,
+									 buffer<uint32_t> colliding_triangles_b) {
+	collide_bvhs<true, false, true>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+									internal_node_count_b, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+									mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b,
+									nullptr, nullptr, 0u, 0u, triangles_prev_a, triangles_prev_b);
+}
+
+// returns true if both triangles share a vertex, either by index or (for split vertices) by position
+static bool is_adjacent_triangle(const uint3& idx_a, const uint3& idx_b,
+								 const const_array<float3, 3>& v_a, const const_array<float3, 3>& v_b) {
+	const auto has_index = [&idx_a](const uint32_t& index) {
+		return (idx_a.x == index || idx_a.y == index || idx_a.z == index);
+	};
+	if(has_index(idx_b.x) || has_index(idx_b.y) || has_index(idx_b.z)) {
+		return true;
+	}
+	const auto has_vertex = [&v_a](const float3& vertex) {
+		return (v_a[0] == vertex || v_a[1] == vertex || v_a[2] == vertex);
+	};
+	return (has_vertex(v_b[0]) || has_vertex(v_b[1]) || has_vertex(v_b[2]));
+}
+
+// collides the leaves of a bvh with the bvh itself:
+// each leaf/triangle pair is only tested once (only leaves with a higher index are considered) and adjacent triangles
+// (sharing at least one vertex) are skipped, since these would always be reported as intersecting
+// self-intersections are flagged in "self_collision_flags" (also used as the abort condition), so that a mesh that
+// already collides with another mesh is still checked, and are also counted in "collision_flags"
+// swept: continuous collision detection (see collide_bvh_leaf)
+template <bool triangle_vis, bool swept>
+floor_inline_always static void collide_bvh_self(const uint32_t leaf_count,
+												 buffer<const uint3> bvh_internal,
+												 buffer<const float3> bvh_aabbs,
+												 buffer<const float3> bvh_aabbs_leaves,
+												 buffer<const float3> triangles,
+												 buffer<const uint3> indices,
+												 buffer<const uint2> morton_codes,
+												 const uint32_t mesh_idx,
+												 buffer<uint32_t> collision_flags,
+												 buffer<uint32_t> self_collision_flags,
+												 buffer<uint32_t> colliding_triangles,
+												 buffer<const float3> triangles_prev) {
+	const auto idx = global_id.x;
+	if(idx >= leaf_count) {
+		return;
+	}
+	
+	const float3 b_min = bvh_aabbs_leaves[idx * 2];
+	const float3 b_max = bvh_aabbs_leaves[idx * 2 + 1];
+	
+	traverse_bvh(b_min, b_max, bvh_internal, bvh_aabbs, bvh_aabbs_leaves,
+				 [&](const uint32_t& leaf_idx_b) {
+		// only test each pair once (this also excludes the leaf itself)
+		if(leaf_idx_b <= idx) {
+			return;
+		}
+		
+		const auto triangle_idx = morton_codes[idx].y;
+		const auto overlap_triangle_idx = morton_codes[leaf_idx_b].y;
+		const auto v = read_triangle(triangles, triangle_idx);
+		const auto ov = read_triangle(triangles, overlap_triangle_idx);
+		if(is_adjacent_triangle(indices[triangle_idx], indices[overlap_triangle_idx], v, ov)) {
+			return;
+		}
+		
+		bool is_intersecting = false;
+		if constexpr(!swept) {
+			is_intersecting = check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2]);
+		}
+		else {
+			is_intersecting = (check_swept_triangle_intersection(read_triangle(triangles_prev, triangle_idx), v,
+																 read_triangle(triangles_prev, overlap_triangle_idx), ov) <= 1.0f);
+		}
+		
+		if(is_intersecting) {
+			atomic_inc(&collision_flags[mesh_idx]);
+			atomic_inc(&self_collision_flags[mesh_idx]);
+			if constexpr(triangle_vis) {
+				atomic_inc(&colliding_triangles[triangle_idx]);
+				atomic_inc(&colliding_triangles[overlap_triangle_idx]);
+			}
+		}
+	}, [&]() {
+		if constexpr(!triangle_vis) {
+			// mesh is already known to self-collide
+			return (self_collision_flags[mesh_idx] > 0);
+		}
+		return false;
+	});
+}
+
+kernel void collide_bvh_self_no_tri_vis(param<uint32_t> leaf_count,
+										buffer<const uint3> bvh_internal,
+										buffer<const float3> bvh_aabbs,
+										buffer<const float3> bvh_aabbs_leaves,
+										buffer<const float3> triangles,
+										buffer<const uint3> indices,
+										buffer<const uint2> morton_codes,
+										param<uint32_t> mesh_idx,
+										buffer<uint32_t> collision_flags,
+										buffer<uint32_t> self_collision_flags) {
+	collide_bvh_self<false, false>(leaf_count, bvh_internal, bvh_aabbs, bvh_aabbs_leaves, triangles, indices, morton_codes,
+								   mesh_idx, collision_flags, self_collision_flags, nullptr, nullptr);
+}
+
+kernel void collide_bvh_self_tri_vis(param<uint32_t> leaf_count,
+									 buffer<const uint3> bvh_internal,
+									 buffer<const float3> bvh_aabbs,
+									 buffer<const float3> bvh_aabbs_leaves,
+									 buffer<const float3> triangles,
+									 buffer<const uint3> indices,
+									 buffer<const uint2> morton_codes,
+									 param<uint32_t> mesh_idx,
+									 buffer<uint32_t> collision_flags,
+									 buffer<uint32_t> self_collision_flags,
+									 buffer<uint32_t> colliding_triangles) {
+	collide_bvh_self<true, false>(leaf_count, bvh_internal, bvh_aabbs, bvh_aabbs_leaves, triangles, indices, morton_codes,
+								  mesh_idx, collision_flags, self_collision_flags, colliding_triangles, nullptr);
+}
+
+kernel void collide_bvh_self_ccd_no_tri_vis(param<uint32_t> leaf_count,
+											buffer<const uint3> bvh_internal,
+											buffer<const float3> bvh_aabbs,
+											buffer<const float3> bvh_aabbs_leaves,
+											buffer<const float3> triangles,
+											buffer<const float3> triangles_prev,
+											buffer<const uint3> indices,
+											buffer<const uint2> morton_codes,
+											param<uint32_t> mesh_idx,
+											buffer<uint32_t> collision_flags,
+											buffer<uint32_t> self_collision_flags) {
+	collide_bvh_self<false, true>(leaf_count, bvh_internal, bvh_aabbs, bvh_aabbs_leaves, triangles, indices, morton_codes,
+								  mesh_idx, collision_flags, self_collision_flags, nullptr, triangles_prev);
+}
+
+kernel void collide_bvh_self_ccd_tri_vis(param<uint32_t> leaf_count,
+										 buffer<const uint3> bvh_internal,
+										 buffer<const float3> bvh_aabbs,
+										 buffer<const float3> bvh_aabbs_leaves,
+										 buffer<const float3> triangles,
+										 buffer<const float3> triangles_prev,
+										 buffer<const uint3> indices,
+										 buffer<const uint2> morton_codes,
+										 param<uint32_t> mesh_idx,
+										 buffer<uint32_t> collision_flags,
+										 buffer<uint32_t> self_collision_flags,
+										 buffer<uint32_t> colliding_triangles) {
+	collide_bvh_self<true, true>(leaf_count, bvh_internal, bvh_aabbs, bvh_aabbs_leaves, triangles, indices, morton_codes,
+								 mesh_idx, collision_flags, self_collision_flags, colliding_triangles, triangles_prev);
+}
+
+kernel void collide_root_aabbs(buffer<const float3> aabbs,
+							   param<uint32_t> total_aabb_checks,
+							   param<uint32_t> mesh_count,
+							   buffer<uint32_t> aabb_collision_flags) {
+	const auto id = global_id.x;
+	if(id >= total_aabb_checks) return;
+	
+	// reverse cantor (map 1D linear index onto "half triangle" of a square -> all unique combinations of (i, j), with i != j)
+	const auto q = (uint32_t)fma(const_math::EPSILON<float> + sqrt(1.0f + 8.0f * float(id)), 0.5f, -0.5f);
+	const auto i = id - (q * (q + 1u)) / 2u;
 	const auto j = mesh_count - q + i - 1u;
 	
 	// get i and j aabb and check for overlap
@@ -623,6 +1616,1136 @@ kernel void map_collided_triangles(buffer<const uint32_t> colliding_triangles,
 	atomic_inc(&colliding_vertices[index.z]);
 }
 
+//////////////////////////////////////////
+// tandem traversal
+
+// reads the aabb of the specified node (leaf node if LEAF_MASK is set, internal node otherwise)
+static void read_node_aabb(const uint32_t& node,
+						   buffer<const float3> bvh_aabbs,
+						   buffer<const float3> bvh_aabbs_leaves,
+						   float3& b_min, float3& b_max) {
+	const auto masked_idx = node & LEAF_INV_MASK;
+	const bool is_leaf = (node != masked_idx);
+	b_min = (is_leaf ? bvh_aabbs_leaves[masked_idx * 2] : bvh_aabbs[masked_idx * 2]);
+	b_max = (is_leaf ? bvh_aabbs_leaves[masked_idx * 2 + 1] : bvh_aabbs[masked_idx * 2 + 1]);
+}
+
+// simultaneous traversal of bvh A and B, starting with the (root A, root B) pair:
+// * the first TANDEM_SEED_LEVELS levels are expanded breadth-first (expand_tandem_node_pairs, one launch per level),
+//   which provides enough (node A, node B) pairs to keep the device busy (each level at most doubles the pair count,
+//   so the node pair queues can never overflow)
+// * all remaining pairs are then traversed depth-first by collide_bvhs_tandem: each work-item pops pairs from this
+//   device-side work queue (atomic counter) until it is empty and traverses each one with a private stack
+// -> the host never has to read back any pair count
+// with the bvh depth being limited to 64 (see traverse_bvh), the combined depth-first descent of A and B can't be
+// deeper than 128 -> TANDEM_STACK_SIZE
+static_assert((1u << TANDEM_SEED_LEVELS) <= TANDEM_MAX_NODE_PAIRS, "tandem node pair queue is too small");
+
+// processes a single (node A, node B) pair whose aabbs are known to overlap: leaf/leaf pairs are tested for
+// intersection, otherwise the node with the larger aabb (or the only internal node) is split and "push_func(pair)"
+// is called for all child pairs that still overlap
+template <bool triangle_vis, typename push_func_type>
+floor_inline_always static void process_tandem_node_pair(const uint2& node_pair,
+														 buffer<const uint3> bvh_internal_a,
+														 buffer<const float3> bvh_aabbs_a,
+														 buffer<const float3> bvh_aabbs_leaves_a,
+														 buffer<const float3> triangles_a,
+														 buffer<const uint2> morton_codes_a,
+														 buffer<const uint3> bvh_internal_b,
+														 buffer<const float3> bvh_aabbs_b,
+														 buffer<const float3> bvh_aabbs_leaves_b,
+														 buffer<const float3> triangles_b,
+														 buffer<const uint2> morton_codes_b,
+														 const uint32_t mesh_idx_a,
+														 const uint32_t mesh_idx_b,
+														 buffer<uint32_t> collision_flags,
+														 buffer<uint32_t> colliding_triangles_a,
+														 buffer<uint32_t> colliding_triangles_b,
+														 push_func_type&& push_func) {
+	const bool is_leaf_a = ((node_pair.x & LEAF_MASK) != 0u);
+	const bool is_leaf_b = ((node_pair.y & LEAF_MASK) != 0u);
+	
+	// leaf/leaf: triangle test
+	if(is_leaf_a && is_leaf_b) {
+		const auto triangle_idx_a = morton_codes_a[node_pair.x & LEAF_INV_MASK].y;
+		const auto triangle_idx_b = morton_codes_b[node_pair.y & LEAF_INV_MASK].y;
+		const auto v = read_triangle(triangles_a, triangle_idx_a);
+		const auto ov = read_triangle(triangles_b, triangle_idx_b);
+		if(check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2])) {
+			atomic_inc(&collision_flags[mesh_idx_a]);
+			atomic_inc(&collision_flags[mesh_idx_b]);
+			if constexpr(triangle_vis) {
+				atomic_inc(&colliding_triangles_a[triangle_idx_a]);
+				atomic_inc(&colliding_triangles_b[triangle_idx_b]);
+			}
+		}
+		return;
+	}
+	
+	float3 b_min_a, b_max_a, b_min_b, b_max_b;
+	read_node_aabb(node_pair.x, bvh_aabbs_a, bvh_aabbs_leaves_a, b_min_a, b_max_a);
+	read_node_aabb(node_pair.y, bvh_aabbs_b, bvh_aabbs_leaves_b, b_min_b, b_max_b);
+	
+	// split the larger node (by half surface area) if both are internal nodes
+	bool split_a = !is_leaf_a;
+	if(!is_leaf_a && !is_leaf_b) {
+		const auto ext_a = b_max_a - b_min_a;
+		const auto ext_b = b_max_b - b_min_b;
+		split_a = ((ext_a.x * ext_a.y + ext_a.y * ext_a.z + ext_a.z * ext_a.x) >=
+				   (ext_b.x * ext_b.y + ext_b.y * ext_b.z + ext_b.z * ext_b.x));
+	}
+	
+	const auto children = (split_a ? bvh_internal_a[node_pair.x] : bvh_internal_b[node_pair.y]);
+#pragma unroll
+	for(uint32_t i = 0; i < 2; ++i) {
+		const auto child = (i == 0 ? children.x : children.y);
+		float3 child_min, child_max;
+		if(split_a) {
+			read_node_aabb(child, bvh_aabbs_a, bvh_aabbs_leaves_a, child_min, child_max);
+		}
+		else {
+			read_node_aabb(child, bvh_aabbs_b, bvh_aabbs_leaves_b, child_min, child_max);
+		}
+		
+		if(split_a ? check_overlap(child_min, child_max, b_min_b, b_max_b) :
+		   check_overlap(b_min_a, b_max_a, child_min, child_max)) {
+			push_func(split_a ? uint2 { child, node_pair.y } : uint2 { node_pair.x, child });
+		}
+	}
+}
+
+// breadth-first: expands one level of node pairs (each work-item loops over the input pairs)
+template <bool triangle_vis>
+floor_inline_always static void expand_tandem_node_pairs(buffer<const uint2> node_pairs_in,
+														 buffer<const uint32_t> node_pair_count_in,
+														 buffer<uint2> node_pairs_out,
+														 buffer<uint32_t> node_pair_count_out,
+														 buffer<const uint3> bvh_internal_a,
+														 buffer<const float3> bvh_aabbs_a,
+														 buffer<const float3> bvh_aabbs_leaves_a,
+														 buffer<const float3> triangles_a,
+														 buffer<const uint2> morton_codes_a,
+														 buffer<const uint3> bvh_internal_b,
+														 buffer<const float3> bvh_aabbs_b,
+														 buffer<const float3> bvh_aabbs_leaves_b,
+														 buffer<const float3> triangles_b,
+														 buffer<const uint2> morton_codes_b,
+														 const uint32_t mesh_idx_a,
+														 const uint32_t mesh_idx_b,
+														 buffer<uint32_t> collision_flags,
+														 buffer<uint32_t> colliding_triangles_a,
+														 buffer<uint32_t> colliding_triangles_b) {
+	const auto pair_count = node_pair_count_in[0];
+	for(uint32_t idx = global_id.x; idx < pair_count; idx += global_size.x) {
+		if constexpr(!triangle_vis) {
+			// no need to do further checking when a collision has been found already
+			if(collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0) {
+				return;
+			}
+		}
+		
+		process_tandem_node_pair<triangle_vis>(node_pairs_in[idx],
+											   bvh_internal_a, bvh_aabbs_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+											   bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+											   mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b,
+											   [&](const uint2& child_pair) {
+			node_pairs_out[atomic_inc(&node_pair_count_out[0])] = child_pair;
+		});
+	}
+}
+
+// depth-first: pops node pairs from the work queue and traverses everything below them
+template <bool triangle_vis>
+floor_inline_always static void collide_bvhs_tandem(buffer<const uint2> node_pairs,
+													buffer<const uint32_t> node_pair_count,
+													buffer<uint32_t> node_pair_queue_head,
+													buffer<const uint3> bvh_internal_a,
+													buffer<const float3> bvh_aabbs_a,
+													buffer<const float3> bvh_aabbs_leaves_a,
+													buffer<const float3> triangles_a,
+													buffer<const uint2> morton_codes_a,
+													buffer<const uint3> bvh_internal_b,
+													buffer<const float3> bvh_aabbs_b,
+													buffer<const float3> bvh_aabbs_leaves_b,
+													buffer<const float3> triangles_b,
+													buffer<const uint2> morton_codes_b,
+													const uint32_t mesh_idx_a,
+													const uint32_t mesh_idx_b,
+													buffer<uint32_t> collision_flags,
+													buffer<uint32_t> colliding_triangles_a,
+													buffer<uint32_t> colliding_triangles_b) {
+	const auto pair_count = node_pair_count[0];
+	uint2 stack[TANDEM_STACK_SIZE];
+	for(;;) {
+		const auto idx = atomic_inc(&node_pair_queue_head[0]);
+		if(idx >= pair_count) {
+			return;
+		}
+		
+		uint32_t stack_size = 0;
+		stack[stack_size++] = node_pairs[idx]; // push
+		while(stack_size > 0) {
+			if constexpr(!triangle_vis) {
+				// no need to do further checking when a collision has been found already
+				if(collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0) {
+					return;
+				}
+			}
+			
+			const auto node_pair = stack[--stack_size]; // pop
+			process_tandem_node_pair<triangle_vis>(node_pair,
+												   bvh_internal_a, bvh_aabbs_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+												   bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+												   mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b,
+												   [&](const uint2& child_pair) {
+				stack[stack_size++] = child_pair; // push
+			});
+		}
+	}
+}
+
+kernel void expand_tandem_node_pairs_no_tri_vis(buffer<const uint2> node_pairs_in,
+												buffer<const uint32_t> node_pair_count_in,
+												buffer<uint2> node_pairs_out,
+												buffer<uint32_t> node_pair_count_out,
+												buffer<const uint3> bvh_internal_a,
+												buffer<const float3> bvh_aabbs_a,
+												buffer<const float3> bvh_aabbs_leaves_a,
+												buffer<const float3> triangles_a,
+												buffer<const uint2> morton_codes_a,
+												buffer<const uint3> bvh_internal_b,
+												buffer<const float3> bvh_aabbs_b,
+												buffer<const float3> bvh_aabbs_leaves_b,
+												buffer<const float3> triangles_b,
+												buffer<const uint2> morton_codes_b,
+												param<uint32_t> mesh_idx_a,
+												param<uint32_t> mesh_idx_b,
+												buffer<uint32_t> collision_flags) {
+	expand_tandem_node_pairs<false>(node_pairs_in, node_pair_count_in, node_pairs_out, node_pair_count_out,
+									bvh_internal_a, bvh_aabbs_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+									bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+									mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr);
+}
+
+kernel void expand_tandem_node_pairs_tri_vis(buffer<const uint2> node_pairs_in,
+											 buffer<const uint32_t> node_pair_count_in,
+											 buffer<uint2> node_pairs_out,
+											 buffer<uint32_t> node_pair_count_out,
+											 buffer<const uint3> bvh_internal_a,
+											 buffer<const float3> bvh_aabbs_a,
+											 buffer<const float3> bvh_aabbs_leaves_a,
+											 buffer<const float3> triangles_a,
+											 buffer<const uint2> morton_codes_a,
+											 buffer<const uint3> bvh_internal_b,
+											 buffer<const float3> bvh_aabbs_b,
+											 buffer<const float3> bvh_aabbs_leaves_b,
+											 buffer<const float3> triangles_b,
+											 buffer<const uint2> morton_codes_b,
+											 param<uint32_t> mesh_idx_a,
+											 param<uint32_t> mesh_idx_b,
+											 buffer<uint32_t> collision_flags,
+											 buffer<uint32_t> colliding_triangles_a,
+											 buffer<uint32_t> colliding_triangles_b) {
+	expand_tandem_node_pairs<true>(node_pairs_in, node_pair_count_in, node_pairs_out, node_pair_count_out,
+								   bvh_internal_a, bvh_aabbs_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+								   bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+								   mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b);
+}
+
+kernel void collide_bvhs_tandem_no_tri_vis(buffer<const uint2> node_pairs,
+										   buffer<const uint32_t> node_pair_count,
+										   buffer<uint32_t> node_pair_queue_head,
+										   buffer<const uint3> bvh_internal_a,
+										   buffer<const float3> bvh_aabbs_a,
+										   buffer<const float3> bvh_aabbs_leaves_a,
+										   buffer<const float3> triangles_a,
+										   buffer<const uint2> morton_codes_a,
+										   buffer<const uint3> bvh_internal_b,
+										   buffer<const float3> bvh_aabbs_b,
+										   buffer<const float3> bvh_aabbs_leaves_b,
+										   buffer<const float3> triangles_b,
+										   buffer<const uint2> morton_codes_b,
+										   param<uint32_t> mesh_idx_a,
+										   param<uint32_t> mesh_idx_b,
+										   buffer<uint32_t> collision_flags) {
+	collide_bvhs_tandem<false>(node_pairs, node_pair_count, node_pair_queue_head,
+							   bvh_internal_a, bvh_aabbs_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							   bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+							   mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr);
+}
+
+kernel void collide_bvhs_tandem_tri_vis(buffer<const uint2> node_pairs,
+										buffer<const uint32_t> node_pair_count,
+										buffer<uint32_t> node_pair_queue_head,
+										buffer<const uint3> bvh_internal_a,
+										buffer<const float3> bvh_aabbs_a,
+										buffer<const float3> bvh_aabbs_leaves_a,
+										buffer<const float3> triangles_a,
+										buffer<const uint2> morton_codes_a,
+										buffer<const uint3> bvh_internal_b,
+										buffer<const float3> bvh_aabbs_b,
+										buffer<const float3> bvh_aabbs_leaves_b,
+										buffer<const float3> triangles_b,
+										buffer<const uint2> morton_codes_b,
+										param<uint32_t> mesh_idx_a,
+										param<uint32_t> mesh_idx_b,
+										buffer<uint32_t> collision_flags,
+										buffer<uint32_t> colliding_triangles_a,
+										buffer<uint32_t> colliding_triangles_b) {
+	collide_bvhs_tandem<true>(node_pairs, node_pair_count, node_pair_queue_head,
+							  bvh_internal_a, bvh_aabbs_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							  bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b, triangles_b, morton_codes_b,
+							  mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b);
+}
+
+//////////////////////////////////////////
+// compressed bvh
+
+// converts the bvh into compressed nodes, with internal nodes being stored in depth-first (pre-)order:
+// the depth-first index of a node is the index of its first leaf plus the amount of ancestors of which it is a
+// part of the left subtree. the left child is then stored right after its parent, the right child after all
+// internal nodes of the left subtree (#leaves - 1 of them).
+// NOTE: this relies on the karras layout, i.e. a left child covers [first leaf of parent, child index],
+//       a right child covers [child index, last leaf of parent]
+kernel void build_compressed_bvh(buffer<const uint3> bvh_internal,
+								 buffer<const float3> bvh_aabbs,
+								 buffer<const float3> bvh_aabbs_leaves,
+								 param<uint32_t> internal_node_count,
+								 buffer<compressed_bvh_node> compressed_nodes) {
+	const auto idx = global_id.x;
+	if(idx >= internal_node_count) {
+		return;
+	}
+	
+	// walk up to the root to compute the depth-first index of this node
+	uint32_t first_leaf = 0, left_ancestors = 0;
+	bool found_first_leaf = false;
+	for(uint32_t node = idx; node != 0;) {
+		const auto parent = bvh_internal[node].z;
+		if(bvh_internal[parent].x == node) {
+			++left_ancestors;
+		}
+		else if(!found_first_leaf) {
+			first_leaf = node;
+			found_first_leaf = true;
+		}
+		node = parent;
+	}
+	const auto dfs_idx = first_leaf + left_ancestors;
+	
+	const auto node = bvh_internal[idx];
+	compressed_bvh_node cnode;
+	cnode.origin = bvh_aabbs[idx * 2];
+	cnode.scale = (bvh_aabbs[idx * 2 + 1] - cnode.origin) * (1.0f / 65535.0f);
+	const auto inv_scale = float3 {
+		cnode.scale.x > 0.0f ? 1.0f / cnode.scale.x : 0.0f,
+		cnode.scale.y > 0.0f ? 1.0f / cnode.scale.y : 0.0f,
+		cnode.scale.z > 0.0f ? 1.0f / cnode.scale.z : 0.0f,
+	};
+	
+	const auto masked_left_idx = node.x & LEAF_INV_MASK;
+	cnode.children[0] = (masked_left_idx != node.x ? node.x : dfs_idx + 1u);
+	cnode.children[1] = ((node.y & LEAF_MASK) != 0u ? node.y : dfs_idx + (masked_left_idx - first_leaf + 1u));
+	
+#pragma unroll
+	for(uint32_t i = 0; i < 2; ++i) {
+		const auto child = (i == 0 ? node.x : node.y);
+		float3 child_min, child_max;
+		read_node_aabb(child, bvh_aabbs, bvh_aabbs_leaves, child_min, child_max);
+		
+		// conservative quantization: round min down and max up
+		const auto q_min = ((child_min - cnode.origin) * inv_scale).floored().clamped(0.0f, 65535.0f);
+		const auto q_max = ((child_max - cnode.origin) * inv_scale).ceiled().clamped(0.0f, 65535.0f);
+		cnode.child_bounds[i][0] = uint16_t(q_min.x);
+		cnode.child_bounds[i][1] = uint16_t(q_min.y);
+		cnode.child_bounds[i][2] = uint16_t(q_min.z);
+		cnode.child_bounds[i][3] = uint16_t(q_max.x);
+		cnode.child_bounds[i][4] = uint16_t(q_max.y);
+		cnode.child_bounds[i][5] = uint16_t(q_max.z);
+	}
+	cnode._unused[0] = 0u;
+	cnode._unused[1] = 0u;
+	compressed_nodes[dfs_idx] = cnode;
+}
+
+// same as collide_bvhs (w/o contacts and ccd), but traverses the compressed bvh B
+template <bool triangle_vis>
+floor_inline_always static void collide_bvhs_compressed(const uint32_t leaf_count_a,
+														buffer<const float3> bvh_aabbs_leaves_a,
+														buffer<const float3> triangles_a,
+														buffer<const uint2> morton_codes_a,
+														buffer<const compressed_bvh_node> compressed_nodes_b,
+														buffer<const float3> triangles_b,
+														buffer<const uint2> morton_codes_b,
+														const uint32_t mesh_idx_a,
+														const uint32_t mesh_idx_b,
+														buffer<uint32_t> collision_flags,
+														buffer<uint32_t> colliding_triangles_a,
+														buffer<uint32_t> colliding_triangles_b) {
+	const auto idx = global_id.x;
+	if(idx >= leaf_count_a) {
+		return;
+	}
+	
+	const float3 b_min = bvh_aabbs_leaves_a[idx * 2];
+	const float3 b_max = bvh_aabbs_leaves_a[idx * 2 + 1];
+	
+	uint32_t stack[BVH_MAX_DEPTH];
+	auto stack_ptr = stack;
+	*stack_ptr++ = 0; // push
+	
+	// traverse nodes starting from the root (root is always at index 0)
+	uint32_t node_idx = 0;
+	do {
+		if constexpr(!triangle_vis) {
+			if(collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0) break;
+		}
+		
+		// single node fetch
+		const compressed_bvh_node node = compressed_nodes_b[node_idx];
+		
+		bool traverse = false;
+#pragma unroll
+		for(uint32_t i = 0; i < 2; ++i) {
+			const auto child = node.children[i];
+			const auto masked_idx = child & LEAF_INV_MASK;
+			const bool is_leaf = (child != masked_idx);
+			
+			const auto child_min = node.origin + float3 {
+				float(node.child_bounds[i][0]), float(node.child_bounds[i][1]), float(node.child_bounds[i][2])
+			} * node.scale;
+			const auto child_max = node.origin + float3 {
+				float(node.child_bounds[i][3]), float(node.child_bounds[i][4]), float(node.child_bounds[i][5])
+			} * node.scale;
+			
+			if(check_overlap(b_min, b_max, child_min, child_max)) {
+				if(is_leaf) {
+					const auto overlap_triangle_idx = morton_codes_b[masked_idx].y;
+					const auto ov = read_triangle(triangles_b, overlap_triangle_idx);
+					const auto triangle_idx = morton_codes_a[idx].y;
+					const auto v = read_triangle(triangles_a, triangle_idx);
+					if(check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2])) {
+						atomic_inc(&collision_flags[mesh_idx_a]);
+						atomic_inc(&collision_flags[mesh_idx_b]);
+						if constexpr(triangle_vis) {
+							atomic_inc(&colliding_triangles_a[triangle_idx]);
+							atomic_inc(&colliding_triangles_b[overlap_triangle_idx]);
+						}
+					}
+				}
+				else {
+					if(i == 0 || !traverse) node_idx = child;
+					if(i == 1 && traverse) {
+						*stack_ptr++ = child; // push
+					}
+					traverse = true;
+				}
+			}
+		}
+		if(!traverse) {
+			node_idx = *--stack_ptr;
+		}
+	} while(node_idx != 0);
+}
+
+kernel void collide_bvhs_compressed_no_tri_vis(param<uint32_t> leaf_count_a,
+											   buffer<const float3> bvh_aabbs_leaves_a,
+											   buffer<const float3> triangles_a,
+											   buffer<const uint2> morton_codes_a,
+											   buffer<const compressed_bvh_node> compressed_nodes_b,
+											   buffer<const float3> triangles_b,
+											   buffer<const uint2> morton_codes_b,
+											   param<uint32_t> mesh_idx_a,
+											   param<uint32_t> mesh_idx_b,
+											   buffer<uint32_t> collision_flags) {
+	collide_bvhs_compressed<false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+								   compressed_nodes_b, triangles_b, morton_codes_b,
+								   mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr);
+}
+
+kernel void collide_bvhs_compressed_tri_vis(param<uint32_t> leaf_count_a,
+											buffer<const float3> bvh_aabbs_leaves_a,
+											buffer<const float3> triangles_a,
+											buffer<const uint2> morton_codes_a,
+											buffer<const compressed_bvh_node> compressed_nodes_b,
+											buffer<const float3> triangles_b,
+											buffer<const uint2> morton_codes_b,
+											param<uint32_t> mesh_idx_a,
+											param<uint32_t> mesh_idx_b,
+											buffer<uint32_t> collision_flags,
+											buffer<uint32_t> colliding_triangles_a,
+											buffer<uint32_t> colliding_triangles_b) {
+	collide_bvhs_compressed<true>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+								  compressed_nodes_b, triangles_b, morton_codes_b,
+								  mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b);
+}
+
+//////////////////////////////////////////
+// wide bvh
+
+// collapses the binary bvh into a WIDE_BVH_WIDTH-wide bvh: for each binary internal node, the internal child with the
+// largest surface area is repeatedly replaced by its two children, until the node is full or only leaves remain.
+// NOTE: every binary internal node gets its wide node (at the same index), so that this can be done fully in parallel,
+//       only wide nodes reachable from the root (index 0) are actually used though
+kernel void build_wide_bvh(buffer<const uint3> bvh_internal,
+						   buffer<const float3> bvh_aabbs,
+						   buffer<const float3> bvh_aabbs_leaves,
+						   param<uint32_t> internal_node_count,
+						   buffer<wide_bvh_node> wide_nodes) {
+	const auto idx = global_id.x;
+	if(idx >= internal_node_count) {
+		return;
+	}
+	
+	uint32_t children[WIDE_BVH_WIDTH];
+	const auto node = bvh_internal[idx];
+	children[0] = node.x;
+	children[1] = node.y;
+	uint32_t child_count = 2;
+	while(child_count < WIDE_BVH_WIDTH) {
+		uint32_t split_child = WIDE_BVH_WIDTH;
+		float max_area = -1.0f;
+		for(uint32_t i = 0; i < child_count; ++i) {
+			if((children[i] & LEAF_MASK) != 0u) continue;
+			float3 b_min, b_max;
+			read_node_aabb(children[i], bvh_aabbs, bvh_aabbs_leaves, b_min, b_max);
+			const auto ext = b_max - b_min;
+			const auto area = ext.x * ext.y + ext.y * ext.z + ext.z * ext.x;
+			if(area > max_area) {
+				max_area = area;
+				split_child = i;
+			}
+		}
+		if(split_child == WIDE_BVH_WIDTH) break; // only leaves
+		
+		const auto grandchildren = bvh_internal[children[split_child]];
+		children[split_child] = grandchildren.x;
+		children[child_count++] = grandchildren.y;
+	}
+	
+	wide_bvh_node wide_node;
+	for(uint32_t i = 0; i < WIDE_BVH_WIDTH; ++i) {
+		float3 b_min { __FLT_MAX__ }, b_max { -__FLT_MAX__ };
+		if(i < child_count) {
+			read_node_aabb(children[i], bvh_aabbs, bvh_aabbs_leaves, b_min, b_max);
+		}
+		wide_node.min_x[i] = b_min.x;
+		wide_node.min_y[i] = b_min.y;
+		wide_node.min_z[i] = b_min.z;
+		wide_node.max_x[i] = b_max.x;
+		wide_node.max_y[i] = b_max.y;
+		wide_node.max_z[i] = b_max.z;
+		wide_node.children[i] = (i < child_count ? children[i] : 0xFFFFFFFFu);
+	}
+	wide_nodes[idx] = wide_node;
+}
+
+// same as collide_bvhs (w/o contacts and ccd), but traverses the wide bvh B:
+// all children of a node are tested at once (the lane loop is vectorized on host-compute), resulting in a hit mask,
+// of which the set bits are then processed in order
+template <bool triangle_vis>
+floor_inline_always static void collide_bvhs_wide(const uint32_t leaf_count_a,
+												  buffer<const float3> bvh_aabbs_leaves_a,
+												  buffer<const float3> triangles_a,
+												  buffer<const uint2> morton_codes_a,
+												  buffer<const wide_bvh_node> wide_nodes_b,
+												  buffer<const float3> triangles_b,
+												  buffer<const uint2> morton_codes_b,
+												  const uint32_t mesh_idx_a,
+												  const uint32_t mesh_idx_b,
+												  buffer<uint32_t> collision_flags,
+												  buffer<uint32_t> colliding_triangles_a,
+												  buffer<uint32_t> colliding_triangles_b) {
+	const auto idx = global_id.x;
+	if(idx >= leaf_count_a) {
+		return;
+	}
+	
+	const float3 b_min = bvh_aabbs_leaves_a[idx * 2];
+	const float3 b_max = bvh_aabbs_leaves_a[idx * 2 + 1];
+	
+	uint32_t stack[WIDE_BVH_STACK_SIZE];
+	auto stack_ptr = stack;
+	*stack_ptr++ = 0; // push root
+	while(stack_ptr != stack) {
+		if constexpr(!triangle_vis) {
+			if(collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0) break;
+		}
+		
+		const auto& node = wide_nodes_b[*--stack_ptr]; // pop
+		// NOTE: the per-axis results are combined with "&" instead of "&&", so that there is no short-circuit
+		//       evaluation (-> no branches) and all lanes can be tested with vector compares
+		uint32_t hit_mask = 0u;
+#pragma unroll
+		for(uint32_t lane = 0; lane < WIDE_BVH_WIDTH; ++lane) {
+			const auto overlap = (uint32_t(node.min_x[lane] <= b_max.x) & uint32_t(node.max_x[lane] >= b_min.x) &
+								  uint32_t(node.min_y[lane] <= b_max.y) & uint32_t(node.max_y[lane] >= b_min.y) &
+								  uint32_t(node.min_z[lane] <= b_max.z) & uint32_t(node.max_z[lane] >= b_min.z));
+			hit_mask |= overlap << lane;
+		}
+		
+		while(hit_mask != 0u) {
+			const auto lane = math::ctz(hit_mask);
+			hit_mask &= hit_mask - 1u;
+			
+			const auto child = node.children[lane];
+			const auto masked_idx = child & LEAF_INV_MASK;
+			if(child == masked_idx) {
+				*stack_ptr++ = child; // push
+				continue;
+			}
+			
+			const auto overlap_triangle_idx = morton_codes_b[masked_idx].y;
+			const auto ov = read_triangle(triangles_b, overlap_triangle_idx);
+			const auto triangle_idx = morton_codes_a[idx].y;
+			const auto v = read_triangle(triangles_a, triangle_idx);
+			if(check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2])) {
+				atomic_inc(&collision_flags[mesh_idx_a]);
+				atomic_inc(&collision_flags[mesh_idx_b]);
+				if constexpr(triangle_vis) {
+					atomic_inc(&colliding_triangles_a[triangle_idx]);
+					atomic_inc(&colliding_triangles_b[overlap_triangle_idx]);
+				}
+			}
+		}
+	}
+}
+
+kernel void collide_bvhs_wide_no_tri_vis(param<uint32_t> leaf_count_a,
+										 buffer<const float3> bvh_aabbs_leaves_a,
+										 buffer<const float3> triangles_a,
+										 buffer<const uint2> morton_codes_a,
+										 buffer<const wide_bvh_node> wide_nodes_b,
+										 buffer<const float3> triangles_b,
+										 buffer<const uint2> morton_codes_b,
+										 param<uint32_t> mesh_idx_a,
+										 param<uint32_t> mesh_idx_b,
+										 buffer<uint32_t> collision_flags) {
+	collide_bvhs_wide<false>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							 wide_nodes_b, triangles_b, morton_codes_b,
+							 mesh_idx_a, mesh_idx_b, collision_flags, nullptr, nullptr);
+}
+
+kernel void collide_bvhs_wide_tri_vis(param<uint32_t> leaf_count_a,
+									  buffer<const float3> bvh_aabbs_leaves_a,
+									  buffer<const float3> triangles_a,
+									  buffer<const uint2> morton_codes_a,
+									  buffer<const wide_bvh_node> wide_nodes_b,
+									  buffer<const float3> triangles_b,
+									  buffer<const uint2> morton_codes_b,
+									  param<uint32_t> mesh_idx_a,
+									  param<uint32_t> mesh_idx_b,
+									  buffer<uint32_t> collision_flags,
+									  buffer<uint32_t> colliding_triangles_a,
+									  buffer<uint32_t> colliding_triangles_b) {
+	collide_bvhs_wide<true>(leaf_count_a, bvh_aabbs_leaves_a, triangles_a, morton_codes_a,
+							wide_nodes_b, triangles_b, morton_codes_b,
+							mesh_idx_a, mesh_idx_b, collision_flags, colliding_triangles_a, colliding_triangles_b);
+}
+
+//////////////////////////////////////////
+// sort-and-sweep broadphase
+
+// maps a float onto an uint, so that the uint order matches the float order
+static uint32_t float_to_sortable_uint(const float& val) {
+	union {
+		float f;
+		uint32_t u;
+	} conv { .f = val };
+	return ((conv.u & 0x80000000u) != 0u ? ~conv.u : (conv.u | 0x80000000u));
+}
+
+// computes the sort keys { sortable aabb min x, mesh index } for all root aabbs
+kernel void compute_sweep_keys(buffer<const float3> aabbs,
+							   param<uint32_t> mesh_count,
+							   param<uint32_t> key_count,
+							   buffer<uint2> sweep_keys) {
+	const auto id = global_id.x;
+	if(id >= key_count) return;
+	if(id >= mesh_count) {
+		// mark as unused (-> sorted to the end)
+		sweep_keys[id] = 0xFFFFFFFFu;
+		return;
+	}
+	sweep_keys[id] = { float_to_sortable_uint(aabbs[id * 2].x), id };
+}
+
+// sweeps along x over the root aabbs sorted by their min x: each mesh is only checked against subsequent meshes
+// until their min x is beyond its own max x, y/z overlap is then checked explicitly
+// NOTE: the pair counter keeps counting if there isn't enough space in "pairs" (-> re-run with a larger buffer)
+kernel void sweep_root_aabbs(buffer<const float3> aabbs,
+							 buffer<const uint2> sweep_keys,
+							 param<uint32_t> mesh_count,
+							 buffer<uint2> pairs,
+							 buffer<uint32_t> pair_counter,
+							 param<uint32_t> max_pairs) {
+	const auto id = global_id.x;
+	if(id >= mesh_count) return;
+	
+	const auto i = sweep_keys[id].y;
+	const auto b_min_i = aabbs[i * 2];
+	const auto b_max_i = aabbs[i * 2 + 1];
+	for(uint32_t k = id + 1u; k < mesh_count; ++k) {
+		const auto j = sweep_keys[k].y;
+		const auto b_min_j = aabbs[j * 2];
+		if(b_min_j.x > b_max_i.x) {
+			break;
+		}
+		if(check_overlap(b_min_i, b_max_i, b_min_j, aabbs[j * 2 + 1])) {
+			const auto pair_idx = atomic_inc(&pair_counter[0]);
+			if(pair_idx < max_pairs) {
+				pairs[pair_idx] = { min(i, j), max(i, j) };
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////
+// instancing
+
+// transforms a point with the specified (row-vector, i.e. translation in data[12..14]) matrix
+static float3 transform_point(const float3& point, const matrix4f& mat) {
+	return {
+		point.x * mat.data[0] + point.y * mat.data[4] + point.z * mat.data[8] + mat.data[12],
+		point.x * mat.data[1] + point.y * mat.data[5] + point.z * mat.data[9] + mat.data[13],
+		point.x * mat.data[2] + point.y * mat.data[6] + point.z * mat.data[10] + mat.data[14],
+	};
+}
+
+// transforms the aabb (b_min, b_max) with the specified matrix, resulting in the aabb enclosing the transformed box
+// (transforms the center and projects the extent onto the absolute matrix axes)
+static void transform_aabb(float3& b_min, float3& b_max, const matrix4f& mat) {
+	const auto center = transform_point((b_min + b_max) * 0.5f, mat);
+	const auto half_extent = (b_max - b_min) * 0.5f;
+	const float3 extent {
+		half_extent.x * abs(mat.data[0]) + half_extent.y * abs(mat.data[4]) + half_extent.z * abs(mat.data[8]),
+		half_extent.x * abs(mat.data[1]) + half_extent.y * abs(mat.data[5]) + half_extent.z * abs(mat.data[9]),
+		half_extent.x * abs(mat.data[2]) + half_extent.y * abs(mat.data[6]) + half_extent.z * abs(mat.data[10]),
+	};
+	b_min = center - extent;
+	b_max = center + extent;
+}
+
+// computes the world space root aabb of each instance from the local space root aabb of the instanced animation
+kernel void transform_root_aabbs(buffer<const float3> aabbs,
+								 buffer<const uint32_t> instance_animations,
+								 buffer<const matrix4f> instance_transforms,
+								 param<uint32_t> instance_count,
+								 buffer<float3> instance_aabbs) {
+	const auto idx = global_id.x;
+	if(idx >= instance_count) return;
+	
+	const auto anim_idx = instance_animations[idx];
+	float3 b_min = aabbs[anim_idx * 2];
+	float3 b_max = aabbs[anim_idx * 2 + 1];
+	transform_aabb(b_min, b_max, instance_transforms[idx]);
+	instance_aabbs[idx * 2] = b_min;
+	instance_aabbs[idx * 2 + 1] = b_max;
+}
+
+// collides the leaves of bvh A with bvh B, with both being rigidly transformed instances:
+// leaf aabbs and triangles of A are transformed into the local space of B, so that the bvh of each animation
+// only has to be built once (in its local space), regardless of how often it is instanced
+kernel void collide_bvhs_instanced(param<uint32_t> leaf_count_a,
+								   buffer<const float3> bvh_aabbs_leaves_a,
+								   buffer<const float3> triangles_a,
+								   buffer<const uint2> morton_codes_a,
+								   buffer<const uint3> bvh_internal_b,
+								   buffer<const float3> bvh_aabbs_b,
+								   buffer<const float3> bvh_aabbs_leaves_b,
+								   buffer<const float3> triangles_b,
+								   buffer<const uint2> morton_codes_b,
+								   // local -> world transforms of all instances, and the world -> local transforms
+								   buffer<const matrix4f> instance_transforms,
+								   buffer<const matrix4f> instance_inv_transforms,
+								   // instance indices of A and B
+								   param<uint32_t> instance_idx_a,
+								   param<uint32_t> instance_idx_b,
+								   // flags if resp. instance A/B collides with anything
+								   buffer<uint32_t> collision_flags) {
+	const auto idx = global_id.x;
+	if(idx >= leaf_count_a) {
+		return;
+	}
+	
+	// A local -> world -> B local
+	const auto a_to_b = instance_transforms[instance_idx_a] * instance_inv_transforms[instance_idx_b];
+	
+	float3 b_min = bvh_aabbs_leaves_a[idx * 2];
+	float3 b_max = bvh_aabbs_leaves_a[idx * 2 + 1];
+	transform_aabb(b_min, b_max, a_to_b);
+	
+	traverse_bvh(b_min, b_max, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b,
+				 [&](const uint32_t& leaf_idx_b) {
+		const auto ov = read_triangle(triangles_b, morton_codes_b[leaf_idx_b].y);
+		const auto v = read_triangle(triangles_a, morton_codes_a[idx].y);
+		if(check_triangle_intersection(transform_point(v[0], a_to_b),
+									   transform_point(v[1], a_to_b),
+									   transform_point(v[2], a_to_b),
+									   ov[0], ov[1], ov[2])) {
+			atomic_inc(&collision_flags[instance_idx_a]);
+			atomic_inc(&collision_flags[instance_idx_b]);
+		}
+	}, [&]() {
+		return (collision_flags[instance_idx_a] > 0 && collision_flags[instance_idx_b] > 0);
+	});
+}
+
+//////////////////////////////////////////
+// contact cache
+
+// gathers the triangles of mesh "mesh_idx" of all cached triangle pairs (2 triangles per cache entry, indexed like the
+// contact cache), so that the pairs of all cache slots can then be re-tested in a single launch
+kernel void gather_contact_cache_triangles(buffer<const uint2> contact_cache,
+										   buffer<const uint32_t> contact_cache_counts,
+										   buffer<const uint2> contact_cache_meshes,
+										   param<uint32_t> slot_count,
+										   param<uint32_t> mesh_idx,
+										   buffer<const float3> triangles,
+										   buffer<float3> contact_cache_triangles) {
+	const auto idx = global_id.x;
+	const auto cache_slot = idx / CONTACT_CACHE_SIZE;
+	if(cache_slot >= slot_count) return;
+	if(idx % CONTACT_CACHE_SIZE >= min(contact_cache_counts[cache_slot], CONTACT_CACHE_SIZE)) return;
+	
+	const auto meshes = contact_cache_meshes[cache_slot];
+	const auto tri_pair = contact_cache[idx];
+	if(meshes.x == mesh_idx) {
+		const auto v = read_triangle(triangles, tri_pair.x);
+		contact_cache_triangles[idx * 6u] = v[0];
+		contact_cache_triangles[idx * 6u + 1u] = v[1];
+		contact_cache_triangles[idx * 6u + 2u] = v[2];
+	}
+	if(meshes.y == mesh_idx) {
+		const auto ov = read_triangle(triangles, tri_pair.y);
+		contact_cache_triangles[idx * 6u + 3u] = ov[0];
+		contact_cache_triangles[idx * 6u + 4u] = ov[1];
+		contact_cache_triangles[idx * 6u + 5u] = ov[2];
+	}
+}
+
+// re-tests the triangle pairs of all cache slots that collided in the last frame (gathered with the triangles of this
+// frame by gather_contact_cache_triangles), flags both meshes and sets the cache hit flag of the slot if any pair
+// still collides
+kernel void retest_contact_cache(buffer<const uint32_t> contact_cache_counts,
+								 buffer<const uint2> contact_cache_meshes,
+								 buffer<const float3> contact_cache_triangles,
+								 param<uint32_t> slot_count,
+								 buffer<uint32_t> collision_flags,
+								 buffer<uint32_t> contact_cache_hits) {
+	const auto idx = global_id.x;
+	const auto cache_slot = idx / CONTACT_CACHE_SIZE;
+	if(cache_slot >= slot_count) return;
+	if(idx % CONTACT_CACHE_SIZE >= min(contact_cache_counts[cache_slot], CONTACT_CACHE_SIZE)) return;
+	
+	const auto tri_idx = idx * 6u;
+	if(check_triangle_intersection(contact_cache_triangles[tri_idx],
+								   contact_cache_triangles[tri_idx + 1u],
+								   contact_cache_triangles[tri_idx + 2u],
+								   contact_cache_triangles[tri_idx + 3u],
+								   contact_cache_triangles[tri_idx + 4u],
+								   contact_cache_triangles[tri_idx + 5u])) {
+		const auto meshes = contact_cache_meshes[cache_slot];
+		atomic_inc(&collision_flags[meshes.x]);
+		atomic_inc(&collision_flags[meshes.y]);
+		contact_cache_hits[cache_slot] = 1u;
+	}
+}
+
+// drops the cached pairs of all slots that no longer collide, their mesh pairs are then fully traversed again,
+// which records new pairs
+kernel void reset_contact_cache_misses(buffer<const uint32_t> contact_cache_hits,
+									   param<uint32_t> slot_count,
+									   buffer<uint32_t> contact_cache_counts) {
+	const auto cache_slot = global_id.x;
+	if(cache_slot >= slot_count) return;
+	if(contact_cache_hits[cache_slot] == 0u) {
+		contact_cache_counts[cache_slot] = 0u;
+	}
+}
+
+// same as collide_bvhs_no_tri_vis, but also records the colliding triangle pairs in the contact cache slot of this
+// mesh pair (up to CONTACT_CACHE_SIZE, the counter may be larger)
+// NOTE: due to the early abort, usually only a few pairs are recorded, but a single one suffices to resolve the next frame
+kernel void collide_bvhs_record_contact_cache(param<uint32_t> leaf_count_a,
+											  buffer<const float3> bvh_aabbs_leaves_a,
+											  buffer<const float3> triangles_a,
+											  buffer<const uint2> morton_codes_a,
+											  buffer<const uint3> bvh_internal_b,
+											  buffer<const float3> bvh_aabbs_b,
+											  buffer<const float3> bvh_aabbs_leaves_b,
+											  buffer<const float3> triangles_b,
+											  buffer<const uint2> morton_codes_b,
+											  param<uint32_t> mesh_idx_a,
+											  param<uint32_t> mesh_idx_b,
+											  buffer<uint32_t> collision_flags,
+											  buffer<uint2> contact_cache,
+											  buffer<uint32_t> contact_cache_counts,
+											  param<uint32_t> cache_slot) {
+	const auto idx = global_id.x;
+	if(idx >= leaf_count_a) {
+		return;
+	}
+	
+	const float3 b_min = bvh_aabbs_leaves_a[idx * 2];
+	const float3 b_max = bvh_aabbs_leaves_a[idx * 2 + 1];
+	traverse_bvh(b_min, b_max, bvh_internal_b, bvh_aabbs_b, bvh_aabbs_leaves_b,
+				 [&](const uint32_t& leaf_idx_b) {
+		const auto overlap_triangle_idx = morton_codes_b[leaf_idx_b].y;
+		const auto ov = read_triangle(triangles_b, overlap_triangle_idx);
+		const auto triangle_idx = morton_codes_a[idx].y;
+		const auto v = read_triangle(triangles_a, triangle_idx);
+		if(check_triangle_intersection(v[0], v[1], v[2], ov[0], ov[1], ov[2])) {
+			atomic_inc(&collision_flags[mesh_idx_a]);
+			atomic_inc(&collision_flags[mesh_idx_b]);
+			const auto cache_idx = atomic_inc(&contact_cache_counts[cache_slot]);
+			if(cache_idx < CONTACT_CACHE_SIZE) {
+				contact_cache[cache_slot * CONTACT_CACHE_SIZE + cache_idx] = uint2 { triangle_idx, overlap_triangle_idx };
+			}
+		}
+	}, [&]() {
+		return (collision_flags[mesh_idx_a] > 0 && collision_flags[mesh_idx_b] > 0);
+	});
+}
+
+//////////////////////////////////////////
+// ray + closest point queries
+
+// ray/triangle intersection (moeller/trumbore), returns the hit distance along the ray or a value < 0 if there is no hit
+static float intersect_ray_triangle(const float3& origin, const float3& direction, const const_array<float3, 3>& tri) {
+	const auto edge_1 = tri[1] - tri[0];
+	const auto edge_2 = tri[2] - tri[0];
+	const auto p = direction.cross(edge_2);
+	const auto det = edge_1.dot(p);
+	if(abs(det) < 1.0e-12f) return -1.0f; // parallel
+	
+	const auto inv_det = 1.0f / det;
+	const auto t_vec = origin - tri[0];
+	const auto u = t_vec.dot(p) * inv_det;
+	if(u < 0.0f || u > 1.0f) return -1.0f;
+	
+	const auto q = t_vec.cross(edge_1);
+	const auto v = direction.dot(q) * inv_det;
+	if(v < 0.0f || u + v > 1.0f) return -1.0f;
+	
+	return edge_2.dot(q) * inv_det;
+}
+
+// ray/aabb slab test, returns the entry distance along the ray or __FLT_MAX__ if the aabb isn't hit within [0, max_t]
+static float intersect_ray_aabb(const float3& origin, const float3& inv_direction,
+								const float3& b_min, const float3& b_max, const float& max_t) {
+	const auto t_0 = (b_min - origin) * inv_direction;
+	const auto t_1 = (b_max - origin) * inv_direction;
+	const auto t_near = t_0.minned(t_1);
+	const auto t_far = t_0.maxed(t_1);
+	const auto t_enter = max(max(t_near.x, t_near.y), max(t_near.z, 0.0f));
+	const auto t_exit = min(min(t_far.x, t_far.y), min(t_far.z, max_t));
+	return (t_enter <= t_exit ? t_enter : __FLT_MAX__);
+}
+
+// returns the point on the triangle that is closest to "point" (voronoi region based, see "real-time collision detection")
+static float3 closest_point_on_triangle(const float3& point, const const_array<float3, 3>& tri) {
+	const auto ab = tri[1] - tri[0];
+	const auto ac = tri[2] - tri[0];
+	const auto ap = point - tri[0];
+	const auto d1 = ab.dot(ap), d2 = ac.dot(ap);
+	if(d1 <= 0.0f && d2 <= 0.0f) return tri[0];
+	
+	const auto bp = point - tri[1];
+	const auto d3 = ab.dot(bp), d4 = ac.dot(bp);
+	if(d3 >= 0.0f && d4 <= d3) return tri[1];
+	
+	const auto vc = d1 * d4 - d3 * d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		return tri[0] + ab * (d1 / (d1 - d3));
+	}
+	
+	const auto cp = point - tri[2];
+	const auto d5 = ab.dot(cp), d6 = ac.dot(cp);
+	if(d6 >= 0.0f && d5 <= d6) return tri[2];
+	
+	const auto vb = d5 * d2 - d1 * d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		return tri[0] + ac * (d2 / (d2 - d6));
+	}
+	
+	const auto va = d3 * d6 - d5 * d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		return tri[1] + (tri[2] - tri[1]) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+	
+	const auto denom = 1.0f / (va + vb + vc);
+	return tri[0] + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// squared distance of a point to an aabb (0 if inside)
+static float aabb_distance_sq(const float3& point, const float3& b_min, const float3& b_max) {
+	const auto delta = b_min.maxed(point).minned(b_max) - point;
+	return delta.dot(delta);
+}
+
+// closest-first traversal of a bvh, starting at the root node:
+// * "node_dist_func(b_min, b_max)" returns the distance of the query to a node aabb (or __FLT_MAX__ if it can't be hit)
+// * "leaf_func(leaf_idx)" is called for each leaf that is closer than "best_dist" and must update "best_dist"
+// nodes that are further away than the current "best_dist" are skipped
+template <typename node_dist_func_type, typename leaf_func_type>
+floor_inline_always static void traverse_bvh_closest(buffer<const uint3> bvh_internal,
+													 buffer<const float3> bvh_aabbs,
+													 buffer<const float3> bvh_aabbs_leaves,
+													 float& best_dist,
+													 node_dist_func_type&& node_dist_func,
+													 leaf_func_type&& leaf_func) {
+	if(node_dist_func(bvh_aabbs[0], bvh_aabbs[1]) >= best_dist) return;
+	
+	uint32_t stack[BVH_MAX_DEPTH];
+	float stack_dist[BVH_MAX_DEPTH];
+	uint32_t stack_size = 0;
+	uint32_t node = 0;
+	for(;;) {
+		const auto children = bvh_internal[node];
+		uint32_t child_nodes[2] { children.x, children.y };
+		float child_dists[2];
+#pragma unroll
+		for(uint32_t i = 0; i < 2; ++i) {
+			const auto masked_idx = child_nodes[i] & LEAF_INV_MASK; // leaf node if highest bit set
+			const bool is_leaf = (child_nodes[i] != masked_idx);
+			const auto child_min = (is_leaf ? bvh_aabbs_leaves[masked_idx * 2] : bvh_aabbs[masked_idx * 2]);
+			const auto child_max = (is_leaf ? bvh_aabbs_leaves[masked_idx * 2 + 1] : bvh_aabbs[masked_idx * 2 + 1]);
+			child_dists[i] = node_dist_func(child_min, child_max);
+			if(is_leaf) {
+				if(child_dists[i] < best_dist) {
+					leaf_func(masked_idx);
+				}
+				child_dists[i] = __FLT_MAX__; // done with this one
+			}
+		}
+		
+		// visit the closer child first, push the other one
+		if(child_dists[1] < child_dists[0]) {
+			const auto tmp_dist = child_dists[0];
+			child_dists[0] = child_dists[1];
+			child_dists[1] = tmp_dist;
+			const auto tmp_node = child_nodes[0];
+			child_nodes[0] = child_nodes[1];
+			child_nodes[1] = tmp_node;
+		}
+		if(child_dists[0] < best_dist) {
+			if(child_dists[1] < best_dist) {
+				stack[stack_size] = child_nodes[1]; // push
+				stack_dist[stack_size] = child_dists[1];
+				++stack_size;
+			}
+			node = child_nodes[0];
+			continue;
+		}
+		
+		// pop the next node that may still contain something closer
+		bool found = false;
+		while(stack_size > 0) {
+			--stack_size;
+			if(stack_dist[stack_size] < best_dist) {
+				node = stack[stack_size];
+				found = true;
+				break;
+			}
+		}
+		if(!found) break;
+	}
+}
+
+// casts all rays against the bvh of a single mesh, the closest hit over all meshes is kept in "hits"
+// (first_mesh: initializes the hits from the rays, otherwise hits of previously queried meshes are only replaced
+//  if this mesh has a closer hit)
+kernel void query_rays(buffer<const query_ray> rays,
+					   param<uint32_t> ray_count,
+					   param<uint32_t> mesh_idx,
+					   param<uint32_t> first_mesh,
+					   buffer<const uint3> bvh_internal,
+					   buffer<const float3> bvh_aabbs,
+					   buffer<const float3> bvh_aabbs_leaves,
+					   buffer<const float3> triangles,
+					   buffer<const uint2> morton_codes,
+					   buffer<query_hit> hits) {
+	const auto idx = global_id.x;
+	if(idx >= ray_count) return;
+	
+	const auto ray = rays[idx];
+	query_hit hit;
+	if(first_mesh != 0u) {
+		hit = { ray.max_distance, ~0u, ~0u };
+	}
+	else {
+		hit = hits[idx];
+	}
+	
+	const float3 inv_direction {
+		1.0f / ray.direction.x,
+		1.0f / ray.direction.y,
+		1.0f / ray.direction.z,
+	};
+	float best_dist = hit.distance;
+	traverse_bvh_closest(bvh_internal, bvh_aabbs, bvh_aabbs_leaves, best_dist,
+						 [&](const float3& b_min, const float3& b_max) {
+		return intersect_ray_aabb(ray.origin, inv_direction, b_min, b_max, best_dist);
+	}, [&](const uint32_t& leaf_idx) {
+		const auto tri_id = morton_codes[leaf_idx].y;
+		const auto t = intersect_ray_triangle(ray.origin, ray.direction, read_triangle(triangles, tri_id));
+		if(t >= 0.0f && t < best_dist) {
+			best_dist = t;
+			hit.triangle = tri_id;
+			hit.mesh = mesh_idx;
+		}
+	});
+	hit.distance = best_dist;
+	hits[idx] = hit;
+}
+
+// finds the closest triangle to each point in the bvh of a single mesh, the closest triangle over all meshes is kept
+// in "hits" (first_mesh: see query_rays)
+kernel void query_closest_points(buffer<const query_point> points,
+								 param<uint32_t> point_count,
+								 param<uint32_t> mesh_idx,
+								 param<uint32_t> first_mesh,
+								 buffer<const uint3> bvh_internal,
+								 buffer<const float3> bvh_aabbs,
+								 buffer<const float3> bvh_aabbs_leaves,
+								 buffer<const float3> triangles,
+								 buffer<const uint2> morton_codes,
+								 buffer<query_hit> hits) {
+	const auto idx = global_id.x;
+	if(idx >= point_count) return;
+	
+	const auto point = points[idx];
+	query_hit hit;
+	if(first_mesh != 0u) {
+		hit = { point.max_distance, ~0u, ~0u };
+	}
+	else {
+		hit = hits[idx];
+	}
+	
+	// traverse with squared distances
+	float best_dist_sq = hit.distance * hit.distance;
+	traverse_bvh_closest(bvh_internal, bvh_aabbs, bvh_aabbs_leaves, best_dist_sq,
+						 [&](const float3& b_min, const float3& b_max) {
+		return aabb_distance_sq(point.position, b_min, b_max);
+	}, [&](const uint32_t& leaf_idx) {
+		const auto tri_id = morton_codes[leaf_idx].y;
+		const auto closest_point = closest_point_on_triangle(point.position, read_triangle(triangles, tri_id));
+		const auto delta = closest_point - point.position;
+		const auto dist_sq = delta.dot(delta);
+		if(dist_sq < best_dist_sq) {
+			best_dist_sq = dist_sq;
+			hit.triangle = tri_id;
+			hit.mesh = mesh_idx;
+		}
+	});
+	if(hit.mesh == mesh_idx) {
+		hit.distance = sqrt(best_dist_sq);
+	}
+	hits[idx] = hit;
+}
+
 //////////////////////////////////////////
 // radix sort
 
@@ -46,6 +46,9 @@ vertex auto hlbvh_vertex(buffer<const float3> in_position_a,
 						 param<float> delta
 #if COLLIDING_TRIANGLES_VIS
 						 , buffer<const uint32_t> is_collision
+#elif DEVICE_COLLISION_FLAGS
+						 // collision flag of this instance (buffer is offset accordingly)
+						 , buffer<const uint32_t> model_collision
 #endif
 						 ) {
 	scene_in_out out;
@@ -62,6 +65,11 @@ vertex auto hlbvh_vertex(buffer<const float3> in_position_a,
 	else {
 		out.color = uniforms.default_color;
 		out.normal = { in_normal_a[vertex_id].interpolated(in_normal_b[vertex_id], delta) };
+#if DEVICE_COLLISION_FLAGS
+		if(model_collision[0] > 0u) {
+			out.color = { 1.0f, 0.0f, 0.0f, 1.0f };
+		}
+#endif
 	}
 	
 #if COLLIDING_TRIANGLES_VIS
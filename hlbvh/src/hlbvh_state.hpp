@@ -25,6 +25,71 @@
 #define PREFIX_SUM_GROUP_SIZE 256u
 #define ROOT_AABB_GROUP_SIZE 256u
 
+// meshes with at least this many triangles use 63-bit morton codes (21 bits per axis) instead of 30-bit ones
+// (when set to auto), since a 1024^3 grid leads to too many identical codes at this point
+#define WIDE_MORTON_CODE_TRIANGLE_THRESHOLD (1u << 17u)
+
+// with an auto broadphase, mesh counts >= this use sort-and-sweep instead of checking all mesh pairs
+#define SWEEP_BROADPHASE_MESH_THRESHOLD 256u
+
+// child count of wide bvh nodes (4 or 8), should match the simd width (in floats) of the host cpu
+#if !defined(WIDE_BVH_WIDTH)
+#define WIDE_BVH_WIDTH 4u
+#endif
+
+// max depth of the binary bvh: each level of the radix tree build extends the common prefix of its leaves by at least
+// one bit, so the depth is bounded by the morton code bits (at most 63) + 32 triangle index bits (identical codes)
+// NOTE: this is the stack size of the binary traversals
+#define BVH_MAX_DEPTH 96u
+// stack size of the wide bvh traversal: the collapse doesn't guarantee any depth reduction, so a wide node may be as
+// deep as its binary node, with each wide node on the path leaving up to WIDE_BVH_WIDTH - 1 siblings on the stack
+// (+ the children of the deepest node)
+#define WIDE_BVH_STACK_SIZE ((WIDE_BVH_WIDTH - 1u) * BVH_MAX_DEPTH + 1u)
+
+// amount of levels of the tandem traversal that are expanded breadth-first, before all resulting (node A, node B)
+// pairs are traversed depth-first (one pair per work-item at a time)
+#define TANDEM_SEED_LEVELS 14u
+// max amount of (node A, node B) pairs per breadth-first level of the tandem traversal
+#define TANDEM_MAX_NODE_PAIRS (1u << TANDEM_SEED_LEVELS)
+// max amount of (persistent) work-items used for each launch of the tandem traversal
+#define TANDEM_MAX_THREADS (COMPACTION_GROUP_COUNT * COMPACTION_GROUP_SIZE)
+// per work-item stack size of the depth-first tandem traversal
+#define TANDEM_STACK_SIZE 128u
+
+// ccd: amount of bisection steps when solving for the time of impact
+#define CCD_ROOT_ITERATIONS 24u
+// ccd: relative tolerance when checking if two features touch at a potential time of impact
+#define CCD_TOLERANCE 0.0001f
+
+// persistent threads: amount of leaves that are grabbed at once by each work-item
+#define PERSISTENT_LEAF_BATCH_SIZE 4u
+// persistent threads: amount of work-groups that are launched per compute unit
+#define PERSISTENT_GROUPS_PER_UNIT 4u
+
+// batched narrowphase: max amount of candidate triangle pairs per mesh pair (more are tested directly during traversal)
+#define NARROWPHASE_MAX_CANDIDATES (1u << 20u)
+// batched narrowphase: amount of candidate pairs that are tested at once by each work-item
+#define NARROWPHASE_BATCH_WIDTH 4u
+// batched narrowphase: w/o triangle visualization, the leaves of A are collected + tested in chunks of this size, so
+// that the collection of later chunks can stop early once both meshes are known to collide
+#define NARROWPHASE_COLLECT_CHUNK_SIZE (1u << 14u)
+
+// contact cache: max amount of colliding triangle pairs that are cached per mesh pair
+#define CONTACT_CACHE_SIZE 64u
+// contact cache: max amount of mesh pairs that can be cached
+#define CONTACT_CACHE_MAX_PAIRS 4096u
+// contact cache: all mesh pairs are fully traversed again (and their cache refreshed) every N frames
+#define CONTACT_CACHE_REFRESH_INTERVAL 16u
+
+// max amount of parsed key-frames that may be waiting for their upload at any time
+#define KEYFRAME_UPLOAD_QUEUE_SIZE 4u
+
+// amount of key-frames after the next frame that are kept resident when streaming key-frames
+#define KEYFRAME_STREAM_PREFETCH 2u
+// amount of key-frames that are needed by each step when streaming key-frames (previous step: cur + next,
+// this step: cur + next, + prefetched ones)
+#define KEYFRAME_STREAM_NEEDED_FRAMES (4u + KEYFRAME_STREAM_PREFETCH)
+
 #include <floor/math/quaternion.hpp>
 #if !defined(FLOOR_COMPUTE) || defined(FLOOR_COMPUTE_HOST)
 #include <floor/compute/compute_context.hpp>
@@ -32,6 +97,71 @@
 #include <floor/compute/compute_queue.hpp>
 #endif
 
+// a pair of intersecting triangles (output of the collide_bvhs_contacts* kernels)
+struct triangle_contact {
+	uint32_t mesh_a;
+	uint32_t triangle_a;
+	uint32_t mesh_b;
+	uint32_t triangle_b;
+	// intersection segment of both triangles (only computed if contact points are enabled, zero otherwise)
+	float3 point_0;
+	float3 point_1;
+};
+
+// ray query input (-> collider::query_rays)
+struct query_ray {
+	float3 origin;
+	// only hits in [0, max_distance] are reported
+	float max_distance;
+	// doesn't need to be normalized (hit distances are then in multiples of the direction length)
+	float3 direction;
+	uint32_t _unused;
+};
+
+// closest point query input (-> collider::query_closest_points)
+struct query_point {
+	float3 position;
+	// only triangles within this distance are considered
+	float max_distance;
+};
+
+// result of a ray or closest point query
+struct query_hit {
+	// distance to the closest hit (max_distance of the query if nothing was hit)
+	float distance;
+	// triangle index (within its mesh) and mesh index of the closest hit, both 0xFFFFFFFF if nothing was hit
+	uint32_t triangle;
+	uint32_t mesh;
+};
+
+// compressed bvh node (64 bytes): stores the aabbs of both children quantized to 16-bit relative to the node aabb,
+// so that traversal only needs a single node fetch per step (internal nodes are stored in depth-first order)
+struct compressed_bvh_node {
+	// node aabb min
+	float3 origin;
+	// node aabb extent / 65535
+	float3 scale;
+	// child indices: compressed node index for internal nodes, LEAF_FLAG(leaf index) for leaves
+	uint32_t children[2];
+	// quantized { min.xyz, max.xyz } of the left and right child
+	uint16_t child_bounds[2][6];
+	uint32_t _unused[2];
+};
+static_assert(sizeof(compressed_bvh_node) == 64, "invalid compressed bvh node size");
+
+// wide bvh node: up to WIDE_BVH_WIDTH children, with the child aabbs being stored as SoA, so that all children can
+// be tested with a single vector compare
+struct wide_bvh_node {
+	float min_x[WIDE_BVH_WIDTH];
+	float min_y[WIDE_BVH_WIDTH];
+	float min_z[WIDE_BVH_WIDTH];
+	float max_x[WIDE_BVH_WIDTH];
+	float max_y[WIDE_BVH_WIDTH];
+	float max_z[WIDE_BVH_WIDTH];
+	// child indices: wide node index for internal nodes, LEAF_FLAG(leaf index) for leaves, 0xFFFFFFFF if unused
+	uint32_t children[WIDE_BVH_WIDTH];
+};
+
 struct hlbvh_state_struct {
 	bool cam_mode { true }; // false: rotate around origin, true: free cam
 	quaternionf cam_rotation;
@@ -56,7 +186,93 @@ struct hlbvh_state_struct {
 	// if false: draw collided models red (fast-ish, not as fast as console/benchmark-only mode)
 	bool triangle_vis { true };
 	
+	// root aabb broadphase: 0 = auto (based on mesh count), 1 = always check all pairs, 2 = always use sort-and-sweep
+	uint32_t broadphase { 0 };
+	
+	// morton code width: 0 = auto (based on triangle count), 30 or 63 = always use 30-bit or 63-bit codes
+	uint32_t morton_code_bits { 0 };
+	
+	// if true: all intersecting triangle pairs are appended to a bounded contacts buffer (-> collider::read_contacts)
+	// NOTE: this disables the early abort once two models are known to collide
+	bool contacts { false };
+	// if true: also compute the intersection segment of each triangle pair
+	bool contact_points { false };
+	// max amount of contacts that can be stored per frame
+	uint32_t max_contacts { 65536 };
+	
+	// if true: a compressed copy of each bvh (see compressed_bvh_node) is built and used for the per-leaf traversal
+	// NOTE: not used with ccd or contacts
+	// NOTE: tandem, compressed_bvh, wide_bvh, persistent and batched_narrowphase are mutually exclusive
+	bool compressed_bvh { false };
+	
+	// if true: a wide bvh (see wide_bvh_node) is built from each binary bvh and used for the per-leaf traversal
+	// NOTE: mostly intended for host-compute, not used with ccd or contacts
+	bool wide_bvh { false };
+	
+	// if true: bvh pairs are collided via a simultaneous (tandem) traversal of both bvhs, instead of traversing
+	//          bvh B once for every leaf of bvh A
+	// NOTE: not used with ccd or contacts
+	bool tandem { false };
+	
+	// if true: the per-leaf traversal uses persistent threads, i.e. a fixed amount of work-items that dynamically
+	//          grab batches of leaves from a global counter (better load balancing with uneven traversal costs)
+	// NOTE: not used with ccd, contacts, compressed and wide bvhs
+	bool persistent { false };
+	
+	// if true: the per-leaf traversal only collects candidate triangle pairs, which are then tested in a separate pass
+	//          in batches of NARROWPHASE_BATCH_WIDTH pairs with a branch-free triangle/triangle test
+	// NOTE: not used with ccd, contacts, compressed and wide bvhs
+	bool batched_narrowphase { false };
+	
+	// if true: continuous collision detection, i.e. collisions are checked over the whole motion from the previous to
+	//          the current animation step (swept aabbs + exact time of impact of the vertex/face and edge/edge
+	//          coplanarity cubics, see check_swept_triangle_intersection), so that fast moving or thin geometry
+	//          doesn't tunnel through other models in between two steps
+	bool ccd { false };
+	
+	// if true: also check each model for self-intersections (adjacent triangles are ignored)
+	bool self_collision { false };
+	
+	// if true: the colliding triangle pairs of each mesh pair are cached and re-tested first in the next frame,
+	//          mesh pairs that still collide then need neither a bvh (build) nor a full traversal
+	// NOTE: only used with per-model visualization and w/o contacts, ccd and instancing
+	bool contact_cache { false };
+	
+	// if > 0: each model is instanced this many times (with different rigid transforms), all instances of a model share
+	//         the same bvh and are collided in each other's local space
+	// NOTE: not supported with triangle_vis, contacts, ccd and self-collision
+	uint32_t instance_count { 0 };
+	
+	// if true: only a small window of key-frames (previous, current, next + KEYFRAME_STREAM_PREFETCH) is resident on
+	//          the device, all other key-frames are streamed in from the memory-mapped key-frame cache on demand
+	// NOTE: only supported in benchmark mode (obj render models are not streamed)
+	bool stream_keyframes { false };
+	
+	// if true: collision flags stay on the device and are consumed directly by the renderers (shared opengl buffer or
+	//          metal buffer), the host flags returned by collide() are read back with a one-frame delay
+	bool device_collision_flags { false };
+	// if false: the host flags are not read back at all with device collision flags
+	bool collision_flags_readback { true };
+	
+	// if true: records the time of each collision stage (see collision_stats), which are logged at exit
+	// NOTE: this fences every stage with a queue finish()
+	bool stats { false };
+	
 #if !defined(FLOOR_COMPUTE) || defined(FLOOR_COMPUTE_HOST)
+	// if non-empty: per-frame collision stage times are also written to this .csv file at exit
+	string stats_csv_file_name;
+	
+	// if non-empty: the scene (assets, instancing and placement) is loaded from this file instead of using the
+	// built-in scene (see load_scene in main.cpp for the format)
+	string scene_file_name;
+	
+	// headless sweep benchmark: if non-empty, the scene is collided for "sweep_frames" frames with each combination
+	// of instance count (per asset) and total triangle budget (0 = unlimited), results are written to a .json file
+	vector<uint32_t> sweep_instance_counts;
+	vector<uint32_t> sweep_triangle_budgets { 0u };
+	uint32_t sweep_frames { 200 };
+	string sweep_json_file_name { "hlbvh_sweep.json" };
+	
 	// main compute context
 	shared_ptr<compute_context> ctx;
 	// active compute device
@@ -25,6 +25,9 @@
 #include "animation.hpp"
 #include "collider.hpp"
 #include "camera.hpp"
+#include <floor/core/file_io.hpp>
+#include <random>
+#include <sstream>
 
 hlbvh_state_struct hlbvh_state;
 
@@ -39,6 +42,324 @@ static unique_ptr<camera> cam;
 // camera speeds (modified by shift/ctrl)
 static const float3 cam_speeds { 25.0f /* default */, 150.0f /* faster */, 2.5f /* slower */ };
 
+// scene description: animated assets + how they are instanced and placed
+enum class INSTANCE_PLACEMENT : uint32_t {
+	// instances of each asset are spread out along x, with each instance being rotated a bit further
+	LINE,
+	// all instances are placed on a square grid (interleaved by asset), with a spacing of 1 / sqrt(density)
+	GRID,
+	// all instances are placed uniformly at random (and randomly rotated) in a square with area count / density
+	RANDOM,
+};
+struct scene_asset {
+	string file_prefix;
+	uint32_t frame_count;
+	bool loop_or_reset;
+	float step_size;
+	// animation phase offset as a fraction of the animation cycle, in [0, 1)
+	// NOTE: all instances of an asset share its bvh, so the phase can only be offset per asset
+	float phase;
+};
+struct scene_description {
+	vector<scene_asset> assets;
+	// instances per asset (0 = no instancing)
+	uint32_t instance_count { 0 };
+	INSTANCE_PLACEMENT placement { INSTANCE_PLACEMENT::LINE };
+	// instances per unit area (grid and random placement)
+	float density { 0.25f };
+	// random placement seed
+	uint32_t seed { 1 };
+};
+static scene_description scene {
+	{
+		{ "collision_models/gear/gear_0000", 20, false, 0.1f, 0.0f },
+		{ "collision_models/gear2/gear2_0000", 20, false, 0.1f, 0.0f },
+		{ "collision_models/sinbad/sinbad_0000", 20, true, 0.025f, 0.0f },
+		{ "collision_models/golem/golem_0000", 20, false, 0.125f, 0.0f },
+		{ "collision_models/plane/plane_00000", 2, false, 0.025f, 0.0f },
+	},
+};
+
+//! loads a scene description file, each line is one of:
+//!  asset <file prefix> <frame count (>= 2)> [loop|reset] [step size (> 0)] [phase (in [0, 1))]
+//!  instances <count per asset>
+//!  placement <line|grid|random>
+//!  density <instances per unit area>
+//!  seed <random seed>
+//! empty lines and lines starting with '#' are ignored, if the file contains any assets, these replace the built-in ones
+static bool load_scene(const string& file_name) {
+	string scene_data;
+	if(!file_io::file_to_string(file_name, scene_data)) {
+		log_error("failed to read scene file %s", file_name);
+		return false;
+	}
+	
+	vector<scene_asset> assets;
+	stringstream lines(scene_data);
+	string line;
+	for(uint32_t line_num = 1; getline(lines, line); ++line_num) {
+		stringstream tokens(line);
+		string key;
+		if(!(tokens >> key) || key[0] == '#') continue;
+		
+		if(key == "asset") {
+			scene_asset asset { "", 0, false, 0.025f, 0.0f };
+			string mode;
+			int64_t frame_count = 0;
+			if(!(tokens >> asset.file_prefix >> frame_count)) {
+				log_error("%s:%u: invalid asset (expected: asset <file prefix> <frame count> [loop|reset] [step size] [phase])",
+						  file_name, line_num);
+				return false;
+			}
+			// need at least two key-frames to interpolate between
+			if(frame_count < 2 || frame_count > int64_t(~0u)) {
+				log_error("%s:%u: asset frame count must be >= 2", file_name, line_num);
+				return false;
+			}
+			asset.frame_count = uint32_t(frame_count);
+			if(tokens >> mode) {
+				if(mode != "loop" && mode != "reset") {
+					log_error("%s:%u: invalid asset mode \"%s\" (expected loop or reset)", file_name, line_num, mode);
+					return false;
+				}
+				asset.loop_or_reset = (mode == "reset");
+			}
+			if(!(tokens >> ws).eof() && (!(tokens >> asset.step_size) || asset.step_size <= 0.0f)) {
+				log_error("%s:%u: asset step size must be > 0", file_name, line_num);
+				return false;
+			}
+			if(!(tokens >> ws).eof() && (!(tokens >> asset.phase) || asset.phase < 0.0f || asset.phase >= 1.0f)) {
+				log_error("%s:%u: asset phase must be in [0, 1)", file_name, line_num);
+				return false;
+			}
+			assets.emplace_back(asset);
+		}
+		else if(key == "instances") {
+			int64_t instance_count = 0;
+			if(!(tokens >> instance_count) || instance_count <= 0 || instance_count > int64_t(~0u)) {
+				log_error("%s:%u: instance count must be > 0", file_name, line_num);
+				return false;
+			}
+			scene.instance_count = uint32_t(instance_count);
+		}
+		else if(key == "placement") {
+			string placement;
+			tokens >> placement;
+			if(placement == "line") scene.placement = INSTANCE_PLACEMENT::LINE;
+			else if(placement == "grid") scene.placement = INSTANCE_PLACEMENT::GRID;
+			else if(placement == "random") scene.placement = INSTANCE_PLACEMENT::RANDOM;
+			else {
+				log_error("%s:%u: invalid placement \"%s\" (expected line, grid or random)", file_name, line_num, placement);
+				return false;
+			}
+		}
+		else if(key == "density") {
+			if(!(tokens >> scene.density) || scene.density <= 0.0f) {
+				log_error("%s:%u: density must be > 0", file_name, line_num);
+				return false;
+			}
+		}
+		else if(key == "seed") {
+			int64_t seed = 0;
+			if(!(tokens >> seed) || seed < 0 || seed > int64_t(~0u)) {
+				log_error("%s:%u: seed must be a non-negative 32-bit integer", file_name, line_num);
+				return false;
+			}
+			scene.seed = uint32_t(seed);
+		}
+		else {
+			log_error("%s:%u: unknown scene key \"%s\"", file_name, line_num, key);
+			return false;
+		}
+	}
+	
+	if(!assets.empty()) {
+		scene.assets = assets;
+	}
+	return true;
+}
+
+//! instances each model "instance_count" times according to the scene placement (w/o instancing: one untransformed
+//! instance per model), if "triangle_budget" is non-zero, no more instances are added once the total triangle count
+//! of all instances would exceed it
+static vector<animation_instance> place_instances(const vector<unique_ptr<animation>>& models,
+												  const uint32_t instance_count,
+												  const uint32_t triangle_budget = 0) {
+	vector<animation_instance> instances;
+	const auto model_count = uint32_t(models.size());
+	if(instance_count == 0) {
+		for(uint32_t i = 0; i < model_count; ++i) {
+			instances.emplace_back(animation_instance { i, matrix4f {} });
+		}
+		return instances;
+	}
+	
+	// instances are added interleaved by model, so that a triangle budget cuts off all models evenly
+	uint64_t triangle_count = 0;
+	const auto total_count = model_count * instance_count;
+	const auto grid_size = uint32_t(ceil(sqrt(float(total_count))));
+	const auto spacing = 1.0f / sqrt(scene.density);
+	const auto area_size = sqrt(float(total_count) / scene.density);
+	mt19937 rng { scene.seed };
+	uniform_real_distribution<float> position_dist { -0.5f * area_size, 0.5f * area_size };
+	uniform_real_distribution<float> angle_dist { 0.0f, 360.0f };
+	for(uint32_t j = 0; j < instance_count; ++j) {
+		for(uint32_t i = 0; i < model_count; ++i) {
+			if(triangle_budget > 0 && triangle_count + models[i]->tri_count > triangle_budget) continue;
+			triangle_count += models[i]->tri_count;
+			
+			matrix4f transform;
+			switch(scene.placement) {
+				case INSTANCE_PLACEMENT::LINE:
+					transform = (matrix4f::rotation_deg_named<'y'>(float(j) * 45.0f) *
+								 matrix4f::translation(float3 { float(j) * 2.0f, 0.0f, 0.0f }));
+					break;
+				case INSTANCE_PLACEMENT::GRID: {
+					const auto slot = j * model_count + i;
+					const auto offset = -0.5f * float(grid_size - 1u) * spacing;
+					transform = (matrix4f::rotation_deg_named<'y'>(float(slot) * 45.0f) *
+								 matrix4f::translation(float3 {
+									 offset + float(slot % grid_size) * spacing,
+									 0.0f,
+									 offset + float(slot / grid_size) * spacing
+								 }));
+					break;
+				}
+				case INSTANCE_PLACEMENT::RANDOM: {
+					const auto angle = angle_dist(rng);
+					const auto x = position_dist(rng), z = position_dist(rng);
+					transform = (matrix4f::rotation_deg_named<'y'>(angle) *
+								 matrix4f::translation(float3 { x, 0.0f, z }));
+					break;
+				}
+			}
+			instances.emplace_back(animation_instance { i, transform });
+		}
+	}
+	return instances;
+}
+
+//! escapes a string for use inside a json string literal
+static string json_escape(const string& str) {
+	string escaped;
+	escaped.reserve(str.size());
+	for(const auto& ch : str) {
+		if(ch == '"' || ch == '\\') {
+			escaped += '\\';
+			escaped += ch;
+		}
+		else if((unsigned char)ch < 0x20u) {
+			static constexpr const char hex_digits[] { "0123456789ABCDEF" };
+			escaped += "\\u00";
+			escaped += hex_digits[((unsigned char)ch >> 4u) & 0xFu];
+			escaped += hex_digits[(unsigned char)ch & 0xFu];
+		}
+		else escaped += ch;
+	}
+	return escaped;
+}
+
+//! runs the headless sweep benchmark (see hlbvh_state.sweep_*) and writes the results to a .json file:
+//! for each instance count and triangle budget, the scene is first collided for "sweep_frames" frames to measure
+//! frames/s and collisions/s (colliding instances per second), then again with stats enabled to measure the
+//! per-stage times (these are fenced, so they are recorded separately to not distort the throughput numbers)
+static bool run_sweep(const vector<unique_ptr<animation>>& models, collider& hlbvh_collider) {
+	const auto stats_enabled = hlbvh_state.stats;
+	stringstream json;
+	json << "{" << endl;
+	json << "\t\"device\": \"" << json_escape(hlbvh_state.dev->name) << "\"," << endl;
+	json << "\t\"frames\": " << hlbvh_state.sweep_frames << "," << endl;
+	json << "\t\"results\": [" << endl;
+	
+	bool first_result = true;
+	for(const auto& instance_count : hlbvh_state.sweep_instance_counts) {
+		for(const auto& triangle_budget : hlbvh_state.sweep_triangle_budgets) {
+			const auto instances = place_instances(models, instance_count, triangle_budget);
+			if(instances.empty()) {
+				log_warn("sweep: triangle budget %u is too small for any instance", triangle_budget);
+				continue;
+			}
+			uint64_t triangle_count = 0;
+			for(const auto& instance : instances) {
+				triangle_count += models[instance.animation_idx]->tri_count;
+			}
+			log_msg("sweep: %u instances per asset, triangle budget %u -> %u instances, %u triangles",
+					instance_count, triangle_budget, instances.size(), triangle_count);
+			
+			// throughput run
+			hlbvh_state.stats = false;
+			uint64_t collision_count = 0;
+			hlbvh_state.dev_queue->finish();
+			const auto start_time = chrono::high_resolution_clock::now();
+			for(uint32_t frame = 0; frame < hlbvh_state.sweep_frames; ++frame) {
+				for(auto& mdl : models) {
+					mdl->do_step();
+				}
+				const auto& collisions = hlbvh_collider.collide(models, instances);
+				for(const auto& flag : collisions) {
+					collision_count += (flag > 0 ? 1u : 0u);
+				}
+			}
+			hlbvh_state.dev_queue->finish();
+			const auto seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start_time).count();
+			
+			// per-stage run
+			hlbvh_state.stats = true;
+			hlbvh_collider.get_stats().clear();
+			for(uint32_t frame = 0; frame < hlbvh_state.sweep_frames; ++frame) {
+				for(auto& mdl : models) {
+					mdl->do_step();
+				}
+				hlbvh_collider.collide(models, instances);
+			}
+			
+			const auto fps = double(hlbvh_state.sweep_frames) / seconds;
+			log_msg("sweep: %f frames/s, %f collisions/s", fps, double(collision_count) / seconds);
+			
+			json << (first_result ? "" : ",\n") << "\t\t{" << endl;
+			json << "\t\t\t\"instances_per_asset\": " << instance_count << "," << endl;
+			json << "\t\t\t\"triangle_budget\": " << triangle_budget << "," << endl;
+			json << "\t\t\t\"instance_count\": " << instances.size() << "," << endl;
+			json << "\t\t\t\"triangle_count\": " << triangle_count << "," << endl;
+			json << "\t\t\t\"frames_per_second\": " << fps << "," << endl;
+			json << "\t\t\t\"collisions_per_second\": " << (double(collision_count) / seconds) << "," << endl;
+			json << "\t\t\t\"stages_ms\": {" << endl;
+			for(uint32_t stage = 0; stage < collision_stats::stage_count; ++stage) {
+				const auto times = hlbvh_collider.get_stats().stage_times(collision_stats::STAGE(stage));
+				json << "\t\t\t\t\"" << collision_stats::stage_name(collision_stats::STAGE(stage)) << "\": { ";
+				json << "\"mean\": " << times.first << ", \"p99\": " << times.second << " }";
+				json << (stage + 1u < collision_stats::stage_count ? "," : "") << endl;
+			}
+			json << "\t\t\t}" << endl;
+			json << "\t\t}";
+			first_result = false;
+		}
+	}
+	json << endl << "\t]" << endl << "}" << endl;
+	
+	hlbvh_collider.get_stats().clear();
+	hlbvh_state.stats = stats_enabled;
+	
+	if(!file_io::string_to_file(hlbvh_state.sweep_json_file_name, json.str())) {
+		log_error("failed to write sweep results to %s", hlbvh_state.sweep_json_file_name);
+		return false;
+	}
+	log_msg("sweep results written to %s", hlbvh_state.sweep_json_file_name);
+	return true;
+}
+
+//! parses a comma-separated list of unsigned integers
+static vector<uint32_t> parse_uint_list(const string& list) {
+	vector<uint32_t> ret;
+	stringstream tokens(list);
+	string token;
+	while(getline(tokens, token, ',')) {
+		if(token.empty()) continue;
+		ret.emplace_back((uint32_t)strtoul(token.c_str(), nullptr, 10));
+	}
+	return ret;
+}
+
 //! option -> function map
 template<> vector<pair<string, hlbvh_opt_handler::option_function>> hlbvh_opt_handler::options {
 	{ "--help", [](hlbvh_option_context&, char**&) {
@@ -50,6 +371,32 @@ template<> vector<pair<string, hlbvh_opt_handler::option_function>> hlbvh_opt_ha
 		cout << "\t--no-vulkan: disables vulkan rendering" << endl;
 		cout << "\t--benchmark: runs the simulation in benchmark mode, without rendering" << endl;
 		cout << "\t--no-triangle-vis: disables triangle collision visualization and uses per-model visualization instead (faster)" << endl;
+		cout << "\t--morton-30: always use 30-bit morton codes (default: 63-bit codes for meshes with >= " << WIDE_MORTON_CODE_TRIANGLE_THRESHOLD << " triangles)" << endl;
+		cout << "\t--morton-63: always use 63-bit morton codes" << endl;
+		cout << "\t--contacts: outputs all intersecting triangle pairs into a bounded contacts buffer" << endl;
+		cout << "\t--contact-points: also computes the intersection segment of each contact (implies --contacts)" << endl;
+		cout << "\t--max-contacts <count>: max amount of contacts per frame (default: " << hlbvh_state.max_contacts << ")" << endl;
+		cout << "\t--self-collision: also checks each model for self-intersections" << endl;
+		cout << "\t--broadphase-pairs: always check all root aabb pairs in the broadphase" << endl;
+		cout << "\t--broadphase-sweep: always use sort-and-sweep in the broadphase" << endl;
+		cout << "\t--instances <count>: instances each model <count> times, with all instances sharing the same bvh" << endl;
+		cout << "\t--compressed-bvh: traverses compressed 64-byte bvh nodes (16-bit quantized child aabbs)" << endl;
+		cout << "\t--wide-bvh: traverses " << WIDE_BVH_WIDTH << "-wide bvh nodes (intended for host-compute)" << endl;
+		cout << "\t--tandem: collides bvh pairs via a simultaneous traversal of both bvhs" << endl;
+		cout << "\t--persistent: uses persistent threads that dynamically grab leaves for the per-leaf bvh traversal" << endl;
+		cout << "\t--batched-narrowphase: collects candidate triangle pairs first and tests them in batches in a separate pass" << endl;
+		cout << "\t--contact-cache: re-tests the last frame's colliding triangle pairs before doing a full traversal (requires --no-triangle-vis)" << endl;
+		cout << "\t--ccd: continuous collision detection over the motion of each animation step (disables --contacts)" << endl;
+		cout << "\t--device-flags: keeps the collision flags on the device and renders directly from them (host flags are one frame behind)" << endl;
+		cout << "\t--no-flags-readback: don't read back the collision flags at all (requires --device-flags)" << endl;
+		cout << "\t--stats: records the time of each collision stage and logs mean/p99 times at exit" << endl;
+		cout << "\t--stats-csv <file>: also writes the per-frame collision stage times to a .csv file (implies --stats)" << endl;
+		cout << "\t--scene <file>: loads the scene (assets, instancing and placement) from the specified file" << endl;
+		cout << "\t--sweep <counts>: headless sweep over the comma-separated instance counts (per asset), writes .json results" << endl;
+		cout << "\t--sweep-triangles <budgets>: comma-separated total triangle budgets for the sweep (default: 0 = unlimited)" << endl;
+		cout << "\t--sweep-frames <count>: amount of frames per sweep configuration (default: " << hlbvh_state.sweep_frames << ")" << endl;
+		cout << "\t--sweep-json <file>: sweep results file (default: " << hlbvh_state.sweep_json_file_name << ")" << endl;
+		cout << "\t--stream-keyframes: only keeps a small window of animation key-frames resident on the device (benchmark mode only)" << endl;
 		hlbvh_state.done = true;
 		
 		cout << endl;
@@ -86,6 +433,160 @@ template<> vector<pair<string, hlbvh_opt_handler::option_function>> hlbvh_opt_ha
 		hlbvh_state.triangle_vis = false;
 		cout << "triangle collision visualization disabled" << endl;
 	}},
+	{ "--morton-30", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.morton_code_bits = 30;
+		cout << "using 30-bit morton codes" << endl;
+	}},
+	{ "--morton-63", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.morton_code_bits = 63;
+		cout << "using 63-bit morton codes" << endl;
+	}},
+	{ "--contacts", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.contacts = true;
+		cout << "contacts output enabled" << endl;
+	}},
+	{ "--contact-points", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.contacts = true;
+		hlbvh_state.contact_points = true;
+		cout << "contacts output (with contact points) enabled" << endl;
+	}},
+	{ "--max-contacts", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --max-contacts!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.max_contacts = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		cout << "max contacts set to: " << hlbvh_state.max_contacts << endl;
+	}},
+	{ "--self-collision", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.self_collision = true;
+		cout << "self-collision enabled" << endl;
+	}},
+	{ "--broadphase-pairs", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.broadphase = 1;
+		cout << "using all-pairs broadphase" << endl;
+	}},
+	{ "--broadphase-sweep", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.broadphase = 2;
+		cout << "using sort-and-sweep broadphase" << endl;
+	}},
+	{ "--instances", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --instances!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.instance_count = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		cout << "instance count set to: " << hlbvh_state.instance_count << endl;
+	}},
+	{ "--compressed-bvh", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.compressed_bvh = true;
+		cout << "compressed bvh enabled" << endl;
+	}},
+	{ "--wide-bvh", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.wide_bvh = true;
+		cout << "wide bvh enabled" << endl;
+	}},
+	{ "--tandem", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.tandem = true;
+		cout << "tandem bvh traversal enabled" << endl;
+	}},
+	{ "--persistent", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.persistent = true;
+		cout << "persistent threads enabled" << endl;
+	}},
+	{ "--batched-narrowphase", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.batched_narrowphase = true;
+		cout << "batched narrowphase enabled" << endl;
+	}},
+	{ "--contact-cache", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.contact_cache = true;
+		cout << "contact cache enabled" << endl;
+	}},
+	{ "--ccd", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.ccd = true;
+		cout << "continuous collision detection enabled" << endl;
+	}},
+	{ "--stats", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.stats = true;
+		cout << "collision stats enabled" << endl;
+	}},
+	{ "--stats-csv", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --stats-csv!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.stats = true;
+		hlbvh_state.stats_csv_file_name = *arg_ptr;
+		cout << "collision stats enabled, writing to: " << hlbvh_state.stats_csv_file_name << endl;
+	}},
+	{ "--stream-keyframes", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.stream_keyframes = true;
+		cout << "key-frame streaming enabled" << endl;
+	}},
+	{ "--scene", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --scene!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.scene_file_name = *arg_ptr;
+		cout << "scene file set to: " << hlbvh_state.scene_file_name << endl;
+	}},
+	{ "--sweep", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --sweep!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.sweep_instance_counts = parse_uint_list(*arg_ptr);
+		cout << "sweep over instance counts: " << *arg_ptr << endl;
+	}},
+	{ "--sweep-triangles", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --sweep-triangles!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.sweep_triangle_budgets = parse_uint_list(*arg_ptr);
+		cout << "sweep over triangle budgets: " << *arg_ptr << endl;
+	}},
+	{ "--sweep-frames", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --sweep-frames!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.sweep_frames = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		cout << "sweep frames set to: " << hlbvh_state.sweep_frames << endl;
+	}},
+	{ "--sweep-json", [](hlbvh_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --sweep-json!" << endl;
+			hlbvh_state.done = true;
+			return;
+		}
+		hlbvh_state.sweep_json_file_name = *arg_ptr;
+		cout << "sweep results file set to: " << hlbvh_state.sweep_json_file_name << endl;
+	}},
+	{ "--device-flags", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.device_collision_flags = true;
+		cout << "device collision flags enabled" << endl;
+	}},
+	{ "--no-flags-readback", [](hlbvh_option_context&, char**&) {
+		hlbvh_state.collision_flags_readback = false;
+		cout << "collision flags readback disabled" << endl;
+	}},
 	{ "--benchmark", [](hlbvh_option_context&, char**&) {
 		hlbvh_state.no_opengl = true; // also disable opengl
 		hlbvh_state.no_metal = true; // also disable metal
@@ -230,6 +731,88 @@ int main(int, char* argv[]) {
 	hlbvh_opt_handler::parse_options(argv + 1, option_ctx);
 	if(hlbvh_state.done) return 0;
 	
+	// load the scene (--instances overrides the scene instance count)
+	if(!hlbvh_state.scene_file_name.empty() && !load_scene(hlbvh_state.scene_file_name)) {
+		return -1;
+	}
+	if(hlbvh_state.instance_count == 0) {
+		hlbvh_state.instance_count = scene.instance_count;
+	}
+	
+	// the sweep is headless and always uses instancing (this also disables all features that instancing doesn't support)
+	if(!hlbvh_state.sweep_instance_counts.empty()) {
+		if(find(begin(hlbvh_state.sweep_instance_counts), end(hlbvh_state.sweep_instance_counts), 0u) !=
+		   end(hlbvh_state.sweep_instance_counts)) {
+			cerr << "sweep instance counts must be > 0" << endl;
+			return -1;
+		}
+		hlbvh_state.no_opengl = true;
+		hlbvh_state.no_metal = true;
+		hlbvh_state.no_vulkan = true;
+		hlbvh_state.triangle_vis = false;
+		hlbvh_state.benchmark = true;
+		hlbvh_state.instance_count = *max_element(begin(hlbvh_state.sweep_instance_counts),
+												  end(hlbvh_state.sweep_instance_counts));
+	}
+	
+	// swept collision checking doesn't output contacts
+	if(hlbvh_state.ccd && hlbvh_state.contacts) {
+		cerr << "contacts output is not supported with ccd, disabling contacts" << endl;
+		hlbvh_state.contacts = false;
+		hlbvh_state.contact_points = false;
+	}
+	
+	// the traversal strategies replace each other, so at most one of them can be used
+	if(uint32_t(hlbvh_state.tandem) + uint32_t(hlbvh_state.wide_bvh) + uint32_t(hlbvh_state.compressed_bvh) +
+	   uint32_t(hlbvh_state.persistent) + uint32_t(hlbvh_state.batched_narrowphase) > 1u) {
+		cerr << "only one of --tandem, --wide-bvh, --compressed-bvh, --persistent and --batched-narrowphase can be used" << endl;
+		return -1;
+	}
+	
+	// ccd and contacts always use their own traversal
+	if((hlbvh_state.ccd || hlbvh_state.contacts) &&
+	   (hlbvh_state.tandem || hlbvh_state.wide_bvh || hlbvh_state.compressed_bvh ||
+		hlbvh_state.persistent || hlbvh_state.batched_narrowphase)) {
+		cerr << "tandem, wide/compressed bvh, persistent and batched narrowphase traversal are not supported with "
+		"ccd or contacts, disabling them" << endl;
+		hlbvh_state.tandem = false;
+		hlbvh_state.wide_bvh = false;
+		hlbvh_state.compressed_bvh = false;
+		hlbvh_state.persistent = false;
+		hlbvh_state.batched_narrowphase = false;
+	}
+	
+	// instanced collision only flags whole instances
+	if(hlbvh_state.instance_count > 0) {
+		if(hlbvh_state.triangle_vis || hlbvh_state.contacts || hlbvh_state.ccd || hlbvh_state.self_collision) {
+			cerr << "triangle visualization, contacts, ccd and self-collision are not supported with instancing, disabling them" << endl;
+		}
+		hlbvh_state.triangle_vis = false;
+		hlbvh_state.contacts = false;
+		hlbvh_state.contact_points = false;
+		hlbvh_state.ccd = false;
+		hlbvh_state.self_collision = false;
+	}
+	
+	// the contact cache only stores whole mesh pair results
+	if(hlbvh_state.contact_cache &&
+	   (hlbvh_state.triangle_vis || hlbvh_state.contacts || hlbvh_state.ccd || hlbvh_state.instance_count > 0)) {
+		cerr << "contact cache requires per-model visualization and no contacts, ccd or instancing, disabling it" << endl;
+		hlbvh_state.contact_cache = false;
+	}
+	
+	// the sweep counts collisions on the host
+	if(!hlbvh_state.collision_flags_readback && !hlbvh_state.sweep_instance_counts.empty()) {
+		cerr << "the sweep benchmark requires the collision flags readback, enabling it" << endl;
+		hlbvh_state.collision_flags_readback = true;
+	}
+	
+	// render models are always fully resident, so streaming would only save part of the memory
+	if(hlbvh_state.stream_keyframes && !hlbvh_state.benchmark) {
+		cerr << "key-frame streaming is only supported in benchmark mode, disabling it" << endl;
+		hlbvh_state.stream_keyframes = false;
+	}
+	
 	// disable renderers that aren't available
 #if defined(FLOOR_NO_METAL)
 	hlbvh_state.no_metal = true;
@@ -338,15 +921,55 @@ int main(int, char* argv[]) {
 	
 	// get all kernels
 	hlbvh_state.kernels = {
+		{ "init_aabbs", {} },
 		{ "build_aabbs", {} },
+		{ "build_aabbs_swept", {} },
 		{ "collide_root_aabbs", {} },
+		{ "compute_sweep_keys", {} },
+		{ "sweep_root_aabbs", {} },
 		{ "compute_morton_codes", {} },
+		{ "compute_morton_codes_wide", {} },
+		{ "gather_morton_codes_hi", {} },
 		{ "build_bvh", {} },
+		{ "build_bvh_wide", {} },
 		{ "build_bvh_aabbs_leaves", {} },
+		{ "build_bvh_aabbs_leaves_swept", {} },
 		{ "build_bvh_aabbs", {} },
 		{ "collide_bvhs_no_tri_vis", {} },
 		{ "collide_bvhs_tri_vis", {} },
+		{ "collide_bvhs_contacts", {} },
+		{ "collide_bvhs_contacts_tri_vis", {} },
+		{ "collide_bvhs_ccd_no_tri_vis", {} },
+		{ "collide_bvhs_ccd_tri_vis", {} },
+		{ "collide_bvh_self_no_tri_vis", {} },
+		{ "collide_bvh_self_tri_vis", {} },
+		{ "collide_bvh_self_ccd_no_tri_vis", {} },
+		{ "collide_bvh_self_ccd_tri_vis", {} },
+		{ "expand_tandem_node_pairs_no_tri_vis", {} },
+		{ "expand_tandem_node_pairs_tri_vis", {} },
+		{ "collide_bvhs_tandem_no_tri_vis", {} },
+		{ "collide_bvhs_tandem_tri_vis", {} },
+		{ "build_compressed_bvh", {} },
+		{ "collide_bvhs_compressed_no_tri_vis", {} },
+		{ "collide_bvhs_compressed_tri_vis", {} },
+		{ "build_wide_bvh", {} },
+		{ "collide_bvhs_wide_no_tri_vis", {} },
+		{ "collide_bvhs_wide_tri_vis", {} },
 		{ "map_collided_triangles", {} },
+		{ "transform_root_aabbs", {} },
+		{ "collide_bvhs_instanced", {} },
+		{ "collide_bvhs_persistent_no_tri_vis", {} },
+		{ "collide_bvhs_persistent_tri_vis", {} },
+		{ "collect_candidate_pairs_no_tri_vis", {} },
+		{ "collect_candidate_pairs_tri_vis", {} },
+		{ "test_candidate_pairs_no_tri_vis", {} },
+		{ "test_candidate_pairs_tri_vis", {} },
+		{ "gather_contact_cache_triangles", {} },
+		{ "retest_contact_cache", {} },
+		{ "reset_contact_cache_misses", {} },
+		{ "collide_bvhs_record_contact_cache", {} },
+		{ "query_rays", {} },
+		{ "query_closest_points", {} },
 		{ "radix_sort_count", {} },
 		{ "radix_sort_prefix_sum", {} },
 		{ "radix_sort_stream_split", {} },
@@ -376,7 +999,9 @@ int main(int, char* argv[]) {
 	shared_ptr<compute_program> shader_prog;
 	if(!hlbvh_state.no_metal) {
 		shader_prog = hlbvh_state.ctx->add_program_file(floor::data_path("../hlbvh/src/hlbvh_shaders.cpp"),
-														"-DCOLLIDING_TRIANGLES_VIS="s + (hlbvh_state.triangle_vis ? "1" : "0"));
+														"-DCOLLIDING_TRIANGLES_VIS="s + (hlbvh_state.triangle_vis ? "1" : "0") +
+														" -DDEVICE_COLLISION_FLAGS="s +
+														(hlbvh_state.device_collision_flags && !hlbvh_state.triangle_vis ? "1" : "0"));
 		if(shader_prog == nullptr) {
 			log_error("shader program compilation failed");
 			return -1;
@@ -401,11 +1026,22 @@ int main(int, char* argv[]) {
 	
 	// load animated models
 	vector<unique_ptr<animation>> models;
-	models.emplace_back(make_unique<animation>("collision_models/gear/gear_0000", ".obj", 20, false, 0.1f));
-	models.emplace_back(make_unique<animation>("collision_models/gear2/gear2_0000", ".obj", 20, false, 0.1f));
-	models.emplace_back(make_unique<animation>("collision_models/sinbad/sinbad_0000", ".obj", 20, true));
-	models.emplace_back(make_unique<animation>("collision_models/golem/golem_0000", ".obj", 20, false, 0.125f));
-	models.emplace_back(make_unique<animation>("collision_models/plane/plane_00000", ".obj", 2));
+	for(const auto& asset : scene.assets) {
+		models.emplace_back(make_unique<animation>(asset.file_prefix, ".obj", asset.frame_count,
+												   asset.loop_or_reset, asset.step_size));
+		if(!models.back()->is_valid()) {
+			log_error("failed to load asset %s", asset.file_prefix);
+			return -1;
+		}
+		if(asset.phase > 0.0f) {
+			// looping animations cycle through all frames, resetting ones through all but the last (see set_phase)
+			const auto cycle_length = (asset.loop_or_reset ? asset.frame_count - 1u : asset.frame_count);
+			models.back()->set_phase(asset.phase * float(cycle_length));
+		}
+	}
+	
+	// instance each model
+	auto instances = place_instances(models, hlbvh_state.instance_count);
 	
 	// create collider
 	collider hlbvh_collider;
@@ -413,6 +1049,15 @@ int main(int, char* argv[]) {
 	// init done, release context
 	floor::release_context();
 	
+	// headless sweep benchmark (no renderer is active, so everything can be torn down directly afterwards)
+	if(!hlbvh_state.sweep_instance_counts.empty()) {
+		const auto sweep_success = run_sweep(models, hlbvh_collider);
+		floor::get_event()->remove_event_handler(evt_handler_fnctr);
+		cam = nullptr;
+		floor::destroy();
+		return (sweep_success ? 0 : -1);
+	}
+	
 	// main loop
 	while(!hlbvh_state.done) {
 		floor::get_event()->handle_events();
@@ -439,7 +1084,24 @@ int main(int, char* argv[]) {
 		}
 		
 		// run the collision
-		const auto& collisions = hlbvh_collider.collide(models);
+		const auto& collisions = (hlbvh_state.instance_count == 0 ?
+								  hlbvh_collider.collide(models) :
+								  hlbvh_collider.collide(models, instances));
+		if(hlbvh_state.contacts && !hlbvh_state.stop) {
+			uint32_t contacts_overflow = 0;
+			const auto& contacts = hlbvh_collider.read_contacts(contacts_overflow);
+			if(contacts_overflow > 0) {
+				log_warn("contacts buffer overflow: %u contacts were dropped (increase --max-contacts)", contacts_overflow);
+			}
+			if(hlbvh_state.benchmark) {
+				log_debug("contacts: %u", contacts.size());
+			}
+		}
+		if(hlbvh_state.self_collision && hlbvh_state.benchmark && !hlbvh_state.stop) {
+			const auto& self_collisions = hlbvh_collider.get_self_collision_flags();
+			log_debug("self-colliding models: %u",
+					  count_if(self_collisions.begin(), self_collisions.end(), [](const uint32_t& flag) { return flag > 0; }));
+		}
 		
 		//
 		if(floor::is_new_fps_count()) {
@@ -456,11 +1118,13 @@ int main(int, char* argv[]) {
 		else if(!hlbvh_state.no_opengl || !hlbvh_state.no_metal || !hlbvh_state.no_vulkan) {
 			floor::start_frame();
 			if(!hlbvh_state.no_opengl) {
-				gl_renderer::render(models, collisions, hlbvh_state.cam_mode, *cam.get());
+				gl_renderer::render(models, instances, collisions, hlbvh_collider.get_collision_flags_buffer(),
+								 hlbvh_state.cam_mode, *cam.get());
 			}
 #if defined(__APPLE__)
 			else if(!hlbvh_state.no_metal) {
-				metal_renderer::render(models, collisions, hlbvh_state.cam_mode, *cam.get());
+				metal_renderer::render(models, instances, collisions, hlbvh_collider.get_collision_flags_buffer(),
+									hlbvh_state.cam_mode, *cam.get());
 			}
 #endif
 #if !defined(FLOOR_NO_VULKAN)
@@ -472,6 +1136,13 @@ int main(int, char* argv[]) {
 		}
 	}
 	
+	if(hlbvh_state.stats) {
+		hlbvh_collider.get_stats().print_summary();
+		if(!hlbvh_state.stats_csv_file_name.empty()) {
+			hlbvh_collider.get_stats().write_csv(hlbvh_state.stats_csv_file_name);
+		}
+	}
+	
 	// unregister event handler (we really don't want to react to events when destructing everything)
 	floor::get_event()->remove_event_handler(evt_handler_fnctr);
 	cam = nullptr;
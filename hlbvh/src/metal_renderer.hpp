@@ -28,8 +28,12 @@ struct metal_renderer {
 	static bool init(shared_ptr<compute_kernel> vs,
 					 shared_ptr<compute_kernel> fs);
 	static void destroy();
+	//! renders all instances, "collisions" contains the collision flag of each instance,
+	//! with device collision flags, "collisions_buffer" is used instead
 	static void render(const vector<unique_ptr<animation>>& models,
+					   const vector<animation_instance>& instances,
 					   const vector<uint32_t>& collisions,
+					   const shared_ptr<compute_buffer>& collisions_buffer,
 					   const bool cam_mode,
 					   const camera& cam);
 };
@@ -137,7 +137,9 @@ bool metal_renderer::init(shared_ptr<compute_kernel> vs,
 }
 
 void metal_renderer::render(const vector<unique_ptr<animation>>& models,
+							const vector<animation_instance>& instances,
 							const vector<uint32_t>& collisions,
+							const shared_ptr<compute_buffer>& collisions_buffer,
 							const bool cam_mode,
 							const camera& cam) {
 	@autoreleasepool {
@@ -174,12 +176,13 @@ void metal_renderer::render(const vector<unique_ptr<animation>>& models,
 			float4 default_color;
 			float3 light_dir;
 		} uniforms {
-			.mvpm = mview * mproj,
+			.mvpm = {},
 			.repl_color = {},
 			.default_color = {},
 			.light_dir = { 1.0f, 0.0f, 0.0f },
 		};
 		static_assert(sizeof(uniforms) == 108, "invalid uniforms size");
+		const matrix4f mvpm { mview * mproj };
 		
 		//
 		id <MTLRenderCommandEncoder> encoder = [cmd_buffer renderCommandEncoderWithDescriptor:render_pass_desc];
@@ -191,14 +194,19 @@ void metal_renderer::render(const vector<unique_ptr<animation>>& models,
 		
 		//
 		[encoder setFragmentBytes:&uniforms length:sizeof(uniforms) atIndex:0];
-		for(uint32_t i = 0; i < (uint32_t)models.size(); ++i) {
-			const auto& mdl = models[i];
+		for(uint32_t i = 0; i < (uint32_t)instances.size(); ++i) {
+			const auto& mdl = models[instances[i].animation_idx];
+			uniforms.mvpm = instances[i].transform * mvpm;
 			const auto cur_frame = (const floor_obj_model*)mdl->frames[mdl->cur_frame].get();
 			const auto next_frame = (const floor_obj_model*)mdl->frames[mdl->next_frame].get();
 			
 			static constexpr const float4 default_color { 0.9f, 0.9f, 0.9f, 1.0f };
 			static constexpr const float4 collision_color { 1.0f, 0.0f, 0.0f, 1.0f };
-			if(!hlbvh_state.triangle_vis) {
+			if(hlbvh_state.device_collision_flags && !hlbvh_state.triangle_vis) {
+				// flag is read in the vertex shader
+				uniforms.default_color = default_color;
+			}
+			else if(!hlbvh_state.triangle_vis) {
 				uniforms.default_color = (collisions[i] == 0 ? default_color : collision_color);
 			}
 			else {
@@ -215,6 +223,11 @@ void metal_renderer::render(const vector<unique_ptr<animation>>& models,
 			if(hlbvh_state.triangle_vis) {
 				[encoder setVertexBuffer:((metal_buffer*)mdl->colliding_vertices.get())->get_metal_buffer() offset:0 atIndex:6];
 			}
+			else if(hlbvh_state.device_collision_flags) {
+				[encoder setVertexBuffer:((metal_buffer*)collisions_buffer.get())->get_metal_buffer()
+								  offset:(i * sizeof(uint32_t))
+								 atIndex:6];
+			}
 			
 			for(const auto& obj : cur_frame->objects) {
 				[encoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
@@ -169,4 +169,171 @@ static bool check_triangle_intersection(const float3 v0_a, const float3 v1_a, co
 			max(isect2[0], isect2[1]) < min(isect1[0], isect1[1]) ? false : true);
 }
 
+// branch-free variant of check_triangle_intersection: all early-outs and interval cases are computed via selects,
+// so that the test has a fixed instruction stream (-> no divergence when testing many pairs at once, and the compiler
+// can vectorize it across pairs on host compute)
+static bool check_triangle_intersection_branchless(const float3 v0_a, const float3 v1_a, const float3 v2_a,
+												   const float3 v0_b, const float3 v1_b, const float3 v2_b) {
+	// same interval cases as in check_triangle_intersection, but in each case one vertex s is alone on its side of the
+	// plane and the other two (o0, o1) are on the other side -> only need to select s, o0 and o1
+	const auto compute_intervals = [](const float& VV0, const float& VV1, const float& VV2,
+									  const float& D0, const float& D1, const float& D2,
+									  const float& D0D1, const float& D0D2,
+									  float& A, float& B, float& C,
+									  float& X0, float& X1) {
+		const bool case_0 = (D0D1 > 0.0f);
+		const bool case_1 = (!case_0 && D0D2 > 0.0f);
+		const bool case_2 = (!case_0 && !case_1 && (D1 * D2 > 0.0f || D0 != 0.0f));
+		const bool case_3 = (!case_0 && !case_1 && !case_2 && D1 != 0.0f);
+		const bool case_4 = (!case_0 && !case_1 && !case_2 && !case_3 && D2 != 0.0f);
+		const bool alone_2 = (case_0 || case_4);
+		const bool alone_1 = (case_1 || case_3);
+		
+		const auto VVs = (alone_2 ? VV2 : (alone_1 ? VV1 : VV0));
+		const auto Ds = (alone_2 ? D2 : (alone_1 ? D1 : D0));
+		const auto VVo0 = (alone_2 || alone_1 ? VV0 : VV1);
+		const auto Do0 = (alone_2 || alone_1 ? D0 : D1);
+		const auto VVo1 = (alone_2 ? VV1 : VV2);
+		const auto Do1 = (alone_2 ? D1 : D2);
+		A = VVs;
+		B = (VVo0 - VVs) * Ds;
+		C = (VVo1 - VVs) * Ds;
+		X0 = Ds - Do0;
+		X1 = Ds - Do1;
+		
+		// coplanar triangles are ignored
+		return (case_0 || case_1 || case_2 || case_3 || case_4);
+	};
+	
+	static constexpr const float triangle_epsilon = 0.000001f;
+	
+	const auto N1 = (v1_a - v0_a).cross(v2_a - v0_a);
+	const auto d1 = N1.dot(v0_a);
+	auto du0 = N1.dot(v0_b) - d1;
+	auto du1 = N1.dot(v1_b) - d1;
+	auto du2 = N1.dot(v2_b) - d1;
+	du0 = (abs(du0) < triangle_epsilon ? 0.0f : du0);
+	du1 = (abs(du1) < triangle_epsilon ? 0.0f : du1);
+	du2 = (abs(du2) < triangle_epsilon ? 0.0f : du2);
+	const auto du0du1 = du0 * du1;
+	const auto du0du2 = du0 * du2;
+	const bool separated_b = (du0du1 > 0.0f && du0du2 > 0.0f);
+	
+	const auto N2 = (v1_b - v0_b).cross(v2_b - v0_b);
+	const auto d2 = N2.dot(v0_b);
+	auto dv0 = N2.dot(v0_a) - d2;
+	auto dv1 = N2.dot(v1_a) - d2;
+	auto dv2 = N2.dot(v2_a) - d2;
+	dv0 = (abs(dv0) < triangle_epsilon ? 0.0f : dv0);
+	dv1 = (abs(dv1) < triangle_epsilon ? 0.0f : dv1);
+	dv2 = (abs(dv2) < triangle_epsilon ? 0.0f : dv2);
+	const auto dv0dv1 = dv0 * dv1;
+	const auto dv0dv2 = dv0 * dv2;
+	const bool separated_a = (dv0dv1 > 0.0f && dv0dv2 > 0.0f);
+	
+	const auto index = N1.crossed(N2).abs().max_element_index();
+	const auto vp0 = (index == 0 ? v0_a.x : (index == 1 ? v0_a.y : v0_a.z));
+	const auto vp1 = (index == 0 ? v1_a.x : (index == 1 ? v1_a.y : v1_a.z));
+	const auto vp2 = (index == 0 ? v2_a.x : (index == 1 ? v2_a.y : v2_a.z));
+	const auto up0 = (index == 0 ? v0_b.x : (index == 1 ? v0_b.y : v0_b.z));
+	const auto up1 = (index == 0 ? v1_b.x : (index == 1 ? v1_b.y : v1_b.z));
+	const auto up2 = (index == 0 ? v2_b.x : (index == 1 ? v2_b.y : v2_b.z));
+	
+	float a, b, c, x0, x1;
+	const bool valid_a = compute_intervals(vp0, vp1, vp2, dv0, dv1, dv2, dv0dv1, dv0dv2, a, b, c, x0, x1);
+	float d, e, f, y0, y1;
+	const bool valid_b = compute_intervals(up0, up1, up2, du0, du1, du2, du0du1, du0du2, d, e, f, y0, y1);
+	
+	const auto xx = x0 * x1;
+	const auto yy = y0 * y1;
+	const auto xxyy = xx * yy;
+	const auto tmp1 = a * xxyy;
+	const auto isect1_0 = tmp1 + b * x1 * yy;
+	const auto isect1_1 = tmp1 + c * x0 * yy;
+	const auto tmp2 = d * xxyy;
+	const auto isect2_0 = tmp2 + e * xx * y1;
+	const auto isect2_1 = tmp2 + f * xx * y0;
+	const bool disjoint = (max(isect1_0, isect1_1) < min(isect2_0, isect2_1) ||
+						   max(isect2_0, isect2_1) < min(isect1_0, isect1_1));
+	
+	return (!separated_a & !separated_b & valid_a & valid_b & !disjoint);
+}
+
+// computes the intersection segment (p0, p1) of two triangles that are known to intersect (-> check_triangle_intersection)
+// both triangles intersect each others plane in a segment on the common line L = N1 x N2,
+// the intersection segment is then the overlap of these two segments on L
+// returns false if no segment could be computed (coplanar or degenerate triangles)
+static bool compute_triangle_intersection_segment(const float3 v0_a, const float3 v1_a, const float3 v2_a,
+												  const float3 v0_b, const float3 v1_b, const float3 v2_b,
+												  float3& p0, float3& p1) {
+	// computes the segment in which triangle (v0, v1, v2) intersects a plane, given the signed vertex distances to it
+	const auto plane_segment = [](const float3& v0, const float3& v1, const float3& v2,
+								  const float& d0, const float& d1, const float& d2,
+								  float3& seg0, float3& seg1) {
+		uint32_t count = 0;
+		const auto add_point = [&count, &seg0, &seg1](const float3& point) {
+			if(count == 0) seg0 = point;
+			else seg1 = point;
+			++count;
+		};
+		const auto add_edge = [&add_point](const float3& va, const float3& vb, const float& da, const float& db) {
+			// strict sign change -> edge crosses the plane
+			if(da * db < 0.0f) {
+				add_point(va + (vb - va) * (da / (da - db)));
+			}
+		};
+		
+		// vertices on the plane
+		if(d0 == 0.0f) add_point(v0);
+		if(d1 == 0.0f) add_point(v1);
+		if(d2 == 0.0f) add_point(v2);
+		// edges crossing the plane
+		add_edge(v0, v1, d0, d1);
+		add_edge(v1, v2, d1, d2);
+		add_edge(v2, v0, d2, d0);
+		
+		// touching in a single point
+		if(count == 1) seg1 = seg0;
+		return (count >= 1 && count <= 2);
+	};
+	
+	static constexpr const float triangle_epsilon = 0.000001f;
+	const auto snap = [](const float& dist) {
+		return (abs(dist) < triangle_epsilon ? 0.0f : dist);
+	};
+	
+	const auto N1 = (v1_a - v0_a).cross(v2_a - v0_a);
+	const auto d1 = N1.dot(v0_a);
+	const auto N2 = (v1_b - v0_b).cross(v2_b - v0_b);
+	const auto d2 = N2.dot(v0_b);
+	const auto D = N1.crossed(N2);
+	if(D.dot(D) < triangle_epsilon * triangle_epsilon) {
+		return false; // coplanar
+	}
+	
+	// triangle a vs plane b, triangle b vs plane a
+	float3 a0, a1, b0, b1;
+	if(!plane_segment(v0_a, v1_a, v2_a,
+					  snap(N2.dot(v0_a) - d2), snap(N2.dot(v1_a) - d2), snap(N2.dot(v2_a) - d2),
+					  a0, a1)) {
+		return false;
+	}
+	if(!plane_segment(v0_b, v1_b, v2_b,
+					  snap(N1.dot(v0_b) - d1), snap(N1.dot(v1_b) - d1), snap(N1.dot(v2_b) - d1),
+					  b0, b1)) {
+		return false;
+	}
+	
+	// project onto L and sort each segment
+	const auto ta0 = D.dot(a0), ta1 = D.dot(a1);
+	const auto tb0 = D.dot(b0), tb1 = D.dot(b1);
+	const auto a_min = (ta0 <= ta1 ? a0 : a1), a_max = (ta0 <= ta1 ? a1 : a0);
+	const auto b_min = (tb0 <= tb1 ? b0 : b1), b_max = (tb0 <= tb1 ? b1 : b0);
+	
+	// overlap: [max(a_min, b_min), min(a_max, b_max)]
+	p0 = (min(ta0, ta1) > min(tb0, tb1) ? a_min : b_min);
+	p1 = (max(ta0, ta1) < max(tb0, tb1) ? a_max : b_max);
+	return true;
+}
+
 #endif
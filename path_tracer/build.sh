@@ -292,7 +292,10 @@ TARGET_BIN=${BIN_DIR}/${TARGET_BIN_NAME}
 SRC_DIR="src"
 
 # all source code sub-directories, relative to SRC_DIR
-SRC_SUB_DIRS="."
+SRC_SUB_DIRS=". ../../common/obj"
+
+# add common include folder (relative to .)
+INCLUDES="${INCLUDES} -I../common/obj"
 
 # build directory where all temporary files are stored (*.o, etc.)
 BUILD_DIR=
@@ -380,7 +383,7 @@ if [ $BUILD_OS != "osx" -a $BUILD_OS != "ios" ]; then
 	COMMON_FLAGS="${COMMON_FLAGS} -Xclang -mrelocation-model -Xclang pic -Xclang -pic-level -Xclang 2"
 	
 	# pkg-config: required libraries/packages and optional libraries/packages
-	PACKAGES="sdl2"
+	PACKAGES="sdl2 SDL2_image"
 	PACKAGES_OPT=""
 	if [ ${BUILD_CONF_NET} -gt 0 ]; then
 		PACKAGES_OPT="${PACKAGES_OPT} libcrypto libssl"
@@ -530,7 +533,7 @@ else
 	LDFLAGS="${LDFLAGS} -fobjc-link-runtime"
 	
 	# frameworks and libs
-	LDFLAGS="${LDFLAGS} -framework SDL2"
+	LDFLAGS="${LDFLAGS} -framework SDL2 -framework SDL2_image"
 	if [ ${BUILD_CONF_NET} -gt 0 ]; then
 		LDFLAGS="${LDFLAGS} -lcrypto -lssl"
 		LDFLAGS="${LDFLAGS} -Xlinker -rpath -Xlinker /usr/local/opt/openssl/lib"
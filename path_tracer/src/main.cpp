@@ -17,8 +17,941 @@
  */
 
 #include <floor/floor/floor.hpp>
+#include <floor/core/option_handler.hpp>
+#include <floor/core/timer.hpp>
+#include <floor/core/file_io.hpp>
+#include <floor/threading/task.hpp>
+#include "obj_loader.hpp"
+#include "path_tracer.hpp"
+
+// the cornell box data is shared with the device code (which puts it into constant memory)
+#define constant
+#include "cornell_box.hpp"
+#undef constant
+
+#if defined(__APPLE__)
+#include <SDL2_image/SDL_image.h>
+#elif defined(__WINDOWS__)
+#include <SDL2/SDL_image.h>
+#else
+#include <SDL_image.h>
+#endif
+
+struct path_tracer_option_context {
+	// unused
+	string additional_options { "" };
+};
+typedef option_handler<path_tracer_option_context> path_tracer_opt_handler;
+
+//! image size + camera of a rendered view
+struct render_view {
+	uint2 resolution;
+	float3 camera_position;
+	float3 camera_direction;
+	// vertical field of view in degrees
+	float fov;
+};
+
+static struct {
+	// .obj file that is placed inside the cornell box (instead of the two blocks)
+	string scene_file_name;
+	// use the wavefront kernels instead of the path_trace megakernel
+	bool wavefront { false };
+	// finish and time each wavefront stage separately
+	bool wavefront_profile { false };
+	// render parameters (see render_params)
+	uint2 resolution { 512, 512 };
+	float3 camera_position { 27.8f, 27.3f, -80.0f };
+	float3 camera_direction { 0.0f, 0.0f, 1.0f };
+	// vertical field of view in degrees
+	float fov { 35.0f };
+	// if set, all views in this file are rendered one after another (instead of the single view above)
+	string views_file_name;
+	uint32_t samples_per_pixel { 1u };
+	uint32_t max_depth { MAX_PATH_DEPTH };
+	// only traces pixels that haven't converged yet (see path_trace_adaptive)
+	bool adaptive { false };
+	// no window, progressive rendering until a stop criterion is reached, output is written to files
+	bool headless { false };
+	// stop criteria (0 = disabled): total samples per pixel, render time in seconds, noise threshold
+	uint32_t max_samples { 0u };
+	float time_budget { 0.0f };
+	float noise_threshold { 0.0f };
+	// output files (hdr .pfm and/or tonemapped .png)
+	string output_pfm_file_name;
+	string output_png_file_name;
+	// also write the output every N iterations (0 = only at the end)
+	uint32_t output_interval { 0u };
+	bool done { false };
+} path_tracer_state;
+
+// default iteration count when no sample budget is set
+static constexpr const uint32_t default_iteration_count { 16384 };
+// the noise estimate is computed every N iterations
+static constexpr const uint32_t noise_check_interval { 16 };
+// rendering stops once at most this fraction of all pixels is above the noise threshold
+static constexpr const float noise_max_pixel_fraction { 0.001f };
+// adaptive sampling: the active pixel list is rebuilt every N iterations
+static constexpr const uint32_t adaptive_update_interval { 8 };
+// adaptive sampling: per-pixel noise threshold when no --noise-threshold is set
+static constexpr const float adaptive_default_threshold { 0.02f };
+
+//! parses "x,y,z" into a float3, returns false if the string is malformed
+static bool parse_float3(const char* str, float3& ret) {
+	char trailing { 0 };
+	return (sscanf(str, "%f,%f,%f%c", &ret.x, &ret.y, &ret.z, &trailing) == 3);
+}
+
+//! parses a finite float, returns false if the string is malformed
+static bool parse_float(const char* str, float& ret) {
+	char* end { nullptr };
+	const auto value = strtof(str, &end);
+	if(end == str || *end != '\0' || !isfinite(value)) return false;
+	ret = value;
+	return true;
+}
+
+//! parses an unsigned 32-bit integer, returns false if the string is malformed or out of range
+static bool parse_uint(const char* str, uint32_t& ret) {
+	if(!isdigit((unsigned char)*str)) return false;
+	char* end { nullptr };
+	const auto value = strtoull(str, &end, 10);
+	if(*end != '\0' || value > 0xFFFFFFFFull) return false;
+	ret = (uint32_t)value;
+	return true;
+}
+
+// max image width/height
+static constexpr const uint32_t max_resolution { 16384u };
+
+//! parses "<width>x<height>", returns false if the string is malformed or the size is out of range
+static bool parse_resolution(const char* str, uint2& ret) {
+	uint2 resolution;
+	char trailing { 0 };
+	if(!isdigit((unsigned char)*str) || sscanf(str, "%ux%u%c", &resolution.x, &resolution.y, &trailing) != 2 ||
+	   resolution.x == 0 || resolution.y == 0 || resolution.x > max_resolution || resolution.y > max_resolution) {
+		return false;
+	}
+	ret = resolution;
+	return true;
+}
+
+//! option -> function map
+template<> vector<pair<string, path_tracer_opt_handler::option_function>> path_tracer_opt_handler::options {
+	{ "--help", [](path_tracer_option_context&, char**&) {
+		cout << "command line options:" << endl;
+		cout << "\t--scene <file.obj>: renders the specified .obj file inside the cornell box (scaled to fit, replaces the two blocks)" << endl;
+		cout << "\t--wavefront: renders with separate generate/extend/shade/connect kernels instead of a single path tracing kernel" << endl;
+		cout << "\t--wavefront-profile: waits for each wavefront stage and prints per-stage timings on exit (implies --wavefront)" << endl;
+		cout << "\t--resolution <width>x<height>: image size (default: 512x512, max: " << max_resolution << "x" << max_resolution << ")" << endl;
+		cout << "\t--camera-position <x,y,z>: camera position (default: 27.8,27.3,-80)" << endl;
+		cout << "\t--camera-direction <x,y,z>: camera view direction (default: 0,0,1)" << endl;
+		cout << "\t--fov <degrees>: vertical field of view, clamped to [1, 179] (default: 35)" << endl;
+		cout << "\t--views <file>: renders all views in the file with the same program and scene (headless only), one \"<width>x<height> <camera position> <camera direction> [fov]\" per line, output file names get a _<view index> suffix" << endl;
+		cout << "\t--spp <count>: paths per pixel and iteration, must be > 0 (default: 1)" << endl;
+		cout << "\t--max-depth <count>: max path segments incl. the camera ray (default and max w/o --wavefront: " << MAX_PATH_DEPTH << ")" << endl;
+		cout << "\t--adaptive: only traces pixels whose noise is above --noise-threshold (default: " << adaptive_default_threshold << ", not supported with --wavefront)" << endl;
+		cout << "\t--headless: renders without a window until a stop criterion is reached (requires --output and/or --output-png)" << endl;
+		cout << "\t--max-samples <count>: stops after this many samples per pixel (default: " << default_iteration_count << " iterations)" << endl;
+		cout << "\t--time-budget <seconds>: stops after this much render time (headless only)" << endl;
+		cout << "\t--noise-threshold <rel. error>: stops once the relative standard error of at most " << (noise_max_pixel_fraction * 100.0f) << "% of all pixels is above this (headless only), or the per-pixel threshold with --adaptive" << endl;
+		cout << "\t--output <file.pfm>: writes the hdr image to this file" << endl;
+		cout << "\t--output-png <file.png>: writes the tonemapped image to this file" << endl;
+		cout << "\t--output-interval <iterations>: also writes the output files every N iterations" << endl;
+		path_tracer_state.done = true;
+	}},
+	{ "--scene", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --scene!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		path_tracer_state.scene_file_name = *arg_ptr;
+		cout << "scene file set to: " << path_tracer_state.scene_file_name << endl;
+	}},
+	{ "--wavefront", [](path_tracer_option_context&, char**&) {
+		path_tracer_state.wavefront = true;
+		cout << "wavefront path tracing enabled" << endl;
+	}},
+	{ "--wavefront-profile", [](path_tracer_option_context&, char**&) {
+		path_tracer_state.wavefront = true;
+		path_tracer_state.wavefront_profile = true;
+		cout << "wavefront stage profiling enabled" << endl;
+	}},
+	{ "--resolution", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || !parse_resolution(*arg_ptr, path_tracer_state.resolution)) {
+			cerr << "invalid argument after --resolution!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		cout << "resolution set to: " << path_tracer_state.resolution.x << "x" << path_tracer_state.resolution.y << endl;
+	}},
+	{ "--camera-position", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || !parse_float3(*arg_ptr, path_tracer_state.camera_position)) {
+			cerr << "invalid argument after --camera-position!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		cout << "camera position set to: " << path_tracer_state.camera_position << endl;
+	}},
+	{ "--camera-direction", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || !parse_float3(*arg_ptr, path_tracer_state.camera_direction) ||
+		   path_tracer_state.camera_direction.is_null()) {
+			cerr << "invalid argument after --camera-direction!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		cout << "camera direction set to: " << path_tracer_state.camera_direction << endl;
+	}},
+	{ "--fov", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		float fov { 0.0f };
+		if(*arg_ptr == nullptr || !parse_float(*arg_ptr, fov)) {
+			cerr << "invalid argument after --fov!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		path_tracer_state.fov = const_math::clamp(fov, 1.0f, 179.0f);
+		cout << "fov set to: " << path_tracer_state.fov << endl;
+	}},
+	{ "--views", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --views!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		path_tracer_state.views_file_name = *arg_ptr;
+		cout << "views file set to: " << path_tracer_state.views_file_name << endl;
+	}},
+	{ "--spp", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		uint32_t samples_per_pixel { 0u };
+		if(*arg_ptr == nullptr || !parse_uint(*arg_ptr, samples_per_pixel) || samples_per_pixel == 0) {
+			cerr << "invalid argument after --spp!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		path_tracer_state.samples_per_pixel = samples_per_pixel;
+		cout << "samples per pixel set to: " << path_tracer_state.samples_per_pixel << endl;
+	}},
+	{ "--max-depth", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		uint32_t max_depth { 0u };
+		if(*arg_ptr == nullptr || !parse_uint(*arg_ptr, max_depth)) {
+			cerr << "invalid argument after --max-depth!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		path_tracer_state.max_depth = max(max_depth, 1u);
+		cout << "max path depth set to: " << path_tracer_state.max_depth << endl;
+	}},
+	{ "--adaptive", [](path_tracer_option_context&, char**&) {
+		path_tracer_state.adaptive = true;
+		cout << "adaptive sampling enabled" << endl;
+	}},
+	{ "--headless", [](path_tracer_option_context&, char**&) {
+		path_tracer_state.headless = true;
+		cout << "headless mode enabled" << endl;
+	}},
+	{ "--max-samples", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || !parse_uint(*arg_ptr, path_tracer_state.max_samples)) {
+			cerr << "invalid argument after --max-samples!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		cout << "max samples set to: " << path_tracer_state.max_samples << endl;
+	}},
+	{ "--time-budget", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || !parse_float(*arg_ptr, path_tracer_state.time_budget) ||
+		   path_tracer_state.time_budget < 0.0f) {
+			cerr << "invalid argument after --time-budget!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		cout << "time budget set to: " << path_tracer_state.time_budget << "s" << endl;
+	}},
+	{ "--noise-threshold", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || !parse_float(*arg_ptr, path_tracer_state.noise_threshold) ||
+		   path_tracer_state.noise_threshold < 0.0f) {
+			cerr << "invalid argument after --noise-threshold!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		cout << "noise threshold set to: " << path_tracer_state.noise_threshold << endl;
+	}},
+	{ "--output", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --output!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		path_tracer_state.output_pfm_file_name = *arg_ptr;
+		cout << "output file set to: " << path_tracer_state.output_pfm_file_name << endl;
+	}},
+	{ "--output-png", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --output-png!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		path_tracer_state.output_png_file_name = *arg_ptr;
+		cout << "png output file set to: " << path_tracer_state.output_png_file_name << endl;
+	}},
+	{ "--output-interval", [](path_tracer_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || !parse_uint(*arg_ptr, path_tracer_state.output_interval)) {
+			cerr << "invalid argument after --output-interval!" << endl;
+			path_tracer_state.done = true;
+			return;
+		}
+		cout << "output interval set to: " << path_tracer_state.output_interval << endl;
+	}},
+	// ignore xcode debug arg
+	{ "-NSDocumentRevisionsDebugMode", [](path_tracer_option_context&, char**&) {} },
+};
+
+//! host-side scene data, this is uploaded to the device as-is
+struct scene_data {
+	// 3 vertices per triangle (.w is unused), in bvh leaf order once the bvh has been built
+	vector<float4> triangles;
+	vector<uint32_t> triangle_materials;
+	vector<material> materials;
+	vector<bvh_node> bvh_nodes;
+};
+
+//! adds the cornell box triangles and materials (material indices are the CORNELL_OBJECT values)
+static void add_cornell_box(scene_data& scene, const bool with_blocks) {
+	for(uint32_t triangle_idx = 0; triangle_idx < size(cornell_indices); ++triangle_idx) {
+		const auto object = cornell_object_map[triangle_idx];
+		if(!with_blocks && (object == CORNELL_OBJECT::SHORT_BLOCK || object == CORNELL_OBJECT::TALL_BLOCK)) {
+			continue;
+		}
+		const auto& index = cornell_indices[triangle_idx];
+		scene.triangles.emplace_back(cornell_vertices[index.x]);
+		scene.triangles.emplace_back(cornell_vertices[index.y]);
+		scene.triangles.emplace_back(cornell_vertices[index.z]);
+		scene.triangle_materials.emplace_back((uint32_t)object);
+	}
+	for(const auto& mat : cornell_materials) {
+		scene.materials.emplace_back(mat);
+	}
+}
+
+//! loads an .obj file and adds all of its triangles to the scene, uniformly scaled and translated so that
+//! the model stands on the cornell box floor and fits below the light (uses the short block material)
+static bool add_obj_model(scene_data& scene, const string& file_name,
+						  shared_ptr<compute_context> ctx, shared_ptr<compute_device> dev) {
+	bool success { false };
+	const auto model = obj_loader::load(file_name, success, ctx, dev, 0.1f,
+										false /* keep cpu data */, false /* no textures */, false /* no gpu buffers */);
+	if(!success || model == nullptr) {
+		log_error("failed to load scene %s", file_name);
+		return false;
+	}
+	
+	// only consider referenced vertices (vertex #0 is a dummy)
+	float3 model_min { numeric_limits<float>::max() }, model_max { -numeric_limits<float>::max() };
+	size_t triangle_count { 0u };
+	for(const auto& obj : model->objects) {
+		for(const auto& index : obj->indices) {
+			for(const auto& vertex_idx : { index.x, index.y, index.z }) {
+				model_min = model_min.minned(model->vertices[vertex_idx]);
+				model_max = model_max.maxed(model->vertices[vertex_idx]);
+			}
+		}
+		triangle_count += obj->indices.size();
+	}
+	if(triangle_count == 0) {
+		log_error("scene %s contains no triangles", file_name);
+		return false;
+	}
+	
+	static constexpr const float3 fit_min { 5.0f, 0.0f, 5.0f }, fit_max { 50.0f, 40.0f, 50.0f };
+	const auto model_extent = (model_max - model_min).maxed(const_math::EPSILON<float>);
+	const auto scale = ((fit_max - fit_min) / model_extent).min_element();
+	const float3 translation {
+		(fit_min.x + fit_max.x) * 0.5f - (model_min.x + model_max.x) * 0.5f * scale,
+		fit_min.y - model_min.y * scale,
+		(fit_min.z + fit_max.z) * 0.5f - (model_min.z + model_max.z) * 0.5f * scale,
+	};
+	
+	scene.triangles.reserve(scene.triangles.size() + triangle_count * 3u);
+	scene.triangle_materials.reserve(scene.triangle_materials.size() + triangle_count);
+	for(const auto& obj : model->objects) {
+		for(const auto& index : obj->indices) {
+			for(const auto& vertex_idx : { index.x, index.y, index.z }) {
+				scene.triangles.emplace_back(model->vertices[vertex_idx] * scale + translation, 1.0f);
+			}
+			scene.triangle_materials.emplace_back((uint32_t)CORNELL_OBJECT::SHORT_BLOCK);
+		}
+	}
+	log_msg("loaded scene %s: %u triangles", file_name, triangle_count);
+	return true;
+}
+
+//! per-triangle data that is only needed during the bvh build
+struct bvh_build_triangle {
+	float3 aabb_min;
+	float3 aabb_max;
+	float3 centroid;
+};
+
+//! recursively builds the subtree for triangle_indices[begin, end) using a binned sah split,
+//! nodes are emitted in depth-first order, so that the left child always directly follows its parent
+static void build_bvh_node(vector<bvh_node>& nodes,
+						   const vector<bvh_build_triangle>& build_triangles,
+						   vector<uint32_t>& triangle_indices,
+						   const uint32_t begin, const uint32_t end, const uint32_t depth) {
+	float3 aabb_min { numeric_limits<float>::max() }, aabb_max { -numeric_limits<float>::max() };
+	float3 centroid_min { numeric_limits<float>::max() }, centroid_max { -numeric_limits<float>::max() };
+	for(uint32_t i = begin; i < end; ++i) {
+		const auto& tri = build_triangles[triangle_indices[i]];
+		aabb_min = aabb_min.minned(tri.aabb_min);
+		aabb_max = aabb_max.maxed(tri.aabb_max);
+		centroid_min = centroid_min.minned(tri.centroid);
+		centroid_max = centroid_max.maxed(tri.centroid);
+	}
+	
+	// start out as a leaf
+	const auto node_idx = (uint32_t)nodes.size();
+	const auto count = end - begin;
+	nodes.emplace_back(bvh_node { aabb_min, begin, aabb_max, count });
+	if(count <= BVH_MAX_LEAF_TRIANGLES || depth + 1u >= BVH_MAX_DEPTH) {
+		return;
+	}
+	
+	// find the split with the lowest sah cost over all axes and bin boundaries
+	struct sah_bin {
+		float3 aabb_min { numeric_limits<float>::max() };
+		float3 aabb_max { -numeric_limits<float>::max() };
+		uint32_t count { 0u };
+		
+		void merge(const sah_bin& bin) {
+			aabb_min = aabb_min.minned(bin.aabb_min);
+			aabb_max = aabb_max.maxed(bin.aabb_max);
+			count += bin.count;
+		}
+		float surface_area() const {
+			const auto extent = aabb_max - aabb_min;
+			return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+	};
+	const auto centroid_extent = centroid_max - centroid_min;
+	const auto bin_index = [&centroid_min, &centroid_extent](const float3& centroid, const uint32_t axis) {
+		const auto bin = uint32_t((centroid[axis] - centroid_min[axis]) * (float(BVH_SAH_BIN_COUNT) / centroid_extent[axis]));
+		return min(bin, BVH_SAH_BIN_COUNT - 1u);
+	};
+	float best_cost { numeric_limits<float>::max() };
+	uint32_t best_axis { ~0u }, best_split { 0u };
+	for(uint32_t axis = 0; axis < 3; ++axis) {
+		if(centroid_extent[axis] <= 0.0f) continue;
+		
+		array<sah_bin, BVH_SAH_BIN_COUNT> bins {};
+		for(uint32_t i = begin; i < end; ++i) {
+			const auto& tri = build_triangles[triangle_indices[i]];
+			auto& bin = bins[bin_index(tri.centroid, axis)];
+			bin.merge(sah_bin { tri.aabb_min, tri.aabb_max, 1u });
+		}
+		
+		// sweep from the right to get the area/count right of each boundary, then sweep from the left and evaluate
+		array<float, BVH_SAH_BIN_COUNT - 1u> right_areas;
+		array<uint32_t, BVH_SAH_BIN_COUNT - 1u> right_counts;
+		sah_bin right;
+		for(uint32_t i = BVH_SAH_BIN_COUNT - 1u; i > 0; --i) {
+			right.merge(bins[i]);
+			right_areas[i - 1u] = right.surface_area();
+			right_counts[i - 1u] = right.count;
+		}
+		sah_bin left;
+		for(uint32_t i = 0; i < BVH_SAH_BIN_COUNT - 1u; ++i) {
+			left.merge(bins[i]);
+			if(left.count == 0 || right_counts[i] == 0) continue;
+			const auto cost = float(left.count) * left.surface_area() + float(right_counts[i]) * right_areas[i];
+			if(cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_split = i;
+			}
+		}
+	}
+	// all centroids are identical -> can't split
+	if(best_axis == ~0u) {
+		return;
+	}
+	
+	// keep the leaf if splitting doesn't pay off (costs are relative to intersecting one triangle, with the split cost
+	// normalized by the surface area of this node)
+	const auto leaf_cost = float(count);
+	const auto node_area = sah_bin { aabb_min, aabb_max, count }.surface_area();
+	const auto split_cost = BVH_SAH_TRAVERSAL_COST + (node_area > 0.0f ? best_cost / node_area : 0.0f);
+	if(count <= BVH_SAH_MAX_LEAF_TRIANGLES && split_cost >= leaf_cost) {
+		return;
+	}
+	
+	const auto is_left = [&](const uint32_t& triangle_idx) {
+		return (bin_index(build_triangles[triangle_idx].centroid, best_axis) <= best_split);
+	};
+	const auto mid = (uint32_t)(partition(triangle_indices.begin() + begin, triangle_indices.begin() + end, is_left) -
+								triangle_indices.begin());
+	
+	build_bvh_node(nodes, build_triangles, triangle_indices, begin, mid, depth + 1u);
+	const auto right_idx = (uint32_t)nodes.size();
+	build_bvh_node(nodes, build_triangles, triangle_indices, mid, end, depth + 1u);
+	nodes[node_idx].offset = right_idx;
+	nodes[node_idx].count = 0u;
+}
+
+//! builds the bvh of all scene triangles and reorders the triangles (and their materials) into leaf order
+static bool build_bvh(scene_data& scene) {
+	const auto triangle_count = (uint32_t)scene.triangle_materials.size();
+	if(triangle_count == 0) {
+		log_error("can't build a bvh for an empty scene");
+		return false;
+	}
+	
+	vector<bvh_build_triangle> build_triangles;
+	build_triangles.reserve(triangle_count);
+	vector<uint32_t> triangle_indices(triangle_count);
+	for(uint32_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx) {
+		const auto& v0 = scene.triangles[triangle_idx * 3u].xyz;
+		const auto& v1 = scene.triangles[triangle_idx * 3u + 1u].xyz;
+		const auto& v2 = scene.triangles[triangle_idx * 3u + 2u].xyz;
+		build_triangles.emplace_back(bvh_build_triangle {
+			v0.minned(v1).minned(v2),
+			v0.maxed(v1).maxed(v2),
+			(v0 + v1 + v2) * (1.0f / 3.0f),
+		});
+		triangle_indices[triangle_idx] = triangle_idx;
+	}
+	
+	scene.bvh_nodes.clear();
+	scene.bvh_nodes.reserve(triangle_count * 2u);
+	build_bvh_node(scene.bvh_nodes, build_triangles, triangle_indices, 0, triangle_count, 0);
+	
+	vector<float4> triangles(scene.triangles.size());
+	vector<uint32_t> triangle_materials(triangle_count);
+	for(uint32_t i = 0; i < triangle_count; ++i) {
+		const auto triangle_idx = triangle_indices[i];
+		triangles[i * 3u] = scene.triangles[triangle_idx * 3u];
+		triangles[i * 3u + 1u] = scene.triangles[triangle_idx * 3u + 1u];
+		triangles[i * 3u + 2u] = scene.triangles[triangle_idx * 3u + 2u];
+		triangle_materials[i] = scene.triangle_materials[triangle_idx];
+	}
+	scene.triangles.swap(triangles);
+	scene.triangle_materials.swap(triangle_materials);
+	
+	log_msg("built bvh: %u triangles, %u nodes", triangle_count, scene.bvh_nodes.size());
+	return true;
+}
+
+//! computes the camera frame for the given image size (the fov is vertical, the horizontal fov follows the aspect ratio)
+static render_params make_render_params(const uint2& size,
+										const float3& position,
+										const float3& direction,
+										const float fov,
+										const uint32_t samples_per_pixel,
+										const uint32_t max_depth) {
+	const auto forward = direction.normalized();
+	// use +z as the reference up vector when looking straight up or down
+	const float3 world_up { fabs(forward.y) > 0.999f ? float3 { 0.0f, 0.0f, 1.0f } : float3 { 0.0f, 1.0f, 0.0f } };
+	const auto right = forward.crossed(world_up).normalized();
+	const auto up = -right.crossed(forward).normalized();
+	const auto tan_half_fov = tan(const_math::deg_to_rad(fov) * 0.5f);
+	const auto up_vector = 2.0f * up * tan_half_fov;
+	const auto row_vector = 2.0f * right * tan_half_fov * (float(size.x) / float(size.y));
+	return {
+		.camera_origin = position,
+		.width = size.x,
+		.screen_origin = forward - row_vector * 0.5f - up_vector * 0.5f,
+		.height = size.y,
+		.step_x = row_vector / float(size.x),
+		.samples_per_pixel = samples_per_pixel,
+		.step_y = up_vector / float(size.y),
+		.max_depth = max_depth,
+	};
+}
+
+//! loads a views file, each line is:
+//!  <width>x<height> <camera position x,y,z> <camera direction x,y,z> [fov]
+//! empty lines and lines starting with '#' are ignored, the fov defaults to --fov
+static bool load_views(const string& file_name, vector<render_view>& views) {
+	string views_data;
+	if(!file_io::file_to_string(file_name, views_data)) {
+		log_error("failed to read views file %s", file_name);
+		return false;
+	}
+	
+	stringstream lines(views_data);
+	string line;
+	for(uint32_t line_num = 1; getline(lines, line); ++line_num) {
+		stringstream tokens(line);
+		string resolution, position, direction, fov;
+		if(!(tokens >> resolution) || resolution[0] == '#') continue;
+		
+		render_view view { {}, {}, {}, path_tracer_state.fov };
+		if(!(tokens >> position >> direction) ||
+		   !parse_resolution(resolution.c_str(), view.resolution) ||
+		   !parse_float3(position.c_str(), view.camera_position) ||
+		   !parse_float3(direction.c_str(), view.camera_direction) || view.camera_direction.is_null()) {
+			log_error("%s:%u: invalid view (expected: <width>x<height> <camera position x,y,z> <camera direction x,y,z> [fov])",
+					  file_name, line_num);
+			return false;
+		}
+		if(tokens >> fov && !parse_float(fov.c_str(), view.fov)) {
+			log_error("%s:%u: invalid fov \"%s\"", file_name, line_num, fov);
+			return false;
+		}
+		view.fov = const_math::clamp(view.fov, 1.0f, 179.0f);
+		views.emplace_back(view);
+	}
+	
+	if(views.empty()) {
+		log_error("views file %s doesn't contain any views", file_name);
+		return false;
+	}
+	return true;
+}
+
+// path tracer output needs gamma correction (fixed 2.2), otherwise it'll look too dark
+static uchar3 gamma_correct(const float3& color) {
+	static constexpr const float gamma { 2.2f };
+	const float3 gamma_corrected { (color.powed(1.0f / gamma) * 255.0f).clamp(0.0f, 255.0f) };
+	return uchar3 { (uint8_t)gamma_corrected.x, (uint8_t)gamma_corrected.y, (uint8_t)gamma_corrected.z };
+}
+
+//! writes the rgb part of the image as a little endian .pfm file (rows are stored bottom to top)
+static bool write_pfm(const string& file_name, const vector<float4>& img, const uint2& size) {
+	string data = "PF\n" + to_string(size.x) + " " + to_string(size.y) + "\n-1.0\n";
+	const auto header_size = data.size();
+	data.resize(header_size + size_t(size.x) * size_t(size.y) * 3u * sizeof(float));
+	auto pixel_data = (float*)&data[header_size];
+	for(uint32_t y = size.y; y > 0; --y) {
+		const auto row = &img[size_t(y - 1u) * size.x];
+		for(uint32_t x = 0; x < size.x; ++x) {
+			*pixel_data++ = row[x].x;
+			*pixel_data++ = row[x].y;
+			*pixel_data++ = row[x].z;
+		}
+	}
+	if(!file_io::string_to_file(file_name, data)) {
+		log_error("failed to write %s", file_name);
+		return false;
+	}
+	return true;
+}
+
+//! writes the image gamma corrected (same as the window output) as a .png file
+static bool write_png(const string& file_name, const vector<float4>& img, const uint2& size) {
+	auto surface = SDL_CreateRGBSurfaceWithFormat(0, (int)size.x, (int)size.y, 24, SDL_PIXELFORMAT_RGB24);
+	if(surface == nullptr) {
+		log_error("failed to create png surface: %s", SDL_GetError());
+		return false;
+	}
+	for(uint32_t y = 0; y < size.y; ++y) {
+		auto px_ptr = (uint8_t*)surface->pixels + size_t(surface->pitch) * y;
+		for(uint32_t x = 0; x < size.x; ++x) {
+			const auto rgb = gamma_correct(img[size_t(y) * size.x + x].xyz);
+			*px_ptr++ = rgb.x;
+			*px_ptr++ = rgb.y;
+			*px_ptr++ = rgb.z;
+		}
+	}
+	const auto ret = IMG_SavePNG(surface, file_name.c_str());
+	SDL_FreeSurface(surface);
+	if(ret != 0) {
+		log_error("failed to write %s: %s", file_name, IMG_GetError());
+		return false;
+	}
+	return true;
+}
+
+//! output files of a view (empty if not requested)
+struct output_file_names {
+	string pfm;
+	string png;
+};
+
+//! returns the output files of the specified view, with multiple views, "_<view index>" is inserted before the extension
+static output_file_names make_output_file_names(const uint32_t view_idx, const uint32_t view_count) {
+	const auto add_view_suffix = [view_idx, view_count](const string& file_name) {
+		if(file_name.empty() || view_count <= 1) return file_name;
+		const auto suffix = "_" + to_string(view_idx);
+		const auto ext_pos = file_name.rfind('.');
+		const auto dir_pos = file_name.find_last_of("/\\");
+		if(ext_pos == string::npos || (dir_pos != string::npos && ext_pos < dir_pos)) {
+			return file_name + suffix;
+		}
+		return file_name.substr(0, ext_pos) + suffix + file_name.substr(ext_pos);
+	};
+	return {
+		add_view_suffix(path_tracer_state.output_pfm_file_name),
+		add_view_suffix(path_tracer_state.output_png_file_name),
+	};
+}
+
+// amount of output writes that are currently in flight
+static atomic<uint32_t> active_writers { 0u };
+
+//! writes all requested output files on a separate thread
+static void write_output_async(shared_ptr<vector<float4>> img, const uint2& size, const output_file_names& file_names,
+							   const uint32_t sample_count) {
+	++active_writers;
+	task::spawn([img, size, file_names, sample_count] {
+		if(!file_names.pfm.empty()) {
+			write_pfm(file_names.pfm, *img, size);
+		}
+		if(!file_names.png.empty()) {
+			write_png(file_names.png, *img, size);
+		}
+		log_msg("wrote output (%u samples per pixel)", sample_count);
+		--active_writers;
+	});
+}
+
+//! reads back the image and writes it asynchronously (if a previous write is still in flight, this is skipped,
+//! unless wait is set, in which case this waits for all writes to finish, including this one)
+//! NOTE: the read back itself blocks the render thread until the image is complete, only the file writing is async
+static void write_output(shared_ptr<compute_queue> dev_queue, const shared_ptr<compute_buffer>& img_buffer,
+						 const uint2& size, const output_file_names& file_names, const uint32_t sample_count,
+						 const bool wait) {
+	if(file_names.pfm.empty() && file_names.png.empty()) {
+		return;
+	}
+	const auto wait_for_writers = [] {
+		while(active_writers != 0) {
+			this_thread::sleep_for(10ms);
+		}
+	};
+	if(wait) wait_for_writers();
+	else if(active_writers != 0) return;
+	
+	auto img = make_shared<vector<float4>>(size_t(size.x) * size_t(size.y));
+	img_buffer->read(dev_queue, img->data(), sizeof(float4) * img->size());
+	write_output_async(img, size, file_names, sample_count);
+	if(wait) wait_for_writers();
+}
+
+//! device-side scene data (see bvh_intersector)
+struct scene_buffers {
+	shared_ptr<compute_buffer> triangles;
+	shared_ptr<compute_buffer> triangle_materials;
+	shared_ptr<compute_buffer> bvh_nodes;
+	shared_ptr<compute_buffer> materials;
+};
+
+//! kernels and path state/queue buffers of the wavefront path tracer (see "wavefront path tracing" in path_tracer.cpp)
+struct wavefront_pipeline {
+	enum class STAGE : uint32_t {
+		GENERATE,
+		EXTEND,
+		SHADE,
+		CONNECT,
+		ACCUMULATE,
+		__MAX_STAGE
+	};
+	const array<const char*, size_t(STAGE::__MAX_STAGE)> stage_names {{
+		"generate", "extend", "shade", "connect", "accumulate"
+	}};
+	array<shared_ptr<compute_kernel>, size_t(STAGE::__MAX_STAGE)> kernels;
+	
+	// path state (SoA, one entry per path == pixel)
+	shared_ptr<compute_buffer> ray_origins;
+	shared_ptr<compute_buffer> ray_directions;
+	shared_ptr<compute_buffer> throughputs;
+	shared_ptr<compute_buffer> radiances;
+	shared_ptr<compute_buffer> seeds;
+	shared_ptr<compute_buffer> hit_normals;
+	shared_ptr<compute_buffer> hit_materials;
+	shared_ptr<compute_buffer> shadow_origins;
+	shared_ptr<compute_buffer> shadow_directions;
+	shared_ptr<compute_buffer> shadow_contributions;
+	
+	// queues + their sizes (extension queues alternate between the current and the next bounce)
+	array<shared_ptr<compute_buffer>, 2> extension_queues;
+	array<shared_ptr<compute_buffer>, 2> extension_queue_sizes;
+	shared_ptr<compute_buffer> shading_queue;
+	shared_ptr<compute_buffer> shading_queue_size;
+	shared_ptr<compute_buffer> shadow_queue;
+	shared_ptr<compute_buffer> shadow_queue_size;
+	
+	// accumulated time per stage in us (only recorded when profiling)
+	array<uint64_t, size_t(STAGE::__MAX_STAGE)> stage_times {};
+	
+	uint32_t path_count { 0u };
+	
+	bool init(shared_ptr<compute_context> ctx, shared_ptr<compute_device> dev, shared_ptr<compute_program> prog,
+			  const uint32_t path_count_) {
+		path_count = path_count_;
+		for(uint32_t i = 0; i < uint32_t(STAGE::__MAX_STAGE); ++i) {
+			kernels[i] = prog->get_kernel(string("wavefront_") + stage_names[i]);
+			if(kernels[i] == nullptr) {
+				log_error("failed to retrieve kernel wavefront_%s from program", stage_names[i]);
+				return false;
+			}
+		}
+		
+		const auto float4_buffer = [&ctx, &dev, this]() {
+			return ctx->create_buffer(dev, sizeof(float4) * path_count);
+		};
+		const auto uint_buffer = [&ctx, &dev](const uint32_t count) {
+			return ctx->create_buffer(dev, sizeof(uint32_t) * count);
+		};
+		ray_origins = float4_buffer();
+		ray_directions = float4_buffer();
+		throughputs = float4_buffer();
+		radiances = float4_buffer();
+		seeds = uint_buffer(path_count);
+		hit_normals = float4_buffer();
+		hit_materials = uint_buffer(path_count);
+		shadow_origins = float4_buffer();
+		shadow_directions = float4_buffer();
+		shadow_contributions = float4_buffer();
+		for(uint32_t i = 0; i < 2; ++i) {
+			extension_queues[i] = uint_buffer(path_count);
+			extension_queue_sizes[i] = uint_buffer(1);
+		}
+		shading_queue = uint_buffer(path_count);
+		shading_queue_size = uint_buffer(1);
+		shadow_queue = uint_buffer(path_count);
+		shadow_queue_size = uint_buffer(1);
+		return true;
+	}
+	
+	//! renders params.samples_per_pixel samples per pixel and merges them into img_buffer
+	void render(shared_ptr<compute_queue> dev_queue, shared_ptr<compute_device> dev,
+				const shared_ptr<compute_buffer>& img_buffer, const scene_buffers& scene,
+				const render_params& params, const uint32_t iteration, const bool profile) {
+		// each sample is a separate pass through all stages, with its own sample index for seeding and re-weighting
+		for(uint32_t sample = 0; sample < params.samples_per_pixel; ++sample) {
+			render_sample(dev_queue, dev, img_buffer, scene, params, iteration * params.samples_per_pixel + sample,
+						  core::rand<uint32_t>(), profile);
+		}
+	}
+	
+	void render_sample(shared_ptr<compute_queue> dev_queue, shared_ptr<compute_device> dev,
+					   const shared_ptr<compute_buffer>& img_buffer, const scene_buffers& scene,
+					   const render_params& params, const uint32_t sample_idx, const uint32_t seed, const bool profile) {
+		// all stages are launched for all paths (see path_tracer.cpp)
+		const auto run_stage = [&](const STAGE stage, auto&&... args) {
+			const auto start_time = floor_timer::start();
+			dev_queue->execute(kernels[size_t(stage)],
+							   uint1 { path_count },
+							   uint1 { dev->max_total_local_size },
+							   forward<decltype(args)>(args)...);
+			if(profile) {
+				dev_queue->finish();
+				stage_times[size_t(stage)] += floor_timer::stop<chrono::microseconds>(start_time);
+			}
+		};
+		
+		run_stage(STAGE::GENERATE, sample_idx, seed, params,
+				  ray_origins, ray_directions, throughputs, radiances, seeds,
+				  extension_queues[0], extension_queue_sizes[0]);
+		for(uint32_t depth = 0; depth < params.max_depth; ++depth) {
+			const auto cur = depth & 1u, next = cur ^ 1u;
+			shading_queue_size->zero(dev_queue);
+			shadow_queue_size->zero(dev_queue);
+			extension_queue_sizes[next]->zero(dev_queue);
+			
+			run_stage(STAGE::EXTEND,
+					  extension_queues[cur], extension_queue_sizes[cur],
+					  ray_origins, ray_directions, hit_normals, hit_materials,
+					  shading_queue, shading_queue_size,
+					  scene.triangles, scene.triangle_materials, scene.bvh_nodes);
+			run_stage(STAGE::SHADE, depth, params,
+					  shading_queue, shading_queue_size,
+					  ray_origins, ray_directions, hit_normals, hit_materials, throughputs, radiances, seeds,
+					  shadow_origins, shadow_directions, shadow_contributions,
+					  shadow_queue, shadow_queue_size,
+					  extension_queues[next], extension_queue_sizes[next],
+					  scene.materials);
+			run_stage(STAGE::CONNECT,
+					  shadow_queue, shadow_queue_size,
+					  shadow_origins, shadow_directions, shadow_contributions, radiances,
+					  scene.triangles, scene.triangle_materials, scene.bvh_nodes, scene.materials);
+		}
+		run_stage(STAGE::ACCUMULATE, img_buffer, sample_idx, params, radiances);
+	}
+	
+	void log_stage_times(const uint32_t iteration_count) const {
+		if(iteration_count == 0) return;
+		uint64_t total_time { 0u };
+		for(uint32_t i = 0; i < uint32_t(STAGE::__MAX_STAGE); ++i) {
+			log_msg("wavefront %s: %f ms per iteration", stage_names[i], double(stage_times[i]) / double(iteration_count * 1000u));
+			total_time += stage_times[i];
+		}
+		log_msg("wavefront total: %f ms per iteration", double(total_time) / double(iteration_count * 1000u));
+	}
+};
 
 int main(int, char* argv[]) {
+	// handle options
+	path_tracer_option_context option_ctx;
+	path_tracer_opt_handler::parse_options(argv + 1, option_ctx);
+	if(path_tracer_state.done) return 0;
+	
+	// the path_trace kernel recurses at compile-time and can't go deeper than MAX_PATH_DEPTH
+	if(!path_tracer_state.wavefront && path_tracer_state.max_depth > MAX_PATH_DEPTH) {
+		cerr << "--max-depth > " << MAX_PATH_DEPTH << " requires --wavefront, using " << MAX_PATH_DEPTH << endl;
+		path_tracer_state.max_depth = MAX_PATH_DEPTH;
+	}
+	if(path_tracer_state.headless &&
+	   path_tracer_state.output_pfm_file_name.empty() && path_tracer_state.output_png_file_name.empty()) {
+		cerr << "--headless requires --output and/or --output-png" << endl;
+		return -1;
+	}
+	if(!path_tracer_state.output_pfm_file_name.empty() &&
+	   (path_tracer_state.output_pfm_file_name.size() < 4 ||
+		core::str_to_lower(path_tracer_state.output_pfm_file_name.substr(path_tracer_state.output_pfm_file_name.size() - 4)) != ".pfm")) {
+		cerr << "only .pfm is supported as --output format" << endl;
+		return -1;
+	}
+	if(path_tracer_state.adaptive && path_tracer_state.wavefront) {
+		cerr << "--adaptive is not supported with --wavefront, disabling adaptive sampling" << endl;
+		path_tracer_state.adaptive = false;
+	}
+	if(!path_tracer_state.headless && path_tracer_state.time_budget > 0.0f) {
+		cerr << "--time-budget is only supported in --headless mode" << endl;
+		path_tracer_state.time_budget = 0.0f;
+	}
+	if(!path_tracer_state.headless && !path_tracer_state.adaptive && path_tracer_state.noise_threshold > 0.0f) {
+		cerr << "--noise-threshold is only supported in --headless or --adaptive mode" << endl;
+		path_tracer_state.noise_threshold = 0.0f;
+	}
+	if(path_tracer_state.adaptive && path_tracer_state.noise_threshold <= 0.0f) {
+		path_tracer_state.noise_threshold = adaptive_default_threshold;
+	}
+	
+	// all views that are rendered (the program and scene are only built once and are shared by all of them)
+	vector<render_view> views;
+	if(!path_tracer_state.views_file_name.empty()) {
+		if(!path_tracer_state.headless) {
+			cerr << "--views is only supported in --headless mode" << endl;
+			return -1;
+		}
+		if(!load_views(path_tracer_state.views_file_name, views)) {
+			return -1;
+		}
+	}
+	else {
+		views.emplace_back(render_view {
+			path_tracer_state.resolution,
+			path_tracer_state.camera_position,
+			path_tracer_state.camera_direction,
+			path_tracer_state.fov,
+		});
+	}
+	
 	if(!floor::init(floor::init_state {
 		.call_path = argv[0],
 #if !defined(FLOOR_IOS)
@@ -27,7 +960,9 @@ int main(int, char* argv[]) {
 		.data_path = "data/",
 #endif
 		.app_name = "path tracer",
-		// NOTE: don't need a specific renderer here, so just use the defaults
+		.console_only = path_tracer_state.headless,
+		// NOTE: don't need a specific renderer here, so just use the defaults (or none when running headless)
+		.renderer = (path_tracer_state.headless ? floor::RENDERER::NONE : floor::RENDERER::DEFAULT),
 	})) {
 		return -1;
 	}
@@ -39,17 +974,17 @@ int main(int, char* argv[]) {
 	auto fastest_device = compute_ctx->get_device(compute_device::TYPE::FASTEST);
 	auto dev_queue = compute_ctx->create_queue(fastest_device);
 	
-	//
-	static const uint2 img_size { 512, 512 }; // fixed for now, b/c random function makes this look horrible at higher res
-	static const uint32_t pixel_count { img_size.x * img_size.y };
-	floor::set_screen_size(img_size);
+	// there is only a single view when rendering to a window
+	if(!path_tracer_state.headless) {
+		floor::set_screen_size(views[0].resolution);
+	}
 	
 	// compile the program and get the kernel function
+	// NOTE: all per-render parameters are passed at runtime, so the program doesn't depend on resolution/camera/etc.
+	//       and is reused for all views
 #if !defined(FLOOR_IOS)
 	auto path_tracer_prog = compute_ctx->add_program_file(floor::data_path("../path_tracer/src/path_tracer.cpp"),
-														  "-I" + floor::data_path("../path_tracer/src") +
-														  " -DSCREEN_WIDTH=" + to_string(img_size.x) +
-														  " -DSCREEN_HEIGHT=" + to_string(img_size.y));
+														  "-I" + floor::data_path("../path_tracer/src"));
 #else
 	// for now: use a precompiled metal lib instead of compiling at runtime
 	const vector<llvm_toolchain::function_info> function_infos {
@@ -60,8 +995,158 @@ int main(int, char* argv[]) {
 				llvm_toolchain::function_info::arg_info { .size = 16 },
 				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
 				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(bvh_node) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(material) },
 			}
-		}
+		},
+		{
+			"wavefront_generate",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+			}
+		},
+		{
+			"wavefront_extend",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(bvh_node) },
+			}
+		},
+		{
+			"wavefront_shade",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(material) },
+			}
+		},
+		{
+			"wavefront_connect",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(bvh_node) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(material) },
+			}
+		},
+		{
+			"wavefront_accumulate",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+			}
+		},
+		{
+			"path_trace_adaptive",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(bvh_node) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(material) },
+			}
+		},
+		{
+			"count_active_pixels",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+			}
+		},
+		{
+			"active_pixels_prefix_sum",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+			}
+		},
+		{
+			"compact_active_pixels",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+			}
+		},
+		{
+			"count_noisy_pixels",
+			llvm_toolchain::function_info::FUNCTION_TYPE::KERNEL,
+			{
+				llvm_toolchain::function_info::arg_info { .size = sizeof(float4) },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(render_params), llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = 4, llvm_toolchain::function_info::ARG_ADDRESS_SPACE::CONSTANT },
+				llvm_toolchain::function_info::arg_info { .size = sizeof(uint32_t) },
+			}
+		},
 	};
 	auto path_tracer_prog = compute_ctx->add_precompiled_program_file(floor::data_path("path_tracer.metallib"), function_infos);
 #endif
@@ -75,71 +1160,259 @@ int main(int, char* argv[]) {
 		return -1;
 	}
 	
-	// create the image buffer on the device
-	auto img_buffer = compute_ctx->create_buffer(fastest_device, sizeof(float4) * pixel_count);
+	// build the scene + its bvh on the host and upload everything
+	scene_data scene;
+	add_cornell_box(scene, path_tracer_state.scene_file_name.empty());
+	if(!path_tracer_state.scene_file_name.empty() &&
+	   !add_obj_model(scene, path_tracer_state.scene_file_name, compute_ctx, fastest_device)) {
+		return -1;
+	}
+	if(!build_bvh(scene)) {
+		return -1;
+	}
+	const scene_buffers scene_bufs {
+		.triangles = compute_ctx->create_buffer(fastest_device, sizeof(float4) * scene.triangles.size(),
+												(void*)scene.triangles.data()),
+		.triangle_materials = compute_ctx->create_buffer(fastest_device, sizeof(uint32_t) * scene.triangle_materials.size(),
+														 (void*)scene.triangle_materials.data()),
+		.bvh_nodes = compute_ctx->create_buffer(fastest_device, sizeof(bvh_node) * scene.bvh_nodes.size(),
+												(void*)scene.bvh_nodes.data()),
+		.materials = compute_ctx->create_buffer(fastest_device, sizeof(material) * scene.materials.size(),
+												(void*)scene.materials.data()),
+	};
 	
+	// render all views (only the image size and render parameters differ between them)
 	bool done = false;
-	static constexpr const uint32_t iteration_count { 16384 };
-	for(uint32_t iteration = 0; iteration < iteration_count; ++iteration) {
-		dev_queue->execute(path_tracer_kernel,
-						   // total amount of work:
-						   uint1 { pixel_count },
-						   // work per work-group:
-						   uint1 { fastest_device->max_total_local_size },
-						   // kernel arguments:
-						   img_buffer, iteration, core::rand<uint32_t>());
-
-		// draw every 10th frame (except for the first 10 frames)
-		if(iteration < 10 || iteration % 10 == 0) {
-			// grab the current image buffer data (read-only + blocking) ...
-			auto img_data = (float4*)img_buffer->map(dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
-
-			// path tracer output needs gamma correction (fixed 2.2), otherwise it'll look too dark
-			const auto gamma_correct = [](const float3& color) {
-				static constexpr const float gamma { 2.2f };
-				const float3 gamma_corrected { (color.powed(1.0f / gamma) * 255.0f).clamp(0.0f, 255.0f) };
-				return uchar3 { (uint8_t)gamma_corrected.x, (uint8_t)gamma_corrected.y, (uint8_t)gamma_corrected.z };
-			};
-			
-			// ... and blit it into the window
-			// (crude and I'd usually do this via GL, but this way it's not a requirement)
-			const auto wnd_surface = SDL_GetWindowSurface(floor::get_window());
-			SDL_LockSurface(wnd_surface);
-			const uint2 render_dim = img_size.minned(uint2 { floor::get_width(), floor::get_height() });
-			for(uint32_t y = 0; y < render_dim.y; ++y) {
-				uint32_t* px_ptr = (uint32_t*)wnd_surface->pixels + ((size_t)wnd_surface->pitch / sizeof(uint32_t)) * y;
-				uint32_t img_idx = img_size.x * y;
-				for(uint32_t x = 0; x < render_dim.x; ++x, ++img_idx) {
-					// map and gamma correct each pixel according to the window format
-					const auto rgb = gamma_correct(img_data[img_idx].xyz);
-					*px_ptr++ = SDL_MapRGB(wnd_surface->format, rgb.x, rgb.y, rgb.z);
-				}
+	for(uint32_t view_idx = 0; view_idx < uint32_t(views.size()) && !done; ++view_idx) {
+		const auto& view = views[view_idx];
+		if(views.size() > 1) {
+			log_msg("rendering view #%u (%ux%u)", view_idx, view.resolution.x, view.resolution.y);
+		}
+		const auto output_files = make_output_file_names(view_idx, uint32_t(views.size()));
+		const uint2 img_size { view.resolution };
+		const uint32_t pixel_count { img_size.x * img_size.y };
+		const auto params = make_render_params(img_size, view.camera_position, view.camera_direction, view.fov,
+											   path_tracer_state.samples_per_pixel, path_tracer_state.max_depth);
+		
+		// create the image buffer on the device
+		auto img_buffer = compute_ctx->create_buffer(fastest_device, sizeof(float4) * pixel_count);
+		
+		wavefront_pipeline wavefront;
+		if(path_tracer_state.wavefront && !wavefront.init(compute_ctx, fastest_device, path_tracer_prog, pixel_count)) {
+			return -1;
+		}
+		
+		// adaptive sampling: per-pixel sample counts (mean and second moment are stored in the image) + active pixel list
+		shared_ptr<compute_kernel> path_trace_adaptive_kernel;
+		shared_ptr<compute_kernel> count_active_pixels_kernel, active_pixels_prefix_sum_kernel, compact_active_pixels_kernel;
+		shared_ptr<compute_buffer> sample_counts_buffer, active_pixels_buffer, active_pixel_count_buffer, active_counts_buffer;
+		uint32_t active_pixel_count { pixel_count };
+		// each work-group of the active pixel compaction handles a contiguous range of this many pixels
+		const uint32_t adaptive_pixels_per_group {
+			(pixel_count + ADAPTIVE_COMPACTION_GROUP_COUNT - 1u) / ADAPTIVE_COMPACTION_GROUP_COUNT
+		};
+		if(path_tracer_state.adaptive) {
+			path_trace_adaptive_kernel = path_tracer_prog->get_kernel("path_trace_adaptive");
+			count_active_pixels_kernel = path_tracer_prog->get_kernel("count_active_pixels");
+			active_pixels_prefix_sum_kernel = path_tracer_prog->get_kernel("active_pixels_prefix_sum");
+			compact_active_pixels_kernel = path_tracer_prog->get_kernel("compact_active_pixels");
+			if(path_trace_adaptive_kernel == nullptr || count_active_pixels_kernel == nullptr ||
+			   active_pixels_prefix_sum_kernel == nullptr || compact_active_pixels_kernel == nullptr) {
+				log_error("failed to retrieve adaptive sampling kernels from program");
+				return -1;
 			}
-			img_buffer->unmap(dev_queue, img_data);
-			
-			SDL_UnlockSurface(wnd_surface);
-			SDL_UpdateWindowSurface(floor::get_window());
+			sample_counts_buffer = compute_ctx->create_buffer(fastest_device, sizeof(uint32_t) * pixel_count);
+			active_pixels_buffer = compute_ctx->create_buffer(fastest_device, sizeof(uint32_t) * pixel_count);
+			active_pixel_count_buffer = compute_ctx->create_buffer(fastest_device, sizeof(uint32_t));
+			active_counts_buffer = compute_ctx->create_buffer(fastest_device, sizeof(uint32_t) * ADAPTIVE_COMPACTION_GROUP_COUNT);
+			sample_counts_buffer->zero(dev_queue);
+		}
+		
+		// noise estimate (only needed when there is a noise threshold, adaptive sampling uses the active pixel count instead)
+		shared_ptr<compute_kernel> count_noisy_pixels_kernel;
+		shared_ptr<compute_buffer> noisy_pixel_count_buffer;
+		if(path_tracer_state.noise_threshold > 0.0f && !path_tracer_state.adaptive) {
+			count_noisy_pixels_kernel = path_tracer_prog->get_kernel("count_noisy_pixels");
+			if(count_noisy_pixels_kernel == nullptr) {
+				log_error("failed to retrieve kernel count_noisy_pixels from program");
+				return -1;
+			}
+			noisy_pixel_count_buffer = compute_ctx->create_buffer(fastest_device, sizeof(uint32_t));
 		}
-		floor::set_caption("frame #" + to_string(iteration + 1));
 		
-		// handle quit event
-		SDL_Event event_handle;
-		while(SDL_PollEvent(&event_handle)) {
-			if(event_handle.type == SDL_QUIT) {
-				done = true;
-				break;
-			}
-			else if(event_handle.type == SDL_KEYDOWN) {
-				switch(event_handle.key.keysym.sym) {
-					case SDLK_q:
-					case SDLK_ESCAPE:
-						done = true;
+		// samples that are merged into each pixel per iteration (the wavefront pipeline merges each sample separately)
+		const uint32_t samples_per_iteration { params.samples_per_pixel };
+		const uint32_t merged_samples_per_iteration { path_tracer_state.wavefront ? params.samples_per_pixel : 1u };
+		const uint32_t iteration_count {
+			path_tracer_state.max_samples > 0 ?
+			max((path_tracer_state.max_samples + samples_per_iteration - 1u) / samples_per_iteration, 1u) :
+			default_iteration_count
+		};
+		const auto render_start = floor_timer::start();
+		
+		// iterations that have actually been rendered (the stop criteria may end the loop before rendering an iteration)
+		uint32_t rendered_iterations { 0u };
+		for(uint32_t iteration = 0; iteration < iteration_count; ++iteration) {
+			if(path_tracer_state.wavefront) {
+				wavefront.render(dev_queue, fastest_device, img_buffer, scene_bufs, params,
+								 iteration, path_tracer_state.wavefront_profile);
+				++rendered_iterations;
+			}
+			else if(path_tracer_state.adaptive) {
+				// rebuild the active pixel list (all pixels are active until they have ADAPTIVE_MIN_SAMPLES samples)
+				if(iteration % adaptive_update_interval == 0) {
+					// order-preserving stream compaction: per-group counts -> scan -> scatter
+					dev_queue->execute(count_active_pixels_kernel,
+									   uint1 { ADAPTIVE_COMPACTION_GROUP_COUNT * ADAPTIVE_COMPACTION_GROUP_SIZE },
+									   uint1 { ADAPTIVE_COMPACTION_GROUP_SIZE },
+									   img_buffer, sample_counts_buffer, params, path_tracer_state.noise_threshold,
+									   adaptive_pixels_per_group, active_counts_buffer);
+					dev_queue->execute(active_pixels_prefix_sum_kernel,
+									   uint1 { ADAPTIVE_COMPACTION_GROUP_COUNT },
+									   uint1 { ADAPTIVE_COMPACTION_GROUP_COUNT },
+									   active_counts_buffer);
+					dev_queue->execute(compact_active_pixels_kernel,
+									   uint1 { ADAPTIVE_COMPACTION_GROUP_COUNT * ADAPTIVE_COMPACTION_GROUP_SIZE },
+									   uint1 { ADAPTIVE_COMPACTION_GROUP_SIZE },
+									   img_buffer, sample_counts_buffer, params, path_tracer_state.noise_threshold,
+									   adaptive_pixels_per_group, active_counts_buffer,
+									   active_pixels_buffer, active_pixel_count_buffer);
+					active_pixel_count_buffer->read(dev_queue, &active_pixel_count, sizeof(uint32_t));
+					
+					if(path_tracer_state.headless && float(active_pixel_count) <= noise_max_pixel_fraction * float(pixel_count)) {
+						log_msg("noise threshold reached (%u active pixels)", active_pixel_count);
 						break;
-					default: break;
+					}
 				}
+				
+				if(active_pixel_count > 0) {
+					const auto local_size = fastest_device->max_total_local_size;
+					dev_queue->execute(path_trace_adaptive_kernel,
+									   // only launch for the active pixels (rounded up to the work-group size)
+									   uint1 { ((active_pixel_count + local_size - 1u) / local_size) * local_size },
+									   uint1 { local_size },
+									   img_buffer, sample_counts_buffer, active_pixels_buffer, active_pixel_count_buffer,
+									   iteration, core::rand<uint32_t>(), params,
+									   scene_bufs.triangles, scene_bufs.triangle_materials, scene_bufs.bvh_nodes, scene_bufs.materials);
+					++rendered_iterations;
+				}
+			}
+			else {
+				dev_queue->execute(path_tracer_kernel,
+								   // total amount of work:
+								   uint1 { pixel_count },
+								   // work per work-group:
+								   uint1 { fastest_device->max_total_local_size },
+								   // kernel arguments:
+								   img_buffer, iteration, core::rand<uint32_t>(), params,
+								   scene_bufs.triangles, scene_bufs.triangle_materials, scene_bufs.bvh_nodes, scene_bufs.materials);
+				++rendered_iterations;
 			}
+
+			if(path_tracer_state.output_interval > 0 && (iteration + 1) % path_tracer_state.output_interval == 0 &&
+			   iteration + 1 < iteration_count) {
+				write_output(dev_queue, img_buffer, img_size, output_files, rendered_iterations * samples_per_iteration, false);
+			}
+			
+			if(path_tracer_state.headless) {
+				// with a time budget: wait for this iteration, so that the elapsed time is accurate
+				// (otherwise, the queue is free to run ahead and only synchronizes on the noise estimate and output reads)
+				if(path_tracer_state.time_budget > 0.0f) {
+					dev_queue->finish();
+					if(double(floor_timer::stop<chrono::milliseconds>(render_start)) >= double(path_tracer_state.time_budget) * 1000.0) {
+						log_msg("time budget reached");
+						break;
+					}
+				}
+				
+				if(count_noisy_pixels_kernel != nullptr && (iteration + 1) % noise_check_interval == 0) {
+					noisy_pixel_count_buffer->zero(dev_queue);
+					dev_queue->execute(count_noisy_pixels_kernel,
+									   uint1 { pixel_count },
+									   uint1 { fastest_device->max_total_local_size },
+									   img_buffer, params, (iteration + 1) * merged_samples_per_iteration,
+									   path_tracer_state.noise_threshold, noisy_pixel_count_buffer);
+					uint32_t noisy_pixel_count { 0u };
+					noisy_pixel_count_buffer->read(dev_queue, &noisy_pixel_count, sizeof(uint32_t));
+					if(float(noisy_pixel_count) <= noise_max_pixel_fraction * float(pixel_count)) {
+						log_msg("noise threshold reached (%u noisy pixels)", noisy_pixel_count);
+						break;
+					}
+				}
+				continue;
+			}
+			
+			// draw every 10th frame (except for the first 10 frames)
+			if(iteration < 10 || iteration % 10 == 0) {
+				// grab the current image buffer data (read-only + blocking) ...
+				auto img_data = (float4*)img_buffer->map(dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+				
+				// ... and blit it into the window
+				// (crude and I'd usually do this via GL, but this way it's not a requirement)
+				const auto wnd_surface = SDL_GetWindowSurface(floor::get_window());
+				SDL_LockSurface(wnd_surface);
+				const uint2 render_dim = img_size.minned(uint2 { floor::get_width(), floor::get_height() });
+				for(uint32_t y = 0; y < render_dim.y; ++y) {
+					uint32_t* px_ptr = (uint32_t*)wnd_surface->pixels + ((size_t)wnd_surface->pitch / sizeof(uint32_t)) * y;
+					uint32_t img_idx = img_size.x * y;
+					for(uint32_t x = 0; x < render_dim.x; ++x, ++img_idx) {
+						// map and gamma correct each pixel according to the window format
+						const auto rgb = gamma_correct(img_data[img_idx].xyz);
+						*px_ptr++ = SDL_MapRGB(wnd_surface->format, rgb.x, rgb.y, rgb.z);
+					}
+				}
+				img_buffer->unmap(dev_queue, img_data);
+				
+				SDL_UnlockSurface(wnd_surface);
+				SDL_UpdateWindowSurface(floor::get_window());
+			}
+			floor::set_caption("frame #" + to_string(iteration + 1));
+			
+			// handle quit event
+			SDL_Event event_handle;
+			while(SDL_PollEvent(&event_handle)) {
+				if(event_handle.type == SDL_QUIT) {
+					done = true;
+					break;
+				}
+				else if(event_handle.type == SDL_KEYDOWN) {
+					switch(event_handle.key.keysym.sym) {
+						case SDLK_q:
+						case SDLK_ESCAPE:
+							done = true;
+							break;
+						default: break;
+					}
+				}
+			}
+			if(done) break;
+		}
+		// the queue may still be running ahead
+		dev_queue->finish();
+		const auto render_time = double(floor_timer::stop<chrono::milliseconds>(render_start)) / 1000.0;
+		uint32_t rendered_samples { rendered_iterations * samples_per_iteration };
+		if(path_tracer_state.adaptive) {
+			// pixels have been sampled at different rates -> report the actual average
+			// (each merged adaptive sample consists of samples_per_pixel paths)
+			vector<uint32_t> sample_counts(pixel_count);
+			sample_counts_buffer->read(dev_queue, sample_counts.data(), sizeof(uint32_t) * pixel_count);
+			uint64_t sample_count_sum { 0u };
+			for(const auto& sample_count : sample_counts) {
+				sample_count_sum += sample_count;
+			}
+			const auto avg_samples = double(sample_count_sum * samples_per_iteration) / double(pixel_count);
+			log_msg("rendered %f samples per pixel on average (at most %u) in %fs", avg_samples, rendered_samples, render_time);
+			rendered_samples = uint32_t(round(avg_samples));
+		}
+		else {
+			log_msg("rendered %u samples per pixel in %fs", rendered_samples, render_time);
 		}
-		if(done) break;
+		if(path_tracer_state.wavefront_profile) {
+			wavefront.log_stage_times(rendered_iterations);
+		}
+		
+		// write the final image (and wait for all writes)
+		write_output(dev_queue, img_buffer, img_size, output_files, rendered_samples, true);
 	}
 	log_msg("done!");
 	
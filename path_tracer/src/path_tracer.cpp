@@ -21,6 +21,7 @@
 #if defined(FLOOR_COMPUTE)
 
 // to keep things simple in here, the cornell box model and material data is located in another file
+// (the actual scene geometry is built on the host and passed in via buffers, see bvh_intersector)
 #include "cornell_box.hpp"
 
 struct ray {
@@ -31,68 +32,124 @@ struct ray {
 // need a larger epsilon in some cases (than the one defined by const_math::EPSILON<float>)
 #define INTERSECTION_EPS 0.0001f
 
-class simple_intersector {
+class bvh_intersector {
 public:
+	static constexpr const uint32_t invalid_material { ~0u };
+	
 	struct intersection {
 		const float3 hit_point;
 		const float3 normal;
 		const float distance;
-		const CORNELL_OBJECT object;
+		const uint32_t material_idx;
 	};
 	
-	// to keep things simple, do a simple O(n) intersection here (well, O(32), so constant ;))
-	// NOTE: will assume we're only intersecting the cornell box data here, so the vertices/indices
-	// don't have to be carried around the whole time (this will/should work with anything though)
-	static intersection intersect(const ray& r) {
+	// triangles are stored as 3 consecutive vertices (in bvh leaf order), with one material index per triangle
+	bvh_intersector(buffer<const float4> triangles_,
+					 buffer<const uint32_t> triangle_materials_,
+					 buffer<const bvh_node> bvh_nodes_) :
+	triangles(triangles_), triangle_materials(triangle_materials_), bvh_nodes(bvh_nodes_) {}
+	
+	// stack-based bvh traversal: always descend into the nearer child first and push the farther one,
+	// children that are farther away than the current closest hit are skipped
+	intersection intersect(const ray& r) const {
 		float3 normal;
 		float distance { numeric_limits<float>::infinity() };
-		CORNELL_OBJECT object { CORNELL_OBJECT::__OBJECT_INVALID };
+		uint32_t material_idx { invalid_material };
 		
-		for(uint32_t triangle_idx = 0; triangle_idx < size(cornell_indices); ++triangle_idx) {
-			const auto& index = cornell_indices[triangle_idx];
-			const auto& v0 = cornell_vertices[index.x];
-			const auto& v1 = cornell_vertices[index.y];
-			const auto& v2 = cornell_vertices[index.z];
-	
-			const auto e1 = v0.xyz - v2.xyz, e2 = v1.xyz - v2.xyz;
-			const auto pvec = r.direction.crossed(e2);
-			const auto det = e1.dot(pvec);
-			if(fabs(det) <= const_math::EPSILON<float>) continue;
-			
-			const auto inv_det = 1.0f / det;
-			const auto tvec = r.origin - v2.xyz;
-			const auto qvec = tvec.crossed(e1);
-			
-			float3 ip;
-			ip.x = tvec.dot(pvec) * inv_det;
-			ip.y = r.direction.dot(qvec) * inv_det;
-			ip.z = 1.0f - ip.x - ip.y;
-			
-			if((ip < 0.0f).any()) continue;
-			
-			const auto idist = e2.dot(qvec) * inv_det;
-			if(idist >= INTERSECTION_EPS && idist < distance) {
-				normal = e1.crossed(e2).normalized();
-				distance = idist;
-				object = cornell_object_map[triangle_idx];
+		const float3 inv_dir { 1.0f / r.direction };
+		uint32_t stack[BVH_MAX_DEPTH];
+		uint32_t stack_size { 0u };
+		uint32_t node_idx { 0u };
+		if(intersect_aabb(bvh_nodes[0], r, inv_dir, distance) == numeric_limits<float>::infinity()) {
+			return { {}, {}, distance, material_idx };
+		}
+		for(;;) {
+			const auto& node = bvh_nodes[node_idx];
+			if(node.count > 0u) {
+				for(uint32_t triangle_idx = node.offset; triangle_idx < node.offset + node.count; ++triangle_idx) {
+					const auto& v0 = triangles[triangle_idx * 3u];
+					const auto& v1 = triangles[triangle_idx * 3u + 1u];
+					const auto& v2 = triangles[triangle_idx * 3u + 2u];
+					
+					const auto e1 = v0.xyz - v2.xyz, e2 = v1.xyz - v2.xyz;
+					const auto pvec = r.direction.crossed(e2);
+					const auto det = e1.dot(pvec);
+					if(fabs(det) <= const_math::EPSILON<float>) continue;
+					
+					const auto inv_det = 1.0f / det;
+					const auto tvec = r.origin - v2.xyz;
+					const auto qvec = tvec.crossed(e1);
+					
+					float3 ip;
+					ip.x = tvec.dot(pvec) * inv_det;
+					ip.y = r.direction.dot(qvec) * inv_det;
+					ip.z = 1.0f - ip.x - ip.y;
+					
+					if((ip < 0.0f).any()) continue;
+					
+					const auto idist = e2.dot(qvec) * inv_det;
+					if(idist >= INTERSECTION_EPS && idist < distance) {
+						normal = e1.crossed(e2).normalized();
+						distance = idist;
+						material_idx = triangle_materials[triangle_idx];
+					}
+				}
+			}
+			else {
+				const auto left_idx = node_idx + 1u, right_idx = node.offset;
+				const auto left_dist = intersect_aabb(bvh_nodes[left_idx], r, inv_dir, distance);
+				const auto right_dist = intersect_aabb(bvh_nodes[right_idx], r, inv_dir, distance);
+				const bool hit_left = (left_dist != numeric_limits<float>::infinity());
+				const bool hit_right = (right_dist != numeric_limits<float>::infinity());
+				if(hit_left && hit_right) {
+					const bool left_first = (left_dist <= right_dist);
+					stack[stack_size++] = (left_first ? right_idx : left_idx);
+					node_idx = (left_first ? left_idx : right_idx);
+					continue;
+				}
+				else if(hit_left || hit_right) {
+					node_idx = (hit_left ? left_idx : right_idx);
+					continue;
+				}
 			}
+			
+			// leaf or no child was hit -> continue with the next node on the stack
+			if(stack_size == 0u) break;
+			node_idx = stack[--stack_size];
 		}
 		
 		return {
 			.hit_point = r.origin + r.direction * distance,
 			.normal = normal,
 			.distance = distance,
-			.object = object,
+			.material_idx = material_idx,
 		};
 	}
 	
+protected:
+	buffer<const float4> triangles;
+	buffer<const uint32_t> triangle_materials;
+	buffer<const bvh_node> bvh_nodes;
+	
+	//! slab test, returns the entry distance or infinity if the aabb isn't hit before max_distance
+	static float intersect_aabb(const bvh_node& node, const ray& r, const float3& inv_dir, const float max_distance) {
+		const auto t0 = (node.aabb_min - r.origin) * inv_dir;
+		const auto t1 = (node.aabb_max - r.origin) * inv_dir;
+		const auto t_near = max(t0.minned(t1).max_element(), 0.0f);
+		const auto t_far = t0.maxed(t1).min_element();
+		if(t_near > t_far || t_near >= max_distance) {
+			return numeric_limits<float>::infinity();
+		}
+		return t_near;
+	}
+	
 };
 
-class simple_path_tracer {
+//! samples lights and bounce directions at a single hit point and carries the random state of a path
+//! (shared by the megakernel path tracer and the wavefront shading kernel)
+class path_sampler {
 public:
-	enum : uint32_t { max_recursion_depth = 3 };
-	
-	simple_path_tracer(const uint32_t& random_seed) : seed(random_seed) {}
+	path_sampler(const uint32_t& random_seed) : seed(random_seed) {}
 	
 	// not the best random, but simple and good enough
 	// ref: http://iquilezles.org/www/articles/sfrand/sfrand.htm
@@ -104,76 +161,110 @@ public:
 		return (res - 1.0f);
 	}
 	
-	// if you can't do normal recursion, do some template recursion instead! (at the cost of code bloat)
-	// also: can do this inside a single function now with c++17
-	template <uint32_t depth = 0
-#if !defined(FLOOR_CXX17)
-			  , enable_if_t<depth < max_recursion_depth>* = nullptr
-#endif
-			  >
-	float3 compute_radiance(const ray& r, const bool sample_emission) {
-#if defined(FLOOR_CXX17)
-		if constexpr(depth >= max_recursion_depth) {
-			return {};
-		}
-		else
-#endif
-		{
-			// intersect
-			const auto p = simple_intersector::intersect(r);
-			if(p.object >= CORNELL_OBJECT::__OBJECT_INVALID) return {};
-			
-			//
-			float3 radiance;
-			const auto& mat = cornell_materials[(size_t)p.object];
-			
-			// emission (don't oversample for indirect illumination)
-			if(sample_emission) radiance += mat.emission.xyz;
-			
-			// compute direct illumination at given point
-			radiance += compute_direct_illumination(-r.direction, p, mat);
-			
-			// indirect
-			radiance += compute_indirect_illumination<depth>(r, p, mat);
+	//! returns the current random state (so that a path can be continued in another kernel)
+	uint32_t get_seed() const {
+		return seed;
+	}
+	
+	struct light_sample {
+		//! shadow ray towards the sampled point on the light source
+		const ray shadow_ray;
+		//! distance to the sampled point
+		const float distance;
+		//! contribution if the sampled point is visible
+		const float3 contribution;
+	};
+	light_sample sample_direct_illumination(const float3& eye_direction,
+											const float3& hit_point,
+											const float3& hit_normal,
+											const material& mat) {
+		const auto norm_surface = hit_normal.normalized();
+		const auto norm_eye_dir = eye_direction.normalized();
+		
+		// usually a loop over all light sources, but we only have one here
+		constexpr const struct light_source {
+			const float3 position { 34.3f, 54.8f, 22.7f };
+			const float3 normal { 0.0f, -1.0f, 0.0f }; // down
+			const float3 edge_1 { 0.0f, 0.0f, 33.2f - 22.7f };
+			const float3 edge_2 { 21.3f - 34.3f, 0.0f, 0.0f };
+			const float3 intensity {
+				cornell_materials[size_t(CORNELL_OBJECT::LIGHT)].emission.x,
+				cornell_materials[size_t(CORNELL_OBJECT::LIGHT)].emission.y,
+				cornell_materials[size_t(CORNELL_OBJECT::LIGHT)].emission.z
+			};
+			const float area { edge_1.crossed(edge_2).length() };
 			
-			return radiance;
+			constexpr float3 get_point(const float2& coord) const {
+				return position + coord.x * edge_1 + coord.y * edge_2;
+			}
+			constexpr float get_area() const {
+				return area;
+			}
+		} light {};
+		
+		// generate a random position on the lightsource
+		const auto sample_point = light.get_point(float2 { rand_0_1(), rand_0_1() });
+		
+		// shadow ray towards the light
+		const auto dir = sample_point - hit_point;
+		const auto dist_sqr = max(dir.dot(dir), INTERSECTION_EPS);
+		const ray r { hit_point, dir.normalized() };
+		
+		// falloff formula: (.x falloff / dist^2) * intensity
+		const auto attenuation = 1.0f / dist_sqr; // here: 1 / dist^2
+		const auto elvis = max(-light.normal.dot(r.direction), 0.0f); // actually -r.d
+		const auto lambert = max(norm_surface.dot(r.direction), 0.0f);
+		
+		// diffuse
+		float3 illum = mat.diffuse_reflectance.xyz;
+		
+		// specular (only do the computation if it actually has a spec coeff > 0)
+		if(!mat.specular.is_null()) {
+			const auto R = (-r.direction).reflect(norm_surface).normalize();
+			illum += (mat.specular_reflectance.xyz *
+					  pow(max(R.dot(norm_eye_dir), 0.0f), mat.specular.w));
 		}
+		
+		// mul by intensity and mul single floats separately
+		illum *= light.intensity * (elvis * lambert * light.get_area() * attenuation);
+		
+		return { r, sqrt(dist_sqr), illum };
 	}
 	
-#if !defined(FLOOR_CXX17)
-	// terminator
-	template <uint32_t depth, enable_if_t<depth >= max_recursion_depth>* = nullptr>
-	float3 compute_radiance(const ray&, const bool) {
-		return {};
+	//! returns true if the shadow ray of a light sample didn't hit anything before the light
+	//! (hitting anything emissive also counts as reaching the light)
+	static bool is_light_visible(const float light_distance,
+								 const bvh_intersector::intersection& shadow_hit,
+								 buffer<const material> materials) {
+		return (shadow_hit.material_idx == bvh_intersector::invalid_material ||
+				shadow_hit.distance >= light_distance - INTERSECTION_EPS ||
+				!materials[shadow_hit.material_idx].emission.is_null());
 	}
-#endif
-	
-protected:
-	uint32_t seed;
-	
-	struct hemisphere_dir_type { const float3 dir; const float prob; };
 	
-	template <uint32_t depth>
-	float3 compute_indirect_illumination(const ray& r,
-										 const simple_intersector::intersection& p,
-										 const material& mat) {
+	struct bounce_sample {
+		//! continuation ray of the path
+		const ray next_ray;
+		//! factor by which the radiance along next_ray contributes (0 -> terminate the path)
+		const float3 weight;
+	};
+	bounce_sample sample_indirect_illumination(const ray& r,
+											   const float3& hit_point,
+											   const float3& hit_normal,
+											   const material& mat) {
 		// get the normal (check if it has to be flipped - rarely happens, but it does)
-		const auto normal = (p.normal.dot(r.direction) > 0.0f ? -p.normal : p.normal);
+		const auto normal = (hit_normal.dot(r.direction) > 0.0f ? -hit_normal : hit_normal);
 		
 		// albedo (pd, ps) (note that (albedo_diffuse + albedo_specular) will always be <= 1)
 		const auto albedo_diffuse = mat.diffuse.dot(float3 { 0.222f, 0.7067f, 0.0713f });
 		const auto albedo_specular = mat.specular.dot(float3 { 0.222f, 0.7067f, 0.0713f });
 		
-		float3 radiance;
 		// c++14 generic lambdas work as well ;)
-		const auto radiance_recurse = [this, &radiance](const auto& albedo,
-														const auto& dir_and_prob,
-														const auto& point) {
-			// no need to recurse if the radiance is already 0
-			if(radiance.x > 0.0f || radiance.y > 0.0f || radiance.z > 0.0f) {
-				radiance *= compute_radiance<depth + 1>(ray { point, dir_and_prob.dir }, false);
-				radiance /= (albedo * dir_and_prob.prob);
+		const auto make_bounce = [&hit_point](float3 weight, const auto& albedo, const auto& dir_and_prob) -> bounce_sample {
+			// no need to continue if the weight is already 0
+			if(weight.x > 0.0f || weight.y > 0.0f || weight.z > 0.0f) {
+				weight /= (albedo * dir_and_prob.prob);
 			}
+			return { ray { hit_point, dir_and_prob.dir }, weight };
 		};
 		
 		// russian roulette with albedo and random value in [0, 1]
@@ -183,9 +274,9 @@ protected:
 			const auto dir_and_prob = generate_cosine_weighted_direction(normal, tb.first, tb.second,
 																		 { rand_0_1(), rand_0_1() });
 			
-			radiance = mat.diffuse_reflectance.xyz;
-			radiance *= max(normal.dot(dir_and_prob.dir), 0.0f);
-			radiance_recurse(albedo_diffuse, dir_and_prob, p.hit_point);
+			float3 weight = mat.diffuse_reflectance.xyz;
+			weight *= max(normal.dot(dir_and_prob.dir), 0.0f);
+			return make_bounce(weight, albedo_diffuse, dir_and_prob);
 		}
 		else if(rrr < (albedo_diffuse + albedo_specular)) {
 			const auto rnormal = r.direction.reflected(normal).normalized();
@@ -196,86 +287,22 @@ protected:
 			
 			// "reject directions below the surface" (or in it)
 			if(normal.dot(dir_and_prob.dir) <= 0.0f) {
-				return {};
+				return { r, {} };
 			}
 			
-			radiance = mat.specular_reflectance.xyz;
-			radiance *= pow(max(rnormal.dot(dir_and_prob.dir), 0.0f), mat.specular.w);
-			radiance *= max(normal.dot(dir_and_prob.dir), 0.0f);
-			radiance_recurse(albedo_specular, dir_and_prob, p.hit_point);
+			float3 weight = mat.specular_reflectance.xyz;
+			weight *= pow(max(rnormal.dot(dir_and_prob.dir), 0.0f), mat.specular.w);
+			weight *= max(normal.dot(dir_and_prob.dir), 0.0f);
+			return make_bounce(weight, albedo_specular, dir_and_prob);
 		}
 		// else: rrr is 1.0f and the contribution is 0
-		
-		// we're done here
-		return radiance;
+		return { r, {} };
 	}
 	
-	float3 compute_direct_illumination(const float3& eye_direction,
-									   const simple_intersector::intersection& p,
-									   const material& mat) {
-		float3 retval;
-		
-		const auto norm_surface = p.normal.normalized();
-		const auto norm_eye_dir = eye_direction.normalized();
-		
-		// usually a loop over all light sources, but we only have one here
-		constexpr const struct light_source {
-			const float3 position { 34.3f, 54.8f, 22.7f };
-			const float3 normal { 0.0f, -1.0f, 0.0f }; // down
-			const float3 edge_1 { 0.0f, 0.0f, 33.2f - 22.7f };
-			const float3 edge_2 { 21.3f - 34.3f, 0.0f, 0.0f };
-			const float3 intensity {
-				cornell_materials[size_t(CORNELL_OBJECT::LIGHT)].emission.x,
-				cornell_materials[size_t(CORNELL_OBJECT::LIGHT)].emission.y,
-				cornell_materials[size_t(CORNELL_OBJECT::LIGHT)].emission.z
-			};
-			const float area { edge_1.crossed(edge_2).length() };
-			
-			constexpr float3 get_point(const float2& coord) const {
-				return position + coord.x * edge_1 + coord.y * edge_2;
-			}
-			constexpr float get_area() const {
-				return area;
-			}
-		} light {};
-		{
-			// generate a random position on the lightsource
-			const auto sample_point = light.get_point(float2 { rand_0_1(), rand_0_1() });
-			
-			// cast shadow ray towards the light
-			const auto dir = sample_point - p.hit_point;
-			const auto dist_sqr = max(dir.dot(dir), INTERSECTION_EPS);
-			const ray r { p.hit_point, dir.normalized() };
-			const auto ret = simple_intersector::intersect(r);
-			if(ret.object >= CORNELL_OBJECT::__OBJECT_INVALID ||
-			   ret.distance >= sqrt(dist_sqr) - INTERSECTION_EPS ||
-			   ret.object == CORNELL_OBJECT::LIGHT) {
-				// didn't hit anything -> compute contribution
-				
-				// falloff formula: (.x falloff / dist^2) * intensity
-				const auto attenuation = 1.0f / dist_sqr; // here: 1 / dist^2
-				const auto elvis = max(-light.normal.dot(r.direction), 0.0f); // actually -r.d
-				const auto lambert = max(norm_surface.dot(r.direction), 0.0f);
-				
-				// diffuse
-				float3 illum = mat.diffuse_reflectance.xyz;
-				
-				// specular (only do the computation if it actually has a spec coeff > 0)
-				if(!mat.specular.is_null()) {
-					const auto R = (-r.direction).reflect(norm_surface).normalize();
-					illum += (mat.specular_reflectance.xyz *
-							  pow(max(R.dot(norm_eye_dir), 0.0f), mat.specular.w));
-				}
-				
-				// mul by intensity and mul single floats separately
-				illum *= light.intensity * (elvis * lambert * light.get_area() * attenuation);
-				
-				retval += illum;
-			}
-		}
-		
-		return retval;
-	}
+protected:
+	uint32_t seed;
+	
+	struct hemisphere_dir_type { const float3 dir; const float prob; };
 	
 	static hemisphere_dir_type generate_cosine_weighted_direction(//local coordinate system
 																  const float3& up,
@@ -354,53 +381,492 @@ protected:
 	
 };
 
-//
-namespace camera {
-	static constexpr const float3 point { 27.8f, 27.3f, -80.0f };
-	static constexpr const float rad_angle { const_math::deg_to_rad(35.0f) };
-	static constexpr const float3 forward { 0.0f, 0.0f, 1.0f };
-	static constexpr const float3 right { forward.crossed(float3 { 0.0f, 1.0f, 0.0f } /* up */).normalized() };
-	static constexpr const float3 up { -right.crossed(forward).normalized() };
-	static constexpr const float3 right_vector { 2.0f * right * const_math::tan(rad_angle * 0.5f) };
-	static constexpr const float3 up_vector { 2.0f * up * const_math::tan(rad_angle * 0.5f) };
-	static constexpr const float aspect_ratio { SCREEN_WIDTH / SCREEN_HEIGHT };
-	static constexpr const float3 row_vector { right_vector * aspect_ratio };
-	static constexpr const float3 step_x { row_vector / SCREEN_WIDTH };
-	static constexpr const float3 step_y { up_vector / SCREEN_HEIGHT };
-	static constexpr const float3 screen_origin { forward - row_vector * 0.5f - up_vector * 0.5f };
+class simple_path_tracer : public path_sampler {
+public:
+	enum : uint32_t { max_recursion_depth = MAX_PATH_DEPTH };
+	
+	simple_path_tracer(const uint32_t& random_seed,
+					   const bvh_intersector& intersector_,
+					   buffer<const material> materials_,
+					   const uint32_t max_depth_) :
+	path_sampler(random_seed), intersector(intersector_), materials(materials_), max_depth(max_depth_) {}
+	
+	// if you can't do normal recursion, do some template recursion instead! (at the cost of code bloat)
+	// also: can do this inside a single function now with c++17
+	template <uint32_t depth = 0
+#if !defined(FLOOR_CXX17)
+			  , enable_if_t<depth < max_recursion_depth>* = nullptr
+#endif
+			  >
+	float3 compute_radiance(const ray& r, const bool sample_emission) {
+#if defined(FLOOR_CXX17)
+		if constexpr(depth >= max_recursion_depth) {
+			return {};
+		}
+		else
+#endif
+		{
+			// runtime depth limit (<= max_recursion_depth)
+			if(depth >= max_depth) return {};
+			
+			// intersect
+			const auto p = intersector.intersect(r);
+			if(p.material_idx == bvh_intersector::invalid_material) return {};
+			
+			//
+			float3 radiance;
+			const auto& mat = materials[p.material_idx];
+			
+			// emission (don't oversample for indirect illumination)
+			if(sample_emission) radiance += mat.emission.xyz;
+			
+			// compute direct illumination at given point
+			radiance += compute_direct_illumination(-r.direction, p, mat);
+			
+			// indirect
+			radiance += compute_indirect_illumination<depth>(r, p, mat);
+			
+			return radiance;
+		}
+	}
+	
+#if !defined(FLOOR_CXX17)
+	// terminator
+	template <uint32_t depth, enable_if_t<depth >= max_recursion_depth>* = nullptr>
+	float3 compute_radiance(const ray&, const bool) {
+		return {};
+	}
+#endif
+	
+protected:
+	const bvh_intersector& intersector;
+	buffer<const material> materials;
+	const uint32_t max_depth;
+	
+	template <uint32_t depth>
+	float3 compute_indirect_illumination(const ray& r,
+										 const bvh_intersector::intersection& p,
+										 const material& mat) {
+		const auto bounce = sample_indirect_illumination(r, p.hit_point, p.normal, mat);
+		if(bounce.weight.is_null()) {
+			return {};
+		}
+		return bounce.weight * compute_radiance<depth + 1>(bounce.next_ray, false);
+	}
+	
+	float3 compute_direct_illumination(const float3& eye_direction,
+									   const bvh_intersector::intersection& p,
+									   const material& mat) {
+		const auto sample = sample_direct_illumination(eye_direction, p.hit_point, p.normal, mat);
+		if(sample.contribution.is_null()) {
+			return {};
+		}
+		
+		// cast shadow ray towards the light
+		const auto ret = intersector.intersect(sample.shadow_ray);
+		if(is_light_visible(sample.distance, ret, materials)) {
+			// didn't hit anything -> add contribution
+			return sample.contribution;
+		}
+		return {};
+	}
+	
 };
 
-kernel void path_trace(buffer<float4> img,
-					   param<uint32_t> iteration,
-					   param<uint32_t> seed) {
-	const auto idx = global_id.x;
-	const uint2 pixel { idx % SCREEN_WIDTH, idx / SCREEN_HEIGHT };
-	if(pixel.y >= SCREEN_HEIGHT) return;
+//! luminance of a linear rgb color
+static float luminance(const float3& color) {
+	return color.dot(float3 { 0.222f, 0.7067f, 0.0713f });
+}
+
+//! merges the sample_idx-th sample of a pixel into the image (running mean),
+//! .w holds the running mean of the squared luminance (-> per-pixel variance, see count_noisy_pixels)
+static void accumulate_sample(buffer<float4> img, const uint32_t idx, const float3& color, const uint32_t sample_idx) {
+	const auto lum = luminance(color);
+	const float4 sample { color, lum * lum };
 	
+	// merge with previous frames (re-weight)
+	if(sample_idx == 0) img[idx] = sample;
+	else img[idx] = img[idx].interpolate(sample, 1.0f / float(sample_idx + 1));
+}
+
+//! initial random state of the path of pixel idx in the given iteration
+static uint32_t path_seed(const uint32_t idx, const uint32_t iteration, const uint32_t seed, const uint32_t pixel_count) {
 	// this is hard ... totally random
 	uint32_t random_seed = seed;
 	random_seed += {
 		(random_seed ^ (idx << (random_seed & ((idx + iteration) & 0x1F)))) +
-		((idx + random_seed) * SCREEN_WIDTH * SCREEN_HEIGHT) ^ 0x52FBD9EC
+		((idx + random_seed) * pixel_count) ^ 0x52FBD9EC
 	};
-	simple_path_tracer pt(random_seed);
-	
+	return random_seed;
+}
+
+//! camera ray through a random position inside the given pixel
+static ray generate_camera_ray(const uint2& pixel, path_sampler& sampler, const render_params& params) {
 	//
-	const float2 pixel_sample { float2(pixel) + float2(pt.rand_0_1(), pt.rand_0_1()) };
+	const float2 pixel_sample { float2(pixel) + float2(sampler.rand_0_1(), sampler.rand_0_1()) };
 	
 	//
-	const ray r {
-		.origin = camera::point,
-		.direction = camera::screen_origin + pixel_sample.x * camera::step_x + pixel_sample.y * camera::step_y
+	return {
+		.origin = params.camera_origin,
+		.direction = params.screen_origin + pixel_sample.x * params.step_x + pixel_sample.y * params.step_y
 	};
-	float3 color = pt.compute_radiance(r, true);
+}
+
+kernel void path_trace(buffer<float4> img,
+					   param<uint32_t> iteration,
+					   param<uint32_t> seed,
+					   param<render_params> params,
+					   // scene data (see bvh_intersector)
+					   buffer<const float4> triangles,
+					   buffer<const uint32_t> triangle_materials,
+					   buffer<const bvh_node> bvh_nodes,
+					   buffer<const material> materials) {
+	const auto idx = global_id.x;
+	const uint2 pixel { idx % params.width, idx / params.width };
+	if(pixel.y >= params.height) return;
+	
+	const bvh_intersector intersector(triangles, triangle_materials, bvh_nodes);
+	simple_path_tracer pt(path_seed(idx, iteration, seed, params.width * params.height), intersector, materials,
+						  params.max_depth);
+	
+	float3 color;
+	for(uint32_t sample = 0; sample < params.samples_per_pixel; ++sample) {
+		color += pt.compute_radiance(generate_camera_ray(pixel, pt, params), true);
+	}
+	color /= float(params.samples_per_pixel);
 
 	// red test strip, so that I know if the output is working at all
 	//if(idx % img_size->x == 0) color = { 1.0f, 0.0f, 0.0f };
 	
-	// merge with previous frames (re-weight)
-	if(iteration == 0) img[idx] = color;
-	else img[idx] = img[idx].interpolate(color, 1.0f / float(iteration + 1));
+	accumulate_sample(img, idx, color, iteration);
+}
+
+//////////////////////////////////////////
+// adaptive sampling
+// the megakernel is only launched for the pixels in the compacted active pixel list, which is rebuilt every couple of
+// iterations (see compact_active_pixels) from the per-pixel statistics: the running mean and second moment of each pixel
+// (img, see accumulate_sample) and the amount of samples that have been merged into it (sample_counts).
+// NOTE: since pixels are sampled at different rates, each pixel re-weights with its own sample count
+
+// every pixel is sampled at least this many times before its variance estimate is trusted
+#define ADAPTIVE_MIN_SAMPLES 16u
+
+kernel void path_trace_adaptive(buffer<float4> img,
+								buffer<uint32_t> sample_counts,
+								buffer<const uint32_t> active_pixels,
+								buffer<const uint32_t> active_pixel_count,
+								param<uint32_t> iteration,
+								param<uint32_t> seed,
+								param<render_params> params,
+								// scene data (see bvh_intersector)
+								buffer<const float4> triangles,
+								buffer<const uint32_t> triangle_materials,
+								buffer<const bvh_node> bvh_nodes,
+								buffer<const material> materials) {
+	if(global_id.x >= active_pixel_count[0]) return;
+	const auto idx = active_pixels[global_id.x];
+	const uint2 pixel { idx % params.width, idx / params.width };
+	
+	const bvh_intersector intersector(triangles, triangle_materials, bvh_nodes);
+	simple_path_tracer pt(path_seed(idx, iteration, seed, params.width * params.height), intersector, materials,
+						  params.max_depth);
+	
+	float3 color;
+	for(uint32_t sample = 0; sample < params.samples_per_pixel; ++sample) {
+		color += pt.compute_radiance(generate_camera_ray(pixel, pt, params), true);
+	}
+	color /= float(params.samples_per_pixel);
+	
+	const auto sample_count = sample_counts[idx];
+	accumulate_sample(img, idx, color, sample_count);
+	sample_counts[idx] = sample_count + 1u;
+}
+
+//////////////////////////////////////////
+// wavefront path tracing
+// instead of tracing a whole path per work-item (path_trace), paths are advanced stage by stage, with each
+// stage being a separate kernel that is executed for all active paths at once:
+//  * wavefront_generate: one camera ray per pixel -> extension queue
+//  * per bounce:
+//    * wavefront_extend: intersects all rays of the extension queue -> shading queue (only paths that hit something)
+//    * wavefront_shade: emission + light sample (-> shadow queue) + bounce sample (-> next extension queue)
+//    * wavefront_connect: traces all rays of the shadow queue and adds the contribution of all visible light samples
+//  * wavefront_accumulate: merges the radiance of all paths into the image
+// path state is stored in SoA layout and indexed by path index (== pixel index), queues are compacted lists of
+// path indices with their size in a separate single-element buffer.
+// NOTE: all stages are launched for all paths and exit early beyond the queue size, so that the host never has to
+//       read back a queue size (a queue never holds more than one entry per path)
+
+kernel void wavefront_generate(param<uint32_t> iteration,
+							   param<uint32_t> seed,
+							   param<render_params> params,
+							   // path state
+							   buffer<float4> ray_origins,
+							   buffer<float4> ray_directions,
+							   buffer<float4> throughputs,
+							   buffer<float4> radiances,
+							   buffer<uint32_t> seeds,
+							   // output queue
+							   buffer<uint32_t> extension_queue,
+							   buffer<uint32_t> extension_queue_size) {
+	const auto idx = global_id.x;
+	const uint2 pixel { idx % params.width, idx / params.width };
+	if(pixel.y >= params.height) return;
+	
+	path_sampler sampler(path_seed(idx, iteration, seed, params.width * params.height));
+	const auto r = generate_camera_ray(pixel, sampler, params);
+	ray_origins[idx] = float4 { r.origin, 0.0f };
+	ray_directions[idx] = float4 { r.direction, 0.0f };
+	throughputs[idx] = float4 { 1.0f };
+	radiances[idx] = float4 { 0.0f };
+	seeds[idx] = sampler.get_seed();
+	
+	extension_queue[idx] = idx;
+	if(idx == 0) {
+		extension_queue_size[0] = params.width * params.height;
+	}
+}
+
+kernel void wavefront_extend(// input queue
+							 buffer<const uint32_t> extension_queue,
+							 buffer<const uint32_t> extension_queue_size,
+							 // path state
+							 buffer<const float4> ray_origins,
+							 buffer<const float4> ray_directions,
+							 buffer<float4> hit_normals, // .w: hit distance
+							 buffer<uint32_t> hit_materials,
+							 // output queue
+							 buffer<uint32_t> shading_queue,
+							 buffer<uint32_t> shading_queue_size,
+							 // scene data (see bvh_intersector)
+							 buffer<const float4> triangles,
+							 buffer<const uint32_t> triangle_materials,
+							 buffer<const bvh_node> bvh_nodes) {
+	const auto idx = global_id.x;
+	if(idx >= extension_queue_size[0]) return;
+	const auto path_idx = extension_queue[idx];
+	
+	const bvh_intersector intersector(triangles, triangle_materials, bvh_nodes);
+	const auto p = intersector.intersect(ray { ray_origins[path_idx].xyz, ray_directions[path_idx].xyz });
+	// path leaves the scene -> it's done
+	if(p.material_idx == bvh_intersector::invalid_material) return;
+	
+	hit_normals[path_idx] = float4 { p.normal, p.distance };
+	hit_materials[path_idx] = p.material_idx;
+	shading_queue[atomic_inc(&shading_queue_size[0])] = path_idx;
+}
+
+kernel void wavefront_shade(param<uint32_t> depth,
+							param<render_params> params,
+							// input queue
+							buffer<const uint32_t> shading_queue,
+							buffer<const uint32_t> shading_queue_size,
+							// path state
+							buffer<float4> ray_origins,
+							buffer<float4> ray_directions,
+							buffer<const float4> hit_normals,
+							buffer<const uint32_t> hit_materials,
+							buffer<float4> throughputs,
+							buffer<float4> radiances,
+							buffer<uint32_t> seeds,
+							buffer<float4> shadow_origins, // .w: distance to the light sample
+							buffer<float4> shadow_directions,
+							buffer<float4> shadow_contributions,
+							// output queues
+							buffer<uint32_t> shadow_queue,
+							buffer<uint32_t> shadow_queue_size,
+							buffer<uint32_t> next_extension_queue,
+							buffer<uint32_t> next_extension_queue_size,
+							// scene data
+							buffer<const material> materials) {
+	const auto idx = global_id.x;
+	if(idx >= shading_queue_size[0]) return;
+	const auto path_idx = shading_queue[idx];
+	
+	const ray r { ray_origins[path_idx].xyz, ray_directions[path_idx].xyz };
+	const auto hit = hit_normals[path_idx];
+	const auto hit_point = r.origin + r.direction * hit.w;
+	const auto& mat = materials[hit_materials[path_idx]];
+	const auto throughput = throughputs[path_idx].xyz;
+	path_sampler sampler(seeds[path_idx]);
+	
+	// emission (don't oversample for indirect illumination)
+	if(depth == 0) {
+		radiances[path_idx] += float4 { throughput * mat.emission.xyz, 0.0f };
+	}
+	
+	// direct illumination: visibility is resolved in wavefront_connect
+	const auto light = sampler.sample_direct_illumination(-r.direction, hit_point, hit.xyz, mat);
+	if(!light.contribution.is_null()) {
+		shadow_origins[path_idx] = float4 { light.shadow_ray.origin, light.distance };
+		shadow_directions[path_idx] = float4 { light.shadow_ray.direction, 0.0f };
+		shadow_contributions[path_idx] = float4 { throughput * light.contribution, 0.0f };
+		shadow_queue[atomic_inc(&shadow_queue_size[0])] = path_idx;
+	}
+	
+	// indirect: continue the path (unless this was the last segment or the path was terminated)
+	if(depth + 1u < params.max_depth) {
+		const auto bounce = sampler.sample_indirect_illumination(r, hit_point, hit.xyz, mat);
+		if(!bounce.weight.is_null()) {
+			ray_origins[path_idx] = float4 { bounce.next_ray.origin, 0.0f };
+			ray_directions[path_idx] = float4 { bounce.next_ray.direction, 0.0f };
+			throughputs[path_idx] = float4 { throughput * bounce.weight, 0.0f };
+			next_extension_queue[atomic_inc(&next_extension_queue_size[0])] = path_idx;
+		}
+	}
+	seeds[path_idx] = sampler.get_seed();
+}
+
+kernel void wavefront_connect(// input queue
+							  buffer<const uint32_t> shadow_queue,
+							  buffer<const uint32_t> shadow_queue_size,
+							  // path state
+							  buffer<const float4> shadow_origins,
+							  buffer<const float4> shadow_directions,
+							  buffer<const float4> shadow_contributions,
+							  buffer<float4> radiances,
+							  // scene data (see bvh_intersector)
+							  buffer<const float4> triangles,
+							  buffer<const uint32_t> triangle_materials,
+							  buffer<const bvh_node> bvh_nodes,
+							  buffer<const material> materials) {
+	const auto idx = global_id.x;
+	if(idx >= shadow_queue_size[0]) return;
+	const auto path_idx = shadow_queue[idx];
+	
+	const auto origin = shadow_origins[path_idx];
+	const bvh_intersector intersector(triangles, triangle_materials, bvh_nodes);
+	const auto ret = intersector.intersect(ray { origin.xyz, shadow_directions[path_idx].xyz });
+	if(path_sampler::is_light_visible(origin.w, ret, materials)) {
+		radiances[path_idx] += shadow_contributions[path_idx];
+	}
+}
+
+kernel void wavefront_accumulate(buffer<float4> img,
+								 param<uint32_t> iteration,
+								 param<render_params> params,
+								 buffer<const float4> radiances) {
+	const auto idx = global_id.x;
+	if(idx >= params.width * params.height) return;
+	
+	accumulate_sample(img, idx, radiances[idx].xyz, iteration);
+}
+
+// lower bound of the mean luminance in the relative error computation (avoids amplifying noise in black pixels)
+#define NOISE_MIN_LUMINANCE 0.001f
+
+//! relative standard error of the mean luminance of an accumulated pixel (see accumulate_sample)
+static float relative_error(const float4& pixel, const uint32_t sample_count) {
+	const auto mean = luminance(pixel.xyz);
+	const auto variance = max(pixel.w - mean * mean, 0.0f);
+	return sqrt(variance / float(sample_count)) / max(mean, NOISE_MIN_LUMINANCE);
+}
+
+//! counts all pixels whose relative standard error (of the mean luminance) is above the threshold,
+//! sample_count is the amount of samples that have been merged into each pixel
+kernel void count_noisy_pixels(buffer<const float4> img,
+							   param<render_params> params,
+							   param<uint32_t> sample_count,
+							   param<float> threshold,
+							   buffer<uint32_t> noisy_pixel_count) {
+	const auto idx = global_id.x;
+	if(idx >= params.width * params.height) return;
+	
+	if(relative_error(img[idx], sample_count) > threshold) {
+		atomic_inc(&noisy_pixel_count[0]);
+	}
+}
+
+//! true if a pixel still needs samples (adaptive sampling): it hasn't reached ADAPTIVE_MIN_SAMPLES yet
+//! or its relative standard error is still above the threshold
+static bool is_active_pixel(const float4& pixel, const uint32_t sample_count, const float threshold) {
+	return (sample_count < ADAPTIVE_MIN_SAMPLES || relative_error(pixel, sample_count) > threshold);
+}
+
+// the active pixel list is rebuilt by an order-preserving stream compaction (same scheme as the radix sort in hlbvh),
+// with each of the ADAPTIVE_COMPACTION_GROUP_COUNT work-groups handling a contiguous range of pixels:
+//  * count_active_pixels: counts the active pixels of each work-group
+//  * active_pixels_prefix_sum: inclusive scan of the per-group counts (single work-group)
+//  * compact_active_pixels: each work-group writes its active pixels, starting at its scanned offset
+// -> the active pixel list stays in scanline order, so that neighboring work-items trace neighboring pixels
+
+kernel void count_active_pixels(buffer<const float4> img,
+								buffer<const uint32_t> sample_counts,
+								param<render_params> params,
+								param<float> threshold,
+								param<uint32_t> pixels_per_group,
+								buffer<uint32_t> active_counts) {
+	const auto lid = local_id.x;
+	const auto gid = group_id.x;
+	const auto pixel_count = params.width * params.height;
+	
+	uint32_t counter = 0;
+	for(uint32_t idx = lid + gid * pixels_per_group;
+		idx < ((gid + 1u) * pixels_per_group) && idx < pixel_count;
+		idx += ADAPTIVE_COMPACTION_GROUP_SIZE) {
+		if(is_active_pixel(img[idx], sample_counts[idx], threshold)) {
+			++counter;
+		}
+	}
+	
+	// reduce + write final result (group sum)
+	local_buffer<uint32_t, compute_algorithm::reduce_local_memory_elements<ADAPTIVE_COMPACTION_GROUP_SIZE>()> lmem;
+	const auto reduced_value = compute_algorithm::reduce<ADAPTIVE_COMPACTION_GROUP_SIZE>(counter, lmem, plus<> {});
+	if(lid == 0) {
+		active_counts[gid] = reduced_value;
+	}
+}
+
+kernel void active_pixels_prefix_sum(buffer<uint32_t> active_counts) {
+	const auto idx = global_id.x;
+	const auto val = active_counts[idx];
+	
+	// work-group scan
+	local_buffer<uint32_t, compute_algorithm::scan_local_memory_elements<ADAPTIVE_COMPACTION_GROUP_COUNT>()> lmem;
+	active_counts[idx] = compute_algorithm::inclusive_scan<ADAPTIVE_COMPACTION_GROUP_COUNT>(val, plus<> {}, lmem);
+}
+
+//! rebuilds the active pixel list (see is_active_pixel), active_counts must contain the scanned per-group counts
+kernel void compact_active_pixels(buffer<const float4> img,
+								  buffer<const uint32_t> sample_counts,
+								  param<render_params> params,
+								  param<float> threshold,
+								  param<uint32_t> pixels_per_group,
+								  buffer<const uint32_t> active_counts,
+								  buffer<uint32_t> active_pixels,
+								  buffer<uint32_t> active_pixel_count) {
+	const auto lid = local_id.x;
+	const auto gid = group_id.x;
+	const auto pixel_count = params.width * params.height;
+	auto offset = (gid == 0 ? 0u : active_counts[gid - 1]);
+	if(gid == 0 && lid == 0) {
+		active_pixel_count[0] = active_counts[ADAPTIVE_COMPACTION_GROUP_COUNT - 1];
+	}
+	
+	// since we're using barriers in here, all work-items must always execute this
+	// -> only abort once the base index is out of range
+	local_buffer<uint32_t, compute_algorithm::scan_local_memory_elements<ADAPTIVE_COMPACTION_GROUP_SIZE>()> lmem;
+	for(uint32_t base_idx = gid * pixels_per_group;
+		base_idx < ((gid + 1u) * pixels_per_group) && base_idx < pixel_count;
+		base_idx += ADAPTIVE_COMPACTION_GROUP_SIZE) {
+		const auto idx = base_idx + lid;
+		const auto in_range = (idx < ((gid + 1u) * pixels_per_group) && idx < pixel_count);
+		const auto active = (in_range && is_active_pixel(img[idx], sample_counts[idx], threshold) ? 1u : 0u);
+		
+		local_barrier();
+		const auto result = compute_algorithm::inclusive_scan<ADAPTIVE_COMPACTION_GROUP_SIZE>(active, plus<> {}, lmem);
+		if(active) {
+			active_pixels[offset + result - 1u] = idx;
+		}
+		
+		// NOTE: scan already does a local_barrier() at the end, so another one is unnecessary here
+		if(lid == ADAPTIVE_COMPACTION_GROUP_SIZE - 1) {
+			lmem[0] = offset + result;
+		}
+		local_barrier();
+		
+		offset = lmem[0];
+	}
 }
 
 #endif
@@ -27,14 +27,59 @@
 #include <floor/compute/device/common.hpp>
 #endif
 
-#if !defined(SCREEN_HEIGHT)
-#define SCREEN_HEIGHT 512
 #endif
 
-#if !defined(SCREEN_WIDTH)
-#define SCREEN_WIDTH 512
-#endif
+// max amount of path segments (camera ray + bounces) in the path_trace kernel (wavefront mode isn't limited by this)
+#define MAX_PATH_DEPTH 3u
 
-#endif
+//! per-render parameters, these are passed to the kernels at runtime (changing them doesn't require a recompile)
+struct render_params {
+	//! camera position
+	float3 camera_origin;
+	//! image width in pixels
+	uint32_t width;
+	//! (unnormalized) direction from the camera through the top left corner of the image plane
+	float3 screen_origin;
+	//! image height in pixels
+	uint32_t height;
+	//! image plane step per pixel in x direction
+	float3 step_x;
+	//! #paths per pixel and iteration
+	uint32_t samples_per_pixel;
+	//! image plane step per pixel in y direction
+	float3 step_y;
+	//! max amount of path segments (camera ray + bounces)
+	uint32_t max_depth;
+};
+static_assert(sizeof(render_params) == 64, "invalid render_params size");
+
+// adaptive sampling: fixed work-group count and work-group size of the active pixel compaction
+// (the per-group counts are scanned by a single work-group, so the group count must be a supported work-group size)
+#define ADAPTIVE_COMPACTION_GROUP_COUNT 256u
+#define ADAPTIVE_COMPACTION_GROUP_SIZE 256u
+
+// max bvh depth (leaves are forced beyond this), this is also the size of the traversal stack
+#define BVH_MAX_DEPTH 64u
+// nodes with at most this many triangles are always leaves
+#define BVH_MAX_LEAF_TRIANGLES 4u
+// amount of bins per axis that are considered by the binned sah build
+#define BVH_SAH_BIN_COUNT 16u
+// sah cost of traversing a bvh node, relative to the cost of intersecting one triangle
+#define BVH_SAH_TRAVERSAL_COST 1.0f
+// nodes with at most this many triangles become leaves if the sah cost of the best split isn't lower than that of a
+// leaf (larger nodes are always split)
+#define BVH_SAH_MAX_LEAF_TRIANGLES 16u
+
+//! flat bvh node, built on the host (depth-first order) and traversed on the device
+struct bvh_node {
+	float3 aabb_min;
+	//! inner node: index of the right child (the left child always directly follows its parent)
+	//! leaf: index of the first triangle
+	uint32_t offset;
+	float3 aabb_max;
+	//! #triangles in a leaf, 0 for inner nodes
+	uint32_t count;
+};
+static_assert(sizeof(bvh_node) == 32, "invalid bvh_node size");
 
 #endif